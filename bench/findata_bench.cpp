@@ -0,0 +1,616 @@
+// Workload driver for StorageEngine. Each scenario reports throughput and
+// latency percentiles; --json also writes them, with the configuration
+// used, in machine-readable form so runs can be compared.
+//
+//   findata_bench --threads=8 --symbols=64 --points=200000 --json=run.json
+//
+// --help lists every option.
+
+#include "findata_engine/storage_engine.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace findata_engine;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr int64_t BASE_TICKS = 1'700'000'000'000'000'000; // 2023-11-14, in system_clock ns
+constexpr int64_t TICK_INTERVAL = 1'000'000;              // 1 ms between points of a symbol
+
+struct Options {
+    EngineConfig engine;
+    size_t threads = 4;
+    size_t symbols = 16;
+    size_t points = 100'000;     // Per symbol, for the ingest scenarios
+    size_t batch = 1000;         // Points per write call
+    bool columns = false;        // Ingest through write_columns instead of write_batch
+    double disorder = 0.1;       // Share of points written one batch late in out_of_order
+    size_t reads = 20'000;       // get_latest and narrow read calls, across threads
+    size_t narrow_points = 100;  // Points spanned by a narrow read
+    size_t wide_reads = 16;      // Full-history reads
+    size_t flush_rounds = 5;
+    size_t optimize_rounds = 3;
+    std::string scenarios = "all";
+    std::string data_dir;
+    std::string json;            // Output path, or - for stdout
+    bool keep = false;
+    uint64_t seed = 42;
+};
+
+// One command-line option, bound to the field it sets
+struct Flag {
+    std::string name;
+    std::string help;
+    std::function<void(const std::string&)> set;
+    std::function<std::string()> get;
+    bool quoted = false; // JSON string rather than number or bool
+};
+
+bool parse_bool(const std::string& text) {
+    if (text == "1" || text == "true" || text == "on") return true;
+    if (text == "0" || text == "false" || text == "off") return false;
+    throw std::invalid_argument("expected a boolean, got '" + text + "'");
+}
+
+Flag size_flag(std::string name, std::string help, size_t& target) {
+    return Flag{std::move(name), std::move(help),
+                [&target](const std::string& text) { target = std::stoull(text); },
+                [&target] { return std::to_string(target); }};
+}
+
+Flag u64_flag(std::string name, std::string help, uint64_t& target) {
+    return Flag{std::move(name), std::move(help),
+                [&target](const std::string& text) { target = std::stoull(text); },
+                [&target] { return std::to_string(target); }};
+}
+
+Flag double_flag(std::string name, std::string help, double& target) {
+    return Flag{std::move(name), std::move(help),
+                [&target](const std::string& text) { target = std::stod(text); },
+                [&target] {
+                    std::ostringstream out;
+                    out << target;
+                    return out.str();
+                }};
+}
+
+Flag bool_flag(std::string name, std::string help, bool& target) {
+    return Flag{std::move(name), std::move(help),
+                [&target](const std::string& text) { target = parse_bool(text); },
+                [&target] { return std::string(target ? "true" : "false"); }};
+}
+
+Flag string_flag(std::string name, std::string help, std::string& target) {
+    return Flag{std::move(name), std::move(help),
+                [&target](const std::string& text) { target = text; },
+                [&target] { return target; }, true};
+}
+
+template<typename Enum, size_t N>
+Flag enum_flag(std::string name, std::string help, Enum& target,
+               const std::array<std::pair<const char*, Enum>, N>& names) {
+    return Flag{std::move(name), std::move(help),
+                [&target, names](const std::string& text) {
+                    for (const auto& [label, value] : names) {
+                        if (text == label) {
+                            target = value;
+                            return;
+                        }
+                    }
+                    throw std::invalid_argument("unknown value '" + text + "'");
+                },
+                [&target, names] {
+                    for (const auto& [label, value] : names) {
+                        if (target == value) return std::string(label);
+                    }
+                    return std::string("?");
+                }, true};
+}
+
+std::vector<Flag> make_flags(Options& options) {
+    auto& engine = options.engine;
+    auto& disk = engine.disk_config;
+    const std::array<std::pair<const char*, BlockCodec>, 4> codecs = {{
+        {"none", BlockCodec::None}, {"zstd", BlockCodec::Zstd},
+        {"gorilla", BlockCodec::Gorilla}, {"gorilla_zstd", BlockCodec::GorillaZstd},
+    }};
+    const std::array<std::pair<const char*, FlushPolicy>, 2> policies = {{
+        {"largest", FlushPolicy::Largest}, {"oldest", FlushPolicy::Oldest},
+    }};
+    return {
+        // Workload
+        size_flag("threads", "Client threads", options.threads),
+        size_flag("symbols", "Symbols per ingest scenario", options.symbols),
+        size_flag("points", "Points per symbol per ingest scenario", options.points),
+        size_flag("batch", "Points per write call", options.batch),
+        bool_flag("columns", "Ingest with write_columns instead of write_batch", options.columns),
+        double_flag("disorder", "Share of points written one batch late in out_of_order", options.disorder),
+        size_flag("reads", "get_latest and narrow read calls", options.reads),
+        size_flag("narrow_points", "Points spanned by a narrow read", options.narrow_points),
+        size_flag("wide_reads", "Full-history reads", options.wide_reads),
+        size_flag("flush_rounds", "Timed flushes", options.flush_rounds),
+        size_flag("optimize_rounds", "Timed optimize calls under concurrent ingest", options.optimize_rounds),
+        string_flag("scenarios", "Comma-separated scenarios to run, or all", options.scenarios),
+        string_flag("data_dir", "Engine directory; a fresh temporary one by default", options.data_dir),
+        string_flag("json", "Write results as JSON to this path, - for stdout", options.json),
+        bool_flag("keep", "Keep the data directory afterwards", options.keep),
+        u64_flag("seed", "Random seed", options.seed),
+        // EngineConfig
+        size_flag("memory_mb", "EngineConfig::memory_cache_size_mb", engine.memory_cache_size_mb),
+        size_flag("max_memory_points", "EngineConfig::max_memory_points", engine.max_memory_points),
+        bool_flag("compression", "EngineConfig::enable_compression", engine.enable_compression),
+        enum_flag("codec", "EngineConfig::compression_codec (none, zstd, gorilla, gorilla_zstd)",
+                  engine.compression_codec, codecs),
+        bool_flag("wal", "EngineConfig::enable_wal", engine.enable_wal),
+        bool_flag("wal_sync", "EngineConfig::wal_sync_commit", engine.wal_sync_commit),
+        size_flag("wal_group_commit_us", "EngineConfig::wal_group_commit_us", engine.wal_group_commit_us),
+        size_flag("wal_group_commit_bytes", "EngineConfig::wal_group_commit_bytes", engine.wal_group_commit_bytes),
+        size_flag("scan_threads", "EngineConfig::scan_threads", engine.scan_threads),
+        enum_flag("flush_policy", "EngineConfig::flush_policy (largest, oldest)", engine.flush_policy, policies),
+        // DiskConfig, through EngineConfig::disk_config
+        size_flag("cache_mb", "DiskConfig::block_cache_size_mb", disk.disk_cache_size_mb),
+        size_flag("segment_mb", "DiskConfig::max_segment_size_mb", disk.max_disk_segment_size_mb),
+        size_flag("points_per_block", "DiskConfig::points_per_block", disk.points_per_block),
+        bool_flag("mmap", "DiskConfig::use_mmap", disk.use_mmap),
+        size_flag("read_ahead_blocks", "DiskConfig::read_ahead_blocks", disk.read_ahead_blocks),
+        size_flag("compaction_threads", "DiskConfig::compaction_threads", disk.compaction_threads),
+    };
+}
+
+void print_usage(const std::vector<Flag>& flags) {
+    printf("Usage: findata_bench [--option=value ...]\n\n");
+    for (const auto& flag : flags) {
+        printf("  --%-24s %s (default %s)\n", flag.name.c_str(), flag.help.c_str(), flag.get().c_str());
+    }
+    printf("\nScenarios: ingest, out_of_order, get_latest, read_narrow, read_wide, flush, optimize_under_load\n");
+}
+
+// Wall time and per-call latencies of one scenario
+struct Result {
+    std::string name;
+    size_t threads = 1;
+    size_t items = 0;    // Points written or read
+    double seconds = 0.0;
+    std::vector<int64_t> latencies_ns = {};
+
+    size_t operations() const { return latencies_ns.size(); }
+
+    // Nearest-rank percentile; latencies_ns must be sorted
+    double percentile(double q) const {
+        if (latencies_ns.empty()) return 0.0;
+        const auto rank = static_cast<size_t>(std::ceil(q * latencies_ns.size()));
+        return static_cast<double>(latencies_ns[std::clamp<size_t>(rank, 1, latencies_ns.size()) - 1]);
+    }
+
+    double mean() const {
+        if (latencies_ns.empty()) return 0.0;
+        double total = 0.0;
+        for (int64_t latency : latencies_ns) total += static_cast<double>(latency);
+        return total / latencies_ns.size();
+    }
+};
+
+// Times fn once and records the latency
+template<typename Fn>
+void timed(std::vector<int64_t>& latencies, Fn&& fn) {
+    const auto start = Clock::now();
+    fn();
+    latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+// Runs body(thread index, latencies) on `threads` threads, all released at
+// once, and gathers the latencies and wall time into result
+void run_threads(Result& result, size_t threads, const std::function<void(size_t, std::vector<int64_t>&)>& body) {
+    std::vector<std::vector<int64_t>> latencies(threads);
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            body(t, latencies[t]);
+        });
+    }
+    const auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) worker.join();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.threads = threads;
+    for (auto& part : latencies) {
+        result.latencies_ns.insert(result.latencies_ns.end(), part.begin(), part.end());
+    }
+}
+
+class Bench {
+public:
+    explicit Bench(const Options& options) : options_(options), engine_(options.engine) {}
+
+    Result ingest(const std::string& name, const std::string& prefix, double disorder) {
+        auto& series = series_for(prefix);
+        Result result{.name = name};
+        std::atomic<size_t> items{0};
+        run_threads(result, options_.threads, [&](size_t t, std::vector<int64_t>& latencies) {
+            std::mt19937_64 rng(options_.seed + t);
+            std::vector<TimeSeriesPoint> points;
+            std::vector<int64_t> timestamps;
+            std::vector<double> values;
+            size_t written = 0;
+            for (size_t offset = 0; offset < options_.points; offset += options_.batch) {
+                const size_t count = std::min(options_.batch, options_.points - offset);
+                for (size_t s = t; s < series.size(); s += options_.threads) {
+                    make_batch(series[s], count, disorder, rng, timestamps, values);
+                    if (options_.columns) {
+                        timed(latencies, [&] { engine_.write_columns(series[s].id, timestamps, values); });
+                    } else {
+                        points.clear();
+                        for (size_t i = 0; i < count; ++i) {
+                            points.push_back(TimeSeriesPoint{
+                                .timestamp = std::chrono::system_clock::time_point(
+                                    std::chrono::system_clock::duration(timestamps[i])),
+                                .value = values[i],
+                                .symbol = series[s].name});
+                        }
+                        timed(latencies, [&] { engine_.write_batch(points); });
+                    }
+                    written += count;
+                }
+            }
+            items.fetch_add(written, std::memory_order_relaxed);
+        });
+        result.items = items.load();
+        return result;
+    }
+
+    Result get_latest() {
+        auto& series = loaded();
+        Result result{.name = "get_latest"};
+        const size_t per_thread = std::max<size_t>(options_.reads / options_.threads, 1);
+        std::atomic<size_t> items{0};
+        run_threads(result, options_.threads, [&](size_t t, std::vector<int64_t>& latencies) {
+            std::mt19937_64 rng(options_.seed + 100 + t);
+            size_t found = 0;
+            for (size_t i = 0; i < per_thread; ++i) {
+                const auto& target = series[rng() % series.size()];
+                timed(latencies, [&] { found += engine_.get_latest(target.id).has_value(); });
+            }
+            items.fetch_add(found, std::memory_order_relaxed);
+        });
+        result.items = items.load();
+        return result;
+    }
+
+    // Reads windows of `span` points, placed at random within each symbol's history
+    Result read(const std::string& name, size_t span, size_t calls) {
+        auto& series = loaded();
+        Result result{.name = name};
+        const size_t per_thread = std::max<size_t>(calls / options_.threads, 1);
+        std::atomic<size_t> items{0};
+        run_threads(result, options_.threads, [&](size_t t, std::vector<int64_t>& latencies) {
+            std::mt19937_64 rng(options_.seed + 200 + t);
+            size_t read = 0;
+            for (size_t i = 0; i < per_thread; ++i) {
+                const auto& target = series[rng() % series.size()];
+                const size_t history = target.next;
+                const size_t first = history > span ? rng() % (history - span) : 0;
+                const auto start = time_at(first);
+                const auto end = time_at(first + span - 1);
+                timed(latencies, [&] { read += engine_.read_range(target.id, start, end).size(); });
+            }
+            items.fetch_add(read, std::memory_order_relaxed);
+        });
+        result.items = items.load();
+        return result;
+    }
+
+    // Each round writes one batch per symbol untimed, then times flush()
+    Result flush() {
+        auto& series = loaded();
+        Result result{.name = "flush"};
+        std::mt19937_64 rng(options_.seed + 300);
+        std::vector<int64_t> timestamps;
+        std::vector<double> values;
+        const auto start = Clock::now();
+        for (size_t round = 0; round < options_.flush_rounds; ++round) {
+            for (auto& target : series) {
+                make_batch(target, options_.batch, 0.0, rng, timestamps, values);
+                engine_.write_columns(target.id, timestamps, values);
+                result.items += timestamps.size();
+            }
+            timed(result.latencies_ns, [&] { engine_.flush(); });
+        }
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return result;
+    }
+
+    // Times optimize() while the client threads keep ingesting; reports the
+    // optimize calls and the writes that ran alongside them
+    std::pair<Result, Result> optimize_under_load() {
+        auto& series = loaded();
+        Result optimize{.name = "optimize_under_load"};
+        Result writes{.name = "ingest_during_optimize"};
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> items{0};
+        std::thread driver([&] {
+            for (size_t round = 0; round < options_.optimize_rounds; ++round) {
+                timed(optimize.latencies_ns, [&] { engine_.optimize(); });
+            }
+            stop.store(true, std::memory_order_release);
+        });
+        run_threads(writes, options_.threads, [&](size_t t, std::vector<int64_t>& latencies) {
+            std::mt19937_64 rng(options_.seed + 400 + t);
+            std::vector<int64_t> timestamps;
+            std::vector<double> values;
+            size_t written = 0;
+            while (!stop.load(std::memory_order_acquire)) {
+                for (size_t s = t; s < series.size(); s += options_.threads) {
+                    make_batch(series[s], options_.batch, 0.0, rng, timestamps, values);
+                    timed(latencies, [&] { engine_.write_columns(series[s].id, timestamps, values); });
+                    written += timestamps.size();
+                }
+            }
+            items.fetch_add(written, std::memory_order_relaxed);
+        });
+        driver.join();
+        optimize.seconds = writes.seconds;
+        writes.items = items.load();
+        return {std::move(optimize), std::move(writes)};
+    }
+
+    EngineStats stats() const { return engine_.get_stats(); }
+
+private:
+    // One symbol's generator state. Symbols are written by a single thread
+    // at a time, so `next` needs no synchronization within a scenario.
+    struct Series {
+        std::string name;
+        SymbolId id;
+        size_t next = 0; // Index of the next point to generate
+        double price = 100.0;
+        std::vector<std::pair<int64_t, double>> held = {}; // Deferred by disorder
+    };
+
+    static std::chrono::system_clock::time_point time_at(size_t index) {
+        return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(
+            BASE_TICKS + static_cast<int64_t>(index) * TICK_INTERVAL));
+    }
+
+    std::vector<Series>& series_for(const std::string& prefix) {
+        auto& series = prefix == "OOO" ? out_of_order_ : in_order_;
+        if (series.empty()) {
+            for (size_t s = 0; s < std::max<size_t>(options_.symbols, 1); ++s) {
+                char name[32];
+                snprintf(name, sizeof(name), "%s%04zu", prefix.c_str(), s);
+                series.push_back(Series{.name = name, .id = engine_.intern_symbol(name)});
+            }
+        }
+        return series;
+    }
+
+    // Read scenarios need history; load it untimed if ingest didn't run
+    std::vector<Series>& loaded() {
+        if (in_order_.empty()) {
+            ingest("load", "SYM", 0.0);
+        }
+        return in_order_;
+    }
+
+    // Next `count` points of a random walk. With disorder, that share of
+    // fresh points is held back and written with the following batch, so
+    // writes land behind what the memtable already holds.
+    void make_batch(Series& series, size_t count, double disorder, std::mt19937_64& rng,
+                    std::vector<int64_t>& timestamps, std::vector<double>& values) const {
+        std::normal_distribution<double> step(0.0, 0.05);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        timestamps.clear();
+        values.clear();
+        for (const auto& [timestamp, value] : series.held) {
+            timestamps.push_back(timestamp);
+            values.push_back(value);
+        }
+        series.held.clear();
+        while (timestamps.size() < count) {
+            series.price = std::max(series.price + step(rng), 0.01);
+            const int64_t timestamp = time_at(series.next++).time_since_epoch().count();
+            if (disorder > 0.0 && coin(rng) < disorder) {
+                series.held.emplace_back(timestamp, series.price);
+                continue;
+            }
+            timestamps.push_back(timestamp);
+            values.push_back(series.price);
+        }
+    }
+
+    const Options& options_;
+    StorageEngine engine_;
+    std::vector<Series> in_order_;
+    std::vector<Series> out_of_order_;
+};
+
+void print_table(const std::vector<Result>& results) {
+    printf("%-24s %8s %10s %14s %10s %10s %10s %10s\n",
+           "scenario", "threads", "ops", "items/s", "p50 us", "p99 us", "p999 us", "max us");
+    for (const auto& result : results) {
+        const double items_per_sec = result.seconds > 0 ? result.items / result.seconds : 0.0;
+        printf("%-24s %8zu %10zu %14.0f %10.2f %10.2f %10.2f %10.2f\n",
+               result.name.c_str(), result.threads, result.operations(), items_per_sec,
+               result.percentile(0.50) / 1e3, result.percentile(0.99) / 1e3,
+               result.percentile(0.999) / 1e3,
+               result.latencies_ns.empty() ? 0.0 : result.latencies_ns.back() / 1e3);
+    }
+}
+
+std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void write_json(FILE* out, const std::vector<Flag>& flags, const std::vector<Result>& results,
+                const EngineStats& stats) {
+    fprintf(out, "{\n  \"config\": {");
+    for (size_t i = 0; i < flags.size(); ++i) {
+        const auto value = flags[i].get();
+        fprintf(out, "%s\n    \"%s\": %s%s%s", i ? "," : "", flags[i].name.c_str(),
+                flags[i].quoted ? "\"" : "", json_escape(value).c_str(), flags[i].quoted ? "\"" : "");
+    }
+    fprintf(out, "\n  },\n  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        fprintf(out,
+                "%s\n    {\"name\": \"%s\", \"threads\": %zu, \"operations\": %zu, \"items\": %zu, "
+                "\"seconds\": %.6f, \"ops_per_sec\": %.1f, \"items_per_sec\": %.1f, "
+                "\"latency_ns\": {\"mean\": %.0f, \"p50\": %.0f, \"p99\": %.0f, \"p999\": %.0f, \"max\": %.0f}}",
+                i ? "," : "", result.name.c_str(), result.threads, result.operations(), result.items,
+                result.seconds,
+                result.seconds > 0 ? result.operations() / result.seconds : 0.0,
+                result.seconds > 0 ? result.items / result.seconds : 0.0,
+                result.mean(), result.percentile(0.50), result.percentile(0.99), result.percentile(0.999),
+                result.latencies_ns.empty() ? 0.0 : static_cast<double>(result.latencies_ns.back()));
+    }
+    fprintf(out,
+            "\n  ],\n  \"stats\": {\"total_points\": %zu, \"rejected_points\": %zu, \"cache_hits\": %zu, "
+            "\"cache_misses\": %zu, \"storage_size_bytes\": %zu, \"memory_bytes\": %zu, "
+            "\"bytes_read\": %llu, \"bytes_written\": %llu, \"simd_level\": \"%s\"",
+            stats.total_points, stats.rejected_points, stats.cache_hits, stats.cache_misses,
+            stats.storage_size_bytes, stats.memory_bytes,
+            static_cast<unsigned long long>(stats.bytes_read),
+            static_cast<unsigned long long>(stats.bytes_written), stats.simd_level.c_str());
+    // The engine's own histograms, which include work the scenarios don't time
+    const std::pair<const char*, const metrics::Summary*> summaries[] = {
+        {"write", &stats.write_latency}, {"read", &stats.read_latency},
+        {"flush", &stats.flush_latency}, {"compaction", &stats.compaction_latency},
+        {"decode", &stats.decode_latency}, {"engine_lock_wait", &stats.engine_lock_wait},
+        {"memory_lock_wait", &stats.memory_lock_wait}, {"disk_lock_wait", &stats.disk_lock_wait},
+    };
+    for (const auto& [name, summary] : summaries) {
+        fprintf(out,
+                ", \"%s\": {\"count\": %llu, \"mean\": %.0f, \"p50\": %llu, \"p99\": %llu, "
+                "\"p999\": %llu, \"max\": %llu}",
+                name, static_cast<unsigned long long>(summary->count), summary->mean_ns(),
+                static_cast<unsigned long long>(summary->p50_ns),
+                static_cast<unsigned long long>(summary->p99_ns),
+                static_cast<unsigned long long>(summary->p999_ns),
+                static_cast<unsigned long long>(summary->max_ns));
+    }
+    fprintf(out, "}\n}\n");
+}
+
+bool selected(const std::string& scenarios, const std::string& name) {
+    if (scenarios == "all") return true;
+    std::stringstream list(scenarios);
+    std::string entry;
+    while (std::getline(list, entry, ',')) {
+        if (entry == name) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    auto flags = make_flags(options);
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage(flags);
+            return 0;
+        }
+        const auto eq = arg.find('=');
+        const std::string name = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        auto flag = std::find_if(flags.begin(), flags.end(), [&](const Flag& f) { return f.name == name; });
+        if (arg.rfind("--", 0) != 0 || flag == flags.end()) {
+            fprintf(stderr, "Unknown option: %s\n\n", arg.c_str());
+            print_usage(flags);
+            return 2;
+        }
+        try {
+            // A bare boolean flag means true
+            flag->set(eq == std::string::npos ? "true" : arg.substr(eq + 1));
+        } catch (const std::exception& e) {
+            fprintf(stderr, "Bad value for --%s: %s\n", name.c_str(), e.what());
+            return 2;
+        }
+    }
+    options.threads = std::max<size_t>(options.threads, 1);
+    options.batch = std::max<size_t>(options.batch, 1);
+
+    const bool temporary = options.data_dir.empty();
+    if (temporary) {
+        options.data_dir = (fs::temp_directory_path() / ("findata_bench_" + std::to_string(getpid()))).string();
+    }
+    options.engine.data_directory = options.data_dir;
+
+    std::vector<Result> results;
+    EngineStats stats{};
+    try {
+        Bench bench(options);
+        if (selected(options.scenarios, "ingest")) {
+            results.push_back(bench.ingest("ingest", "SYM", 0.0));
+        }
+        if (selected(options.scenarios, "out_of_order")) {
+            results.push_back(bench.ingest("out_of_order", "OOO", options.disorder));
+        }
+        if (selected(options.scenarios, "get_latest")) {
+            results.push_back(bench.get_latest());
+        }
+        if (selected(options.scenarios, "read_narrow")) {
+            results.push_back(bench.read("read_narrow", options.narrow_points, options.reads));
+        }
+        if (selected(options.scenarios, "read_wide")) {
+            results.push_back(bench.read("read_wide", options.points, options.wide_reads));
+        }
+        if (selected(options.scenarios, "flush")) {
+            results.push_back(bench.flush());
+        }
+        if (selected(options.scenarios, "optimize_under_load")) {
+            auto [optimize, writes] = bench.optimize_under_load();
+            results.push_back(std::move(optimize));
+            results.push_back(std::move(writes));
+        }
+        stats = bench.stats();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    for (auto& result : results) {
+        std::sort(result.latencies_ns.begin(), result.latencies_ns.end());
+    }
+    print_table(results);
+
+    if (!options.json.empty()) {
+        FILE* out = options.json == "-" ? stdout : fopen(options.json.c_str(), "w");
+        if (out == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", options.json.c_str());
+            return 1;
+        }
+        write_json(out, flags, results, stats);
+        if (out != stdout) fclose(out);
+    }
+
+    if (!options.keep) {
+        std::error_code ec;
+        fs::remove_all(options.data_dir, ec);
+    }
+    return 0;
+}
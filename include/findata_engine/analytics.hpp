@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace findata_engine {
+namespace analytics {
+
+// What to compute in one pass. Windows are trailing and counted in points.
+struct RollingSpec {
+    std::vector<size_t> windows;
+    std::vector<double> ema_alphas;  // Each in (0, 1]
+    std::string volume_symbol;       // Non-empty enables VWAP, joined on timestamp
+};
+
+// Outputs for one window length. Entries are NaN until the window fills;
+// zscore is also NaN where the window has zero spread.
+struct RollingWindow {
+    size_t window;
+    std::vector<double> mean;
+    std::vector<double> stddev;  // Population standard deviation
+    std::vector<double> zscore;
+    std::vector<double> vwap;    // Empty without volumes
+};
+
+struct RollingResult {
+    std::vector<int64_t> timestamps; // system_clock ticks
+    std::vector<RollingWindow> windows;
+    std::vector<std::vector<double>> emas; // One per alpha, seeded with the first value
+};
+
+// Streaming evaluator: columns are pushed in chunks and every window is
+// updated in O(1) per point from a shared history ring, so the whole spec
+// costs one pass regardless of chunking.
+class RollingAnalyzer {
+public:
+    RollingAnalyzer(const RollingSpec& spec, bool with_volume);
+
+    // volumes must match values in size when the analyzer has volume
+    void push(std::span<const int64_t> timestamps,
+              std::span<const double> values,
+              std::span<const double> volumes = {});
+
+    RollingResult take_result();
+
+private:
+    struct WindowState {
+        double mean = 0.0;
+        double m2 = 0.0;          // Sum of squared deviations (Welford)
+        double price_volume = 0.0;
+        double volume = 0.0;
+    };
+
+    bool with_volume_;
+    size_t count_ = 0;
+    std::vector<double> history_;  // Last max-window values, indexed by count % size
+    std::vector<double> volume_history_;
+    std::vector<WindowState> states_;
+    std::vector<double> ema_alphas_;
+    std::vector<double> ema_state_;
+    RollingResult result_;
+};
+
+} // namespace analytics
+} // namespace findata_engine
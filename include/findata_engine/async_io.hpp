@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <sys/types.h>
+
+namespace findata_engine {
+
+// Positional file reads completed in the background. Uses io_uring where
+// the kernel allows it and otherwise a small pool of threads issuing pread,
+// so callers can put many reads in flight and work while they land.
+class AsyncReader {
+    struct Completion;
+    class Ring;
+
+public:
+    enum class Backend {
+        Auto,    // io_uring if available, else threads
+        IoUring, // Throws std::runtime_error if io_uring or its read op is missing
+        Threads,
+    };
+
+    // One read in flight. wait() blocks until it has landed and throws
+    // std::runtime_error on an I/O error or a read past end of file.
+    // Destroying an unwaited read still waits, so its buffer is never
+    // written after the handle is gone.
+    class Pending {
+    public:
+        Pending() = default;
+        Pending(Pending&&) noexcept;
+        Pending& operator=(Pending&&) noexcept;
+        ~Pending();
+
+        bool valid() const { return completion_ != nullptr; }
+        void wait();
+
+    private:
+        friend class AsyncReader;
+        explicit Pending(std::shared_ptr<Completion> completion);
+        void settle() noexcept; // Waits without reporting errors
+        std::shared_ptr<Completion> completion_;
+        bool waited_ = false;
+    };
+
+    // queue_depth bounds reads in flight; `threads` sizes the fallback pool
+    explicit AsyncReader(Backend backend = Backend::Auto, unsigned queue_depth = 64, size_t threads = 4);
+    ~AsyncReader();
+
+    AsyncReader(const AsyncReader&) = delete;
+    AsyncReader& operator=(const AsyncReader&) = delete;
+
+    // Reads dest.size() bytes at offset. fd and dest must stay valid until
+    // the read has been waited for.
+    Pending read(int fd, uint64_t offset, std::span<uint8_t> dest) const;
+
+    bool uses_io_uring() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace findata_engine
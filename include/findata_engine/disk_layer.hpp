@@ -1,43 +1,175 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
+#include <span>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <chrono>
 #include <filesystem>
 #include "memory_layer.hpp"
+#include "metrics.hpp"
+#include "symbol_catalog.hpp"
 
 namespace findata_engine {
 
+// Per-block payload encoding; stored in the segment header
+enum class BlockCodec : uint32_t {
+    None = 0,        // Raw timestamp and value columns, viewed in place
+    Zstd = 1,        // zstd over interleaved (timestamp, value) pairs
+    Gorilla = 2,     // Delta-of-delta timestamps and XOR-encoded values
+    GorillaZstd = 3, // Gorilla columns with zstd layered on top
+};
+
+// Summary of a set of values; min and max are only meaningful when count > 0
+struct RangeStats {
+    uint64_t count = 0;
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double value) {
+        ++count;
+        sum += value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    void merge(const RangeStats& other) {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
 struct DiskConfig {
-    bool enable_compression = true;
+    bool enable_compression = true;   // false writes BlockCodec::None
+    BlockCodec codec = BlockCodec::Gorilla;
     size_t batch_size = 1000;
     size_t max_segment_size_mb = 64;
+    size_t points_per_block = 1024; // Granularity of the per-segment sparse index
+    bool use_mmap = true;           // Read segments through read-only mappings
+    size_t read_ahead_blocks = 8;   // Without mmap, block reads kept in flight per segment being read
+    unsigned io_queue_depth = 64;   // Async reads in flight across the layer (io_uring, else threads)
+    size_t block_cache_size_mb = 64; // Budget for decoded compressed blocks
+    bool background_compaction = true;    // Merge small segments on worker threads
+    size_t compaction_threads = 1;
+    size_t compaction_fanin = 4;          // Segments of one size tier merged per job
+    size_t compaction_interval_ms = 1000; // Idle re-check period for workers
+};
+
+// Cumulative I/O counters and latency histograms of one DiskLayer
+struct DiskStats {
+    uint64_t bytes_read;         // Block bytes fetched from segment files or their mappings
+    uint64_t bytes_written;      // Segment files and manifest records
+    metrics::Summary decode;     // Per compressed block decoded on a cache miss
+    metrics::Summary compaction; // Per compaction job, from merge to install
+    metrics::Summary lock_wait;  // Contended acquisitions of the metadata lock
 };
 
 class DiskLayer {
+    struct Impl;
+
 public:
-    DiskLayer(const std::filesystem::path& data_directory, const DiskConfig& config = DiskConfig{});
+    // Pull-based, time-ordered read over one symbol's segments. Decodes one
+    // block per segment at a time; a timestamp stored in several segments
+    // resolves to the newest one, and one repeated within a segment to its
+    // last copy. Reads the segments current when it was opened: later
+    // flushes and compactions neither wait for it nor change what it
+    // returns, and files they replace stay until it is destroyed. Must not
+    // outlive its DiskLayer.
+    class Cursor {
+    public:
+        Cursor(Cursor&&) noexcept;
+        Cursor& operator=(Cursor&&) noexcept;
+        ~Cursor();
+
+        // Replaces batch with up to max_points points; false once exhausted
+        bool next(std::vector<TimeSeriesPoint>& batch, size_t max_points = 4096);
+
+    private:
+        friend class DiskLayer;
+        struct Impl;
+        explicit Cursor(std::unique_ptr<Impl> impl);
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+    // Symbol ids come from `catalog`; without one the layer keeps its own,
+    // persisted in data_directory
+    DiskLayer(const std::filesystem::path& data_directory,
+              const DiskConfig& config = DiskConfig{},
+              std::shared_ptr<SymbolCatalog> catalog = nullptr);
     ~DiskLayer();
 
+    const std::shared_ptr<SymbolCatalog>& catalog() const;
+
     // Write operations
     bool write_batch(const std::vector<TimeSeriesPoint>& points);
     bool commit_segment(const std::string& symbol);
 
     // Read operations
+    Cursor open_cursor(
+        const std::string& symbol,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end) const;
+    Cursor open_cursor(
+        SymbolId id,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end) const;
+
     std::vector<TimeSeriesPoint> read_range(
         const std::string& symbol,
         const std::chrono::system_clock::time_point& start,
         const std::chrono::system_clock::time_point& end);
 
-    // Maintenance operations
+    // Newest point of a symbol, found from segment metadata and one decoded
+    // block rather than a scan of its history
+    std::optional<TimeSeriesPoint> get_latest(const std::string& symbol) const;
+    // Newest timestamp on disk, from segment metadata alone
+    std::optional<std::chrono::system_clock::time_point> get_end_time(const std::string& symbol) const;
+    std::vector<std::string> get_symbols() const;
+
+    // Columnar read: visits [start, end] one block at a time, oldest segment
+    // first. Uncompressed blocks are served straight from the mapped file.
+    // Segments may overlap, so a timestamp can repeat; the later call wins.
+    // Spans are only valid during the callback. Like a cursor, the scan
+    // reads the segments current when it started and holds no lock while
+    // the visitor runs.
+    using ColumnVisitor = MemoryLayer::ColumnVisitor;
+    void scan_range(
+        const std::string& symbol,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end,
+        const ColumnVisitor& visitor) const;
+
+    // Count, sum, min and max over [start, end]. Blocks inside the range
+    // that no other segment overlaps are answered from the statistics in
+    // the block index; only the rest are decoded. Timestamps listed in
+    // `shadowed` (sorted ticks) are skipped, for points that a newer layer
+    // overrides.
+    RangeStats aggregate(
+        const std::string& symbol,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end,
+        std::span<const int64_t> shadowed = {}) const;
+
+    // Maintenance operations. Background workers merge runs of similarly
+    // sized segments; compact_segments merges all of a symbol's segments.
+    // Both stream-merge their inputs and install the result atomically.
     void compact_segments(const std::string& symbol);
     void optimize_index();
     size_t get_storage_size() const;
 
+    // Decoded-block cache counters (compressed segments only)
+    size_t get_cache_hits() const;
+    size_t get_cache_misses() const;
+    DiskStats get_stats() const;
+
 private:
-    struct Impl;
     std::unique_ptr<Impl> pimpl_;
 };
 
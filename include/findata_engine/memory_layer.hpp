@@ -1,7 +1,9 @@
 #pragma once
 
+#include "findata_engine/metrics.hpp"
 #include "findata_engine/utils.hpp"
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
@@ -9,7 +11,9 @@
 #include <unordered_set>
 #include <vector>
 #include <shared_mutex>
+#include <span>
 #include "findata_engine/types.hpp"
+#include "findata_engine/symbol_catalog.hpp"
 
 namespace findata_engine {
 
@@ -29,24 +33,95 @@ private:
     size_t total_points_;
     
 public:
-    explicit MemoryLayer(size_t cache_size_mb);
+    // Receives contiguous timestamp (system_clock ticks) and value columns
+    using ColumnVisitor = std::function<void(std::span<const int64_t>, std::span<const double>)>;
+
+    // Symbols are keyed by their id in `catalog`; a private in-memory
+    // catalog is used when none is shared
+    explicit MemoryLayer(size_t cache_size_mb, std::shared_ptr<SymbolCatalog> catalog = nullptr);
     ~MemoryLayer();
 
-    // Write operations
+    // Write operations. The SymbolId overload takes an id already assigned
+    // by the catalog and skips the name lookup. A single insert returns
+    // false for a timestamp already held; the batch forms keep the first
+    // copy and, given `accepted`, set it to one flag per input point, in
+    // input order, that is 1 where the point was new.
     bool insert(const TimeSeriesPoint& point);
-    bool insert_batch(const std::vector<TimeSeriesPoint>& points);
+    bool insert(SymbolId id, std::chrono::system_clock::time_point timestamp, double value);
+    bool insert_batch(const std::vector<TimeSeriesPoint>& points, std::vector<uint8_t>* accepted = nullptr);
+    // Bulk ingest of one symbol's columns (system_clock ticks). Cost is
+    // proportional to the batch plus whatever active points it overlaps;
+    // sorted input is not copied. False if the columns differ in length.
+    bool insert_columns(SymbolId id, std::span<const int64_t> timestamps, std::span<const double> values,
+                        std::vector<uint8_t>* accepted = nullptr);
 
     // Read operations
     std::optional<TimeSeriesPoint> get_latest(const std::string& symbol) const;
+    std::optional<TimeSeriesPoint> get_latest(SymbolId id) const;
     std::vector<TimeSeriesPoint> get_range(
         const std::string& symbol,
         std::chrono::system_clock::time_point start,
         std::chrono::system_clock::time_point end) const;
+    std::vector<TimeSeriesPoint> get_range(
+        SymbolId id,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end) const;
+
+    // Columnar read: visits [start, end] without materializing points.
+    // Called once per contiguous chunk, frozen memtable first, then active;
+    // each memtable's calls are in time order but the two may interleave.
+    // Spans are only valid during the callback.
+    void scan_range(
+        const std::string& symbol,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end,
+        const ColumnVisitor& visitor) const;
+
+    // Double-buffered flush: freeze() moves every symbol's active points into
+    // an immutable snapshot that stays readable while it is written out;
+    // release_frozen() drops a symbol's snapshot once it is on disk.
+    size_t freeze();
+    // Freezes only the given symbols; the rest keep accumulating
+    size_t freeze(std::span<const SymbolId> ids);
+    std::vector<TimeSeriesPoint> get_frozen(const std::string& symbol) const;
+    void release_frozen(const std::string& symbol);
+    std::vector<std::string> get_frozen_symbols() const;
 
     // Cache management
     void clear_cache();
     void flush();
-    size_t cache_size() const;
+    size_t cache_size() const; // Active points, excluding frozen snapshots
+
+    // Byte accounting over column capacity, including frozen snapshots.
+    // The budget is cache_size_mb; enforcing it is up to the caller.
+    size_t memory_usage() const;
+    // memory_usage less each symbol's own entry, which stays resident after
+    // its points are flushed; what spilling can bring under the budget
+    size_t releasable_usage() const;
+    size_t memory_budget() const;
+    // Column chunks released by flushes and kept for reuse; not part of
+    // memory_usage, and capped at a quarter of the budget
+    size_t pooled_bytes() const;
+
+    // Active footprint of each symbol holding unfrozen points, for choosing
+    // which to flush
+    struct SymbolUsage {
+        SymbolId id;
+        size_t bytes;
+        size_t points;
+        std::chrono::steady_clock::time_point active_since; // First write since its last freeze
+    };
+    std::vector<SymbolUsage> active_usage() const;
+
+    // Writes are stamped with the current epoch (the engine uses its WAL
+    // file id). oldest_epoch is the smallest stamp on any point still held,
+    // active or frozen, or nullopt when the layer is empty.
+    void set_epoch(uint64_t epoch);
+    std::optional<uint64_t> oldest_epoch() const;
+    // The epoch current when the symbol's snapshot was frozen; every write
+    // of the symbol made before that epoch was set is in the snapshot or
+    // was released earlier. nullopt if it has no snapshot.
+    std::optional<uint64_t> frozen_at(const std::string& symbol) const;
     
     // Symbol management
     std::unordered_set<std::string> get_symbols() const;
@@ -54,6 +129,8 @@ public:
     // Stats
     size_t get_total_points() const;
     double get_cache_hit_ratio() const;
+    // Time spent waiting for contended per-symbol locks
+    metrics::Summary lock_wait() const;
 
 private:
     struct Impl;
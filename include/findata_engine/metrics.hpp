@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+
+namespace findata_engine {
+namespace metrics {
+
+// Writers spread over this many cache-line-aligned shards, picked once per
+// thread, so hot counters are rarely shared between cores
+constexpr size_t NUM_SHARDS = 8;
+
+// Point-in-time view of a Histogram, in nanoseconds
+struct Summary {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+
+    double mean_ns() const { return count ? static_cast<double>(total_ns) / count : 0.0; }
+};
+
+// Log-linear latency histogram in the HDR style: 16 linear sub-buckets per
+// power of two, so reported quantiles are within 1/16 of the true value.
+// Recording is three relaxed atomic adds on the calling thread's shard.
+class Histogram {
+public:
+    void record(uint64_t ns);
+    void record(std::chrono::nanoseconds elapsed) {
+        record(static_cast<uint64_t>(std::max<int64_t>(elapsed.count(), 0)));
+    }
+
+    // Quantiles are the upper bound of their bucket, capped at max_ns
+    Summary summary() const;
+
+private:
+    static constexpr unsigned SUB_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BITS;
+    static constexpr size_t NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucket_of(uint64_t ns);
+    static uint64_t bucket_upper(size_t bucket);
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> counts{};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    std::array<Shard, NUM_SHARDS> shards_;
+};
+
+// Monotonic event or byte counter
+class Counter {
+public:
+    void add(uint64_t n = 1);
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    std::array<Shard, NUM_SHARDS> shards_;
+};
+
+// Records the time from construction to destruction
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram_.record(std::chrono::steady_clock::now() - start_); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Lock acquisition that records its wait only when the lock was contended,
+// so the uncontended path costs a single try_lock and no clock reads
+template<typename Mutex>
+std::unique_lock<Mutex> lock_unique(Mutex& mutex, Histogram& waits) {
+    std::unique_lock lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        const auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        waits.record(std::chrono::steady_clock::now() - start);
+    }
+    return lock;
+}
+
+template<typename Mutex>
+std::shared_lock<Mutex> lock_shared(Mutex& mutex, Histogram& waits) {
+    std::shared_lock lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        const auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        waits.record(std::chrono::steady_clock::now() - start);
+    }
+    return lock;
+}
+
+} // namespace metrics
+} // namespace findata_engine
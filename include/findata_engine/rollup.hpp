@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+namespace findata_engine {
+
+// One downsampled bucket of a series. start is aligned to a multiple of the
+// interval since the epoch.
+struct Bar {
+    std::chrono::system_clock::time_point start;
+    double open;
+    double high;
+    double low;
+    double close;
+    uint64_t count;
+    double sum;
+};
+
+namespace rollup {
+
+// A rollup is stored as an ordinary series named "<symbol>#<seconds>s".
+// Each bar is six points at start + 0..5 ticks: open, high, low, close,
+// count, sum. Intervals are whole seconds, so bars never collide.
+std::string series_name(const std::string& symbol, std::chrono::seconds interval);
+// True for names series_name can produce
+bool is_series_name(std::string_view name);
+
+std::chrono::system_clock::time_point bucket_start(
+    std::chrono::system_clock::time_point tp, std::chrono::seconds interval);
+// Last tick of the bucket holding tp, saturating at time_point::max()
+std::chrono::system_clock::time_point bucket_end(
+    std::chrono::system_clock::time_point tp, std::chrono::seconds interval);
+
+// Folds points, sorted by timestamp, into bars
+std::vector<Bar> build(std::span<const TimeSeriesPoint> points, std::chrono::seconds interval);
+// Folds one tick into bars built so far; ticks must come in time order
+void add(std::vector<Bar>& bars, std::chrono::system_clock::time_point timestamp, double value,
+         std::chrono::seconds interval);
+
+// Merges two sorted bar series. Bars sharing a bucket are combined with
+// `earlier` supplying the open and `later` the close.
+std::vector<Bar> merge(const std::vector<Bar>& earlier, const std::vector<Bar>& later);
+
+std::vector<TimeSeriesPoint> to_points(const std::string& series, const std::vector<Bar>& bars);
+// Incomplete bars (fewer than six fields) are dropped
+std::vector<Bar> from_points(const std::vector<TimeSeriesPoint>& points);
+
+} // namespace rollup
+} // namespace findata_engine
@@ -6,7 +6,7 @@
 extern "C" {
 
 struct TimePoint {
-    int64_t timestamp;  // microseconds since epoch
+    int64_t timestamp;  // system_clock ticks since epoch
     double value;
 };
 
@@ -19,6 +19,23 @@ struct CompressedData {
 uint8_t* compress_time_series(const TimePoint* points, size_t len, size_t* out_size);
 TimePoint* decompress_time_series(const uint8_t* data, size_t size, size_t* out_len);
 void free_compressed_data(uint8_t* data, size_t size);
+
+// Copy-free column codec: same frame as compress_time_series, but reads and
+// writes caller-owned buffers. Return 0 on success, 1 if the output buffer
+// is too small, -1 on corrupt input.
+size_t compress_columns_bound(size_t len);
+int compress_columns(const int64_t* timestamps, const double* values, size_t len, int level,
+                     uint8_t* out, size_t out_capacity, size_t* out_size);
+int decompress_columns(const uint8_t* data, size_t size, int64_t* timestamps, double* values,
+                       size_t capacity, size_t* out_len);
+
+// Raw zstd into caller-owned buffers, same return codes
+size_t zstd_compress_bound(size_t size);
+int zstd_compress_into(const uint8_t* data, size_t size, int level,
+                       uint8_t* out, size_t out_capacity, size_t* out_size);
+size_t zstd_decompressed_size(const uint8_t* data, size_t size); // 0 if unknown
+int zstd_decompress_into(const uint8_t* data, size_t size,
+                         uint8_t* out, size_t out_capacity, size_t* out_size);
 void free_time_points(TimePoint* points, size_t len);
 
 // SIMD operations
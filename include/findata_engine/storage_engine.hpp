@@ -2,37 +2,110 @@
 
 #include "memory_layer.hpp"
 #include "disk_layer.hpp"
+#include "rollup.hpp"
+#include "analytics.hpp"
+#include "subscription.hpp"
 #include <filesystem>
 #include <memory>
 #include <string>
 #include <vector>
 #include <chrono>
 #include <optional>
+#include <span>
 #include <unordered_set>
+#include <functional>
 
 namespace findata_engine {
 
+// Forwarded to the DiskConfig of the engine's disk layer
 struct DiskLayerConfig {
-    size_t disk_cache_size_mb;
-    size_t max_disk_segment_size_mb;
+    size_t disk_cache_size_mb = 64; // Decoded-block cache budget
+    size_t max_disk_segment_size_mb = 64;
+    size_t points_per_block = 1024;
+    bool use_mmap = true;
+    size_t read_ahead_blocks = 8;
+    size_t compaction_threads = 1;
+};
+
+// Which symbols a background flush spills once the memtable is over budget
+enum class FlushPolicy {
+    Largest, // Biggest memory footprint first
+    Oldest,  // Longest-unflushed first, which also bounds WAL retention
 };
 
 struct EngineConfig {
-    size_t memory_cache_size_mb = 256;
+    size_t memory_cache_size_mb = 256;        // Memtable byte budget, frozen snapshots included; 0 disables it
     std::filesystem::path data_directory;
     bool enable_compression = true;
     size_t batch_size = 1000;
     size_t max_segment_size_mb = 64;
     size_t max_memory_points = 1000000; // Maximum points to keep in memory before flushing
-    DiskLayerConfig disk_config;
+    DiskLayerConfig disk_config = {};
+    bool enable_wal = true;                   // Log writes under data_directory/wal, replayed on open
+    size_t wal_group_commit_us = 200;         // Max delay before a group of WAL records is fsynced
+    size_t wal_group_commit_bytes = 1 << 20;  // Sync a group early once this many bytes are buffered
+    // Off, writes return once their WAL record is buffered, and a crash can
+    // lose up to wal_group_commit_us of them. On, each write waits for its
+    // group's fdatasync, which caps single-writer throughput.
+    bool wal_sync_commit = false;
+    BlockCodec compression_codec = BlockCodec::Gorilla; // Segment codec when enable_compression is set
+    size_t scan_threads = 0;                  // Workers for read_range_multi, started on first use; 0 uses all cores
+    std::vector<std::chrono::seconds> rollup_intervals = {}; // Bar sizes materialized at flush, e.g. {1s, 60s}
+    // Over budget, the flush thread spills symbols in this order until usage
+    // is back under half of both limits; the rest stay resident. Under
+    // Largest a quiet symbol can keep its WAL files alive until flush().
+    FlushPolicy flush_policy = FlushPolicy::Largest;
 };
 
+enum class AggregateOp {
+    Count,
+    Min,
+    Max,
+    Sum,
+    Mean,
+};
+
+// Snapshot for scraping. Counters and histograms are cumulative since the
+// engine opened; latencies are in nanoseconds, and lock waits count only
+// acquisitions that had to block.
 struct EngineStats {
-    size_t total_points;
+    size_t total_points;   // Points accepted by writes
     size_t cache_hits;
     size_t cache_misses;
     double cache_hit_ratio;
     size_t storage_size_bytes;
+    size_t memory_bytes; // Memtable footprint, see MemoryLayer::memory_usage
+    size_t rejected_points;    // Writes dropped for a timestamp the memtable already held
+    uint64_t bytes_read;       // See DiskStats
+    uint64_t bytes_written;
+    metrics::Summary write_latency;      // Per write_point, write_batch or write_columns call
+    metrics::Summary read_latency;       // Per read_range or aggregate call
+    metrics::Summary flush_latency;      // Per flush, background or explicit
+    metrics::Summary compaction_latency; // Per compaction job
+    metrics::Summary decode_latency;     // Per block decoded on a block cache miss
+    metrics::Summary engine_lock_wait;   // Flush serialization and the rollup lock
+    metrics::Summary memory_lock_wait;   // Memtable per-symbol locks
+    metrics::Summary disk_lock_wait;     // Segment metadata lock
+    std::string simd_level;              // Codec kernel variant in use, see utils::simd_level
+};
+
+// Streaming, time-ordered read of one symbol across memory and disk.
+// Memory holds at most one snapshot of the memtable range plus one decoded
+// block per overlapping segment. Must not outlive its StorageEngine.
+class RangeCursor {
+public:
+    RangeCursor(RangeCursor&&) noexcept;
+    RangeCursor& operator=(RangeCursor&&) noexcept;
+    ~RangeCursor();
+
+    // Replaces batch with up to max_points points; false once exhausted
+    bool next(std::vector<TimeSeriesPoint>& batch, size_t max_points = 4096);
+
+private:
+    friend class StorageEngine;
+    struct Impl;
+    explicit RangeCursor(std::unique_ptr<Impl> impl);
+    std::unique_ptr<Impl> pimpl_;
 };
 
 class StorageEngine {
@@ -40,18 +113,97 @@ public:
     explicit StorageEngine(const EngineConfig& config);
     ~StorageEngine();
 
+    // Symbol catalog shared by every layer. Ids are dense and stable across
+    // restarts; the SymbolId overloads below skip the name lookup.
+    // symbol_name throws std::out_of_range for an unassigned id. Names of
+    // the form "<symbol>#<N>s" are reserved for rollup series: intern_symbol,
+    // write_point and write_batch throw std::invalid_argument for them.
+    SymbolId intern_symbol(const std::string& symbol);
+    std::optional<SymbolId> find_symbol(const std::string& symbol) const;
+    const std::string& symbol_name(SymbolId id) const;
+
     // Write operations
     bool write_point(const TimeSeriesPoint& point);
+    bool write_point(SymbolId id, std::chrono::system_clock::time_point timestamp, double value);
     bool write_batch(const std::vector<TimeSeriesPoint>& points);
+    // Bulk ingest of one symbol's columns (system_clock ticks), logged to
+    // the WAL as one record without building points. Cost is proportional
+    // to the batch plus the memtable points it overlaps. The memtable keeps
+    // the first copy of a timestamp, as with write_batch.
+    bool write_columns(SymbolId id, std::span<const int64_t> timestamps, std::span<const double> values);
     bool flush();
 
     // Read operations
+    RangeCursor open_cursor(
+        const std::string& symbol,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end);
+    RangeCursor open_cursor(
+        SymbolId id,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end);
+
     std::vector<TimeSeriesPoint> read_range(
         const std::string& symbol,
         std::chrono::system_clock::time_point start,
         std::chrono::system_clock::time_point end);
+    std::vector<TimeSeriesPoint> read_range(
+        SymbolId id,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end);
+
+    // Reads the same window for many symbols on the scan pool. The callback
+    // gets each symbol's full range as soon as it is read, possibly from
+    // several threads at once. Returns once every symbol is delivered and
+    // rethrows the first exception raised by a read or the callback.
+    using SymbolRangeCallback =
+        std::function<void(const std::string& symbol, std::vector<TimeSeriesPoint>&& points)>;
+    void read_range_multi(
+        const std::vector<std::string>& symbols,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end,
+        const SymbolRangeCallback& callback);
+
+    // Bars whose bucket starts in [bucket_start(start), end], each covering
+    // its whole bucket. Served from the stored rollup when the interval is
+    // in rollup_intervals, with unflushed ticks folded in (buckets where
+    // they may rewrite a flushed tick are recomputed); otherwise computed
+    // from ticks. A timestamp written twice counts once, with its newest
+    // value.
+    std::vector<Bar> read_bars(
+        const std::string& symbol,
+        std::chrono::seconds interval,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end);
+
+    // Reduces [start, end] without materializing points; on disk, only
+    // blocks at the range edges or shared with another segment are
+    // decoded. Empty ranges give 0 for Count and Sum, nullopt otherwise.
+    std::optional<double> aggregate(
+        const std::string& symbol,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end,
+        AggregateOp op);
+
+    // Rolling mean/stddev/z-score (and VWAP when spec.volume_symbol is
+    // set) for every window in spec, plus EMAs, in one streaming pass over
+    // [start, end]. With a volume symbol only timestamps present in both
+    // series are used.
+    analytics::RollingResult analyze(
+        const std::string& symbol,
+        std::chrono::system_clock::time_point start,
+        std::chrono::system_clock::time_point end,
+        const analytics::RollingSpec& spec);
 
     std::optional<TimeSeriesPoint> get_latest(const std::string& symbol);
+    std::optional<TimeSeriesPoint> get_latest(SymbolId id);
+
+    // Push delivery instead of polling get_latest. Writes reach subscribers
+    // as written, once the memtable has taken them and before they are
+    // logged; see SubscriptionHub for the costs on each side.
+    Subscription subscribe(const std::vector<std::string>& symbols, const SubscriptionOptions& options = {});
+    Subscription subscribe(std::span<const SymbolId> symbols, const SubscriptionOptions& options = {});
+    // Symbols with data in memory or on disk
     std::unordered_set<std::string> get_symbols() const;
 
     // Maintenance operations
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "symbol_catalog.hpp"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace findata_engine {
+
+// One write delivered to a subscriber
+struct Tick {
+    SymbolId symbol;
+    int64_t timestamp = 0; // system_clock ticks
+    double value = 0.0;
+    double vwap = std::numeric_limits<double>::quiet_NaN(); // Running VWAP after this tick when requested
+};
+
+// Running volume-weighted average price over a price and a volume series
+// written at matching timestamps, in either order
+struct VwapSpec {
+    SymbolId price;
+    SymbolId volume;
+};
+
+struct SubscriptionOptions {
+    size_t capacity = 4096; // Ring slots, rounded up to a power of two; ticks past it are dropped
+    bool conflate = false;  // Keep only each symbol's newest tick until polled; never drops
+    std::optional<VwapSpec> vwap = std::nullopt; // Both series are subscribed implicitly
+};
+
+// Receiving end of a subscription. Polling reads the subscriber's own ring
+// and takes no lock shared with writers. Unsubscribes on destruction and
+// may outlive the hub that created it, after which it only drains.
+class Subscription {
+public:
+    Subscription(Subscription&&) noexcept;
+    Subscription& operator=(Subscription&&) noexcept;
+    ~Subscription();
+
+    // Moves up to out.size() pending ticks into out and returns how many.
+    // Unconflated ticks come in publish order; conflated ones in the order
+    // their symbols first changed since the last poll. Never blocks. Only
+    // one thread may poll a subscription at a time.
+    size_t poll(std::span<Tick> out);
+
+    // Ticks lost to a full ring so far; always 0 when conflating
+    size_t dropped() const;
+
+private:
+    friend class SubscriptionHub;
+    struct Impl;
+    explicit Subscription(std::unique_ptr<Impl> impl);
+    std::unique_ptr<Impl> pimpl_;
+};
+
+// Fans accepted writes out to subscribers. Writers publish straight into
+// each subscriber's SPSC ring. Concurrent writers serialize per subscriber
+// on a short spin lock around the push, which readers never touch. A
+// symbol nobody subscribes to costs one table lookup per publish.
+class SubscriptionHub {
+public:
+    SubscriptionHub();
+    ~SubscriptionHub();
+
+    SubscriptionHub(const SubscriptionHub&) = delete;
+    SubscriptionHub& operator=(const SubscriptionHub&) = delete;
+
+    Subscription subscribe(std::span<const SymbolId> symbols, const SubscriptionOptions& options = {});
+
+    // True while any subscription is open
+    bool active() const;
+
+    void publish(SymbolId id, int64_t timestamp, double value);
+    void publish(SymbolId id, std::span<const int64_t> timestamps, std::span<const double> values);
+
+private:
+    friend class Subscription;
+    struct State;
+    std::shared_ptr<State> state_;
+};
+
+} // namespace findata_engine
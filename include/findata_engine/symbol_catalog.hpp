@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace findata_engine {
+
+// Dense integer handle for a symbol name, assigned by a SymbolCatalog
+using SymbolId = uint32_t;
+
+// Flat table indexed by SymbolId. Slots live in fixed-size chunks that are
+// never moved or freed before the table, so lookups take no lock and the
+// returned pointers stay valid.
+template<typename T>
+class SymbolTable {
+public:
+    static constexpr size_t CHUNK_SIZE = 1024;
+    static constexpr size_t NUM_CHUNKS = 4096;
+    static constexpr size_t CAPACITY = CHUNK_SIZE * NUM_CHUNKS;
+
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    ~SymbolTable() {
+        for (auto& chunk_ptr : chunks_) {
+            Chunk* chunk = chunk_ptr.load(std::memory_order_relaxed);
+            if (chunk == nullptr) continue;
+            for (auto& slot : *chunk) {
+                delete slot.load(std::memory_order_relaxed);
+            }
+            delete chunk;
+        }
+    }
+
+    T* find(SymbolId id) const {
+        if (id >= CAPACITY) return nullptr;
+        Chunk* chunk = chunks_[id / CHUNK_SIZE].load(std::memory_order_acquire);
+        return chunk ? (*chunk)[id % CHUNK_SIZE].load(std::memory_order_acquire) : nullptr;
+    }
+
+    // Returns the entry for id, constructing it from args if absent. Racing
+    // creators agree on a single winner.
+    template<typename... Args>
+    T& get_or_create(SymbolId id, Args&&... args) {
+        if (id >= CAPACITY) {
+            throw std::out_of_range("Symbol id exceeds table capacity");
+        }
+        auto& slot = chunk_for(id)[id % CHUNK_SIZE];
+        if (T* existing = slot.load(std::memory_order_acquire)) {
+            return *existing;
+        }
+        auto created = std::make_unique<T>(std::forward<Args>(args)...);
+        T* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, created.get(), std::memory_order_acq_rel)) {
+            return *created.release();
+        }
+        return *expected;
+    }
+
+private:
+    using Chunk = std::array<std::atomic<T*>, CHUNK_SIZE>;
+
+    Chunk& chunk_for(SymbolId id) {
+        auto& chunk_ptr = chunks_[id / CHUNK_SIZE];
+        if (Chunk* chunk = chunk_ptr.load(std::memory_order_acquire)) {
+            return *chunk;
+        }
+        auto created = std::make_unique<Chunk>();
+        Chunk* expected = nullptr;
+        if (chunk_ptr.compare_exchange_strong(expected, created.get(), std::memory_order_acq_rel)) {
+            return *created.release();
+        }
+        return *expected;
+    }
+
+    std::array<std::atomic<Chunk*>, NUM_CHUNKS> chunks_{};
+};
+
+// Assigns dense ids to symbol names. A file-backed catalog appends and syncs
+// each new assignment before intern returns, so ids survive restarts.
+class SymbolCatalog {
+public:
+    SymbolCatalog(); // In-memory only
+    explicit SymbolCatalog(const std::filesystem::path& file);
+    ~SymbolCatalog();
+
+    // Id for name, assigning the next free one on first sight
+    SymbolId intern(std::string_view name);
+    std::optional<SymbolId> find(std::string_view name) const;
+
+    // Throws std::out_of_range for an id this catalog never assigned
+    const std::string& name(SymbolId id) const;
+
+    // One past the largest assigned id; ids below it may be iterated
+    SymbolId size() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace findata_engine
@@ -1,28 +1,68 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstdint>
 #include <vector>
 #include <string_view>
 #include <chrono>
 #include <span>
-#include <immintrin.h>
 #include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include "types.hpp"
 
 namespace findata_engine {
 namespace utils {
 
-// SIMD-optimized compression for numerical data
+// Gorilla-style column codecs: XOR-encoded doubles and delta-of-delta
+// timestamps (system_clock ticks). Both streams start with a uint64 count.
 std::vector<uint8_t> compress_doubles(std::span<const double> data);
-std::vector<double> decompress_doubles(const std::vector<uint8_t>& compressed_data);
+std::vector<double> decompress_doubles(std::span<const uint8_t> compressed_data);
+std::vector<uint8_t> compress_timestamps(std::span<const int64_t> timestamps);
+std::vector<int64_t> decompress_timestamps(std::span<const uint8_t> compressed);
+
+// Same codecs over caller-owned buffers, so reused scratch space keeps its
+// capacity: compress_* append to out, decompress_* replace its contents
+void compress_doubles(std::span<const double> data, std::vector<uint8_t>& out);
+void decompress_doubles(std::span<const uint8_t> compressed_data, std::vector<double>& out);
+void compress_timestamps(std::span<const int64_t> timestamps, std::vector<uint8_t>& out);
+void decompress_timestamps(std::span<const uint8_t> compressed, std::vector<int64_t>& out);
+
+// Instruction sets the kernels below are built for. The best one both the
+// build and the host support is picked via CPUID on first use;
+// FINDATA_SIMD=scalar|avx2|avx512 in the environment caps it.
+enum class SimdLevel { Scalar, Avx2, Avx512 };
+
+SimdLevel simd_level();
+bool simd_supported(SimdLevel level);
+// Switches every later kernel call, e.g. to compare variants; throws if the
+// level is not supported
+void set_simd_level(SimdLevel level);
+const char* simd_level_name(SimdLevel level);
+
+// In-place inclusive scans used to rebuild decoded columns. prefix_sum and
+// prefix_xor run the simd_level() variant; the _scalar variants are the
+// reference implementations.
+void prefix_sum(std::span<int64_t> data);
+void prefix_xor(std::span<uint64_t> data);
+void prefix_sum_scalar(std::span<int64_t> data);
+void prefix_xor_scalar(std::span<uint64_t> data);
 
 // Time-series specific compression
 std::vector<uint8_t> compress_time_series(const std::vector<TimeSeriesPoint>& points);
 std::vector<TimeSeriesPoint> decompress_time_series(const std::vector<uint8_t>& compressed);
 
+// Checksum used by on-disk record formats
+uint32_t crc32(const uint8_t* data, size_t size);
+
 // Add hash function for time_point
 struct TimePointHash {
     std::size_t operator()(const std::chrono::system_clock::time_point& tp) const {
@@ -34,8 +74,13 @@ struct TimePointHash {
 class MemoryMappedFile {
 public:
     MemoryMappedFile(const std::string& path, size_t size);
+    // Maps an existing file read-only at its current size
+    explicit MemoryMappedFile(const std::string& path);
     ~MemoryMappedFile();
 
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
     void* data() const { return data_; }
     size_t size() const { return size_; }
     void flush();
@@ -45,22 +90,156 @@ private:
     void* data_;
     size_t size_;
     int fd_;
+    bool read_only_ = false;
+};
+
+// Fixed set of worker threads draining a FIFO task queue. Tasks still
+// queued at destruction are run before the workers are joined.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    size_t size() const { return workers_.size(); }
+
+private:
+    void worker_loop();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
 };
 
-// Cache management utilities
+// Recycles heap objects such as scratch buffers, so steady-state work stops
+// allocating. acquire() hands out a shared_ptr whose deleter returns the
+// object, contents and capacity intact, for the next caller to overwrite.
+// Past max_idle idle objects, or once the pool is gone, they are freed.
+template<typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t max_idle) : state_(std::make_shared<State>()) {
+        state_->max_idle = max_idle;
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    std::shared_ptr<T> acquire() const {
+        std::unique_ptr<T> object;
+        {
+            std::lock_guard lock(state_->mutex);
+            if (!state_->idle.empty()) {
+                object = std::move(state_->idle.back());
+                state_->idle.pop_back();
+            }
+        }
+        if (!object) {
+            object = std::make_unique<T>();
+        }
+        std::weak_ptr<State> weak = state_;
+        return std::shared_ptr<T>(object.release(), [weak](T* released) {
+            std::unique_ptr<T> owned(released);
+            if (auto state = weak.lock()) {
+                std::lock_guard lock(state->mutex);
+                if (state->idle.size() < state->max_idle) {
+                    state->idle.push_back(std::move(owned));
+                }
+            }
+        });
+    }
+
+    size_t idle() const {
+        std::lock_guard lock(state_->mutex);
+        return state_->idle.size();
+    }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<T>> idle;
+        size_t max_idle = 0;
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+// Bounded single-producer single-consumer queue. Neither side blocks,
+// locks or allocates; each writes only its own index and caches the
+// other's, so the shared cache lines move only when the cache runs out.
+// Capacity is rounded up to a power of two.
+template<typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : slots_(std::bit_ceil(std::max<size_t>(capacity, 2))), mask_(slots_.size() - 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return slots_.size(); }
+
+    // Producer side; false when full
+    bool push(const T& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == slots_.size()) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == slots_.size()) return false;
+        }
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: moves up to out.size() items into out, oldest first
+    size_t pop(std::span<T> out) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head < out.size()) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+        }
+        const size_t count = std::min(cached_tail_ - head, out.size());
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = std::move(slots_[(head + i) & mask_]);
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    bool pop(T& item) {
+        return pop(std::span<T>(&item, 1)) == 1;
+    }
+
+private:
+    std::vector<T> slots_;
+    const size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0}; // Next slot to pop
+    size_t cached_tail_ = 0;                  // Consumer's view of tail_
+    alignas(64) std::atomic<size_t> tail_{0}; // Next slot to fill
+    size_t cached_head_ = 0;                  // Producer's view of head_
+};
+
+// Cache management utilities. Capacity is measured in charge units: one per
+// entry by default, or whatever the caller passes (e.g. bytes) to put().
 template<typename K, typename V, typename Hash = std::hash<K>>
 class LRUCache {
 private:
     struct Node {
         K key;
         V value;
+        size_t charge;
         Node* prev;
         Node* next;
         
-        Node(const K& k, const V& v) : key(k), value(v), prev(nullptr), next(nullptr) {}
+        Node(const K& k, const V& v, size_t c) : key(k), value(v), charge(c), prev(nullptr), next(nullptr) {}
     };
     
     size_t max_size_;
+    size_t total_charge_ = 0;
     Node* head_;
     Node* tail_;
     std::unordered_map<K, std::unique_ptr<Node>, Hash> cache_;
@@ -88,6 +267,15 @@ private:
         else tail_ = node->prev;
     }
     
+    void evict_to_capacity() {
+        while (total_charge_ > max_size_ && tail_) {
+            Node* victim = tail_;
+            remove_node(victim);
+            total_charge_ -= victim->charge;
+            cache_.erase(victim->key);
+        }
+    }
+    
 public:
     explicit LRUCache(size_t max_size) : max_size_(max_size), head_(nullptr), tail_(nullptr) {}
     
@@ -100,15 +288,21 @@ public:
         return node->value;
     }
     
-    void put(const K& key, V value) {
+    void put(const K& key, V value, size_t charge = 1) {
+        // Entries larger than the whole cache are not worth keeping
+        if (charge > max_size_) return;
+        
         auto it = cache_.find(key);
         if (it != cache_.end()) {
-            it->second->value = value;
+            total_charge_ = total_charge_ - it->second->charge + charge;
+            it->second->value = std::move(value);
+            it->second->charge = charge;
             move_to_front(it->second.get());
+            evict_to_capacity();
             return;
         }
         
-        auto node = std::make_unique<Node>(key, value);
+        auto node = std::make_unique<Node>(key, value, charge);
         Node* node_ptr = node.get();
         
         if (!head_) {
@@ -120,24 +314,23 @@ public:
         }
         
         cache_[key] = std::move(node);
-        
-        if (cache_.size() > max_size_) {
-            auto old_key = tail_->key;
-            Node* new_tail = tail_->prev;
-            new_tail->next = nullptr;
-            cache_.erase(old_key);
-            tail_ = new_tail;
-        }
+        total_charge_ += charge;
+        evict_to_capacity();
     }
     
     void clear() {
         cache_.clear();
         head_ = tail_ = nullptr;
+        total_charge_ = 0;
     }
     
     size_t size() const {
         return cache_.size();
     }
+    
+    size_t charge() const {
+        return total_charge_;
+    }
 };
 
 } // namespace utils
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+
+namespace findata_engine {
+
+struct WalConfig {
+    size_t group_commit_us = 200;            // Max time a record waits for its fsync batch
+    size_t group_commit_bytes = 1024 * 1024; // Batch is synced early once this much is buffered
+    bool sync_commit = true;                 // Block appenders until their record is durable
+};
+
+// Append-only write-ahead log split into numbered files. Appends from many
+// threads are buffered and made durable by a single committer thread with
+// one fdatasync per group.
+class WriteAheadLog {
+public:
+    WriteAheadLog(const std::filesystem::path& directory, const WalConfig& config = WalConfig{});
+    ~WriteAheadLog();
+
+    // Write operations; return false once the log has hit an I/O error
+    bool append(const TimeSeriesPoint& point);
+    bool append(const std::vector<TimeSeriesPoint>& points);
+    // One symbol's columns (system_clock ticks), logged as a single record
+    bool append(std::string_view symbol, std::span<const int64_t> timestamps, std::span<const double> values);
+
+    // Starts a new log file and returns its id. Every record appended before
+    // the call lives in a file with a smaller id.
+    uint64_t rotate();
+
+    // Records that each symbol's points in files with a smaller id than
+    // the one paired with it are persisted elsewhere, for replay to skip.
+    // Lets a partial flush retire a symbol whose files must still be kept.
+    bool mark_flushed(const std::vector<std::pair<std::string, uint64_t>>& symbols);
+
+    // Deletes log files whose contents are already persisted elsewhere
+    void truncate_before(uint64_t file_id);
+
+    // Feeds every intact record from existing log files, oldest first,
+    // less the points mark_flushed retired. Stops reading a file at its
+    // first torn or corrupt record. Returns points replayed.
+    size_t replay(const std::function<void(std::vector<TimeSeriesPoint>&&)>& consumer);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace findata_engine
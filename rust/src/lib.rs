@@ -4,7 +4,7 @@ use std::slice;
 
 #[repr(C)]
 pub struct TimePoint {
-    timestamp: i64,  // microseconds since epoch
+    timestamp: i64,  // system_clock ticks since epoch
     value: f64,
 }
 
@@ -36,15 +36,191 @@ pub extern "C" fn compress_time_series(
     // Compress using zstd
     let compressed = zstd::encode_all(&bytes[..], 3).unwrap();
     
-    // Set output size
+    into_raw_bytes(compressed, out_size)
+}
+
+// Hands a byte buffer to C. The boxed slice has capacity == len, which is
+// what free_compressed_data reconstructs.
+fn into_raw_bytes(bytes: Vec<u8>, out_size: *mut size_t) -> *mut u8 {
+    let bytes = bytes.into_boxed_slice();
     unsafe {
-        *out_size = compressed.len();
+        *out_size = bytes.len();
+    }
+    Box::into_raw(bytes) as *mut u8
+}
+
+// Column-oriented codec. Produces the same zstd frame as
+// compress_time_series (interleaved little-endian (timestamp, value) pairs)
+// but reads caller-owned columns and writes into a caller-owned buffer.
+// Return codes: 0 ok, 1 output buffer too small, -1 corrupt input.
+const COLUMN_CHUNK_POINTS: usize = 256;
+const POINT_BYTES: usize = 16;
+
+#[no_mangle]
+pub extern "C" fn compress_columns_bound(len: size_t) -> size_t {
+    // Streaming adds a few bytes of block framing over the one-shot bound
+    zstd::zstd_safe::compress_bound(len * POINT_BYTES) + 64
+}
+
+#[no_mangle]
+pub extern "C" fn compress_columns(
+    timestamps: *const i64,
+    values: *const c_double,
+    len: size_t,
+    level: c_int,
+    out: *mut u8,
+    out_capacity: size_t,
+    out_size: *mut size_t,
+) -> c_int {
+    use std::io::Write;
+
+    let timestamps = unsafe { slice::from_raw_parts(timestamps, len) };
+    let values = unsafe { slice::from_raw_parts(values, len) };
+    let out = unsafe { slice::from_raw_parts_mut(out, out_capacity) };
+
+    let mut encoder = match zstd::stream::write::Encoder::new(std::io::Cursor::new(out), level) {
+        Ok(encoder) => encoder,
+        Err(_) => return -1,
+    };
+
+    // Interleave through a small stack buffer instead of a full copy
+    let mut chunk = [0u8; COLUMN_CHUNK_POINTS * POINT_BYTES];
+    for (ts_chunk, value_chunk) in timestamps
+        .chunks(COLUMN_CHUNK_POINTS)
+        .zip(values.chunks(COLUMN_CHUNK_POINTS))
+    {
+        for (i, (ts, value)) in ts_chunk.iter().zip(value_chunk).enumerate() {
+            chunk[i * POINT_BYTES..i * POINT_BYTES + 8].copy_from_slice(&ts.to_le_bytes());
+            chunk[i * POINT_BYTES + 8..(i + 1) * POINT_BYTES].copy_from_slice(&value.to_le_bytes());
+        }
+        if encoder.write_all(&chunk[..ts_chunk.len() * POINT_BYTES]).is_err() {
+            return 1;
+        }
+    }
+
+    match encoder.finish() {
+        Ok(cursor) => {
+            unsafe {
+                *out_size = cursor.position() as size_t;
+            }
+            0
+        }
+        Err(_) => 1,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn decompress_columns(
+    data: *const u8,
+    size: size_t,
+    timestamps: *mut i64,
+    values: *mut c_double,
+    capacity: size_t,
+    out_len: *mut size_t,
+) -> c_int {
+    use std::io::Read;
+
+    let input = unsafe { slice::from_raw_parts(data, size) };
+    let timestamps = unsafe { slice::from_raw_parts_mut(timestamps, capacity) };
+    let values = unsafe { slice::from_raw_parts_mut(values, capacity) };
+
+    let mut decoder = match zstd::stream::read::Decoder::with_buffer(input) {
+        Ok(decoder) => decoder,
+        Err(_) => return -1,
+    };
+
+    let mut chunk = [0u8; COLUMN_CHUNK_POINTS * POINT_BYTES];
+    let mut filled = 0;
+    let mut count = 0;
+    loop {
+        let n = match decoder.read(&mut chunk[filled..]) {
+            Ok(0) => break,
+            Ok(n) => n,
+            Err(_) => return -1,
+        };
+        filled += n;
+
+        // De-interleave every complete record straight into the columns
+        let complete = filled / POINT_BYTES;
+        if count + complete > capacity {
+            return 1;
+        }
+        for i in 0..complete {
+            let record = &chunk[i * POINT_BYTES..(i + 1) * POINT_BYTES];
+            timestamps[count] = i64::from_le_bytes(record[..8].try_into().unwrap());
+            values[count] = f64::from_le_bytes(record[8..].try_into().unwrap());
+            count += 1;
+        }
+        chunk.copy_within(complete * POINT_BYTES..filled, 0);
+        filled -= complete * POINT_BYTES;
+    }
+    if filled != 0 {
+        return -1;
+    }
+
+    unsafe {
+        *out_len = count;
+    }
+    0
+}
+
+// Raw zstd over caller-owned buffers, same return codes as above
+#[no_mangle]
+pub extern "C" fn zstd_compress_bound(size: size_t) -> size_t {
+    zstd::zstd_safe::compress_bound(size)
+}
+
+#[no_mangle]
+pub extern "C" fn zstd_compress_into(
+    data: *const u8,
+    size: size_t,
+    level: c_int,
+    out: *mut u8,
+    out_capacity: size_t,
+    out_size: *mut size_t,
+) -> c_int {
+    let input = unsafe { slice::from_raw_parts(data, size) };
+    let out = unsafe { slice::from_raw_parts_mut(out, out_capacity) };
+    match zstd::bulk::compress_to_buffer(input, out, level) {
+        Ok(written) => {
+            unsafe {
+                *out_size = written;
+            }
+            0
+        }
+        Err(_) => 1,
+    }
+}
+
+// Decompressed size recorded in the frame header, or 0 if unknown
+#[no_mangle]
+pub extern "C" fn zstd_decompressed_size(data: *const u8, size: size_t) -> size_t {
+    let input = unsafe { slice::from_raw_parts(data, size) };
+    match zstd::zstd_safe::get_frame_content_size(input) {
+        Ok(Some(content_size)) => content_size as size_t,
+        _ => 0,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn zstd_decompress_into(
+    data: *const u8,
+    size: size_t,
+    out: *mut u8,
+    out_capacity: size_t,
+    out_size: *mut size_t,
+) -> c_int {
+    let input = unsafe { slice::from_raw_parts(data, size) };
+    let out = unsafe { slice::from_raw_parts_mut(out, out_capacity) };
+    match zstd::bulk::decompress_to_buffer(input, out) {
+        Ok(written) => {
+            unsafe {
+                *out_size = written;
+            }
+            0
+        }
+        Err(_) => 1,
     }
-    
-    // Convert to raw pointer and forget to prevent deallocation
-    let ptr = compressed.as_ptr() as *mut u8;
-    std::mem::forget(compressed);
-    ptr
 }
 
 #[no_mangle]
@@ -93,11 +269,10 @@ pub extern "C" fn free_time_points(points: *mut TimePoint, len: size_t) {
     }
 }
 
-// SIMD-accelerated operations for time series
-#[cfg(target_arch = "x86_64")]
+// Rolling-window kernels over one value column. Each output depends on the
+// previous one, so these are O(n) sequential recurrences rather than
+// vectorized loops; the names are kept for ABI compatibility.
 pub mod simd {
-    use std::arch::x86_64::*;
-    
     #[no_mangle]
     pub extern "C" fn compute_moving_average_simd(
         values: *const f64,
@@ -112,17 +287,12 @@ pub mod simd {
         let values = unsafe { std::slice::from_raw_parts(values, len) };
         let out = unsafe { std::slice::from_raw_parts_mut(out, len) };
         
-        // Compute first window sum
+        // Sliding sum: add the new value, drop the one leaving the window
         let mut sum = values[..window].iter().sum::<f64>();
-        out[window-1] = sum / window as f64;
-        
-        // Use SIMD for the rest
-        unsafe {
-            for i in window..len {
-                sum += values[i];
-                sum -= values[i - window];
-                out[i] = sum / window as f64;
-            }
+        out[window - 1] = sum / window as f64;
+        for i in window..len {
+            sum += values[i] - values[i - window];
+            out[i] = sum / window as f64;
         }
         
         0
@@ -142,33 +312,10 @@ pub mod simd {
         let values = unsafe { std::slice::from_raw_parts(values, len) };
         let out = unsafe { std::slice::from_raw_parts_mut(out, len) };
 
-        // First value is just copied
+        // EMA = alpha * current + (1 - alpha) * previous EMA
         out[0] = values[0];
-
-        unsafe {
-            let alpha_v = _mm256_set1_pd(alpha);
-            let one_minus_alpha_v = _mm256_set1_pd(1.0 - alpha);
-
-            // Process 4 values at a time using AVX
-            for i in (1..len).step_by(4) {
-                if i + 4 <= len {
-                    let prev_ema = _mm256_loadu_pd(&out[i - 1]);
-                    let curr_values = _mm256_loadu_pd(&values[i]);
-                    
-                    // EMA = α * current + (1 - α) * prevEMA
-                    let ema = _mm256_add_pd(
-                        _mm256_mul_pd(alpha_v, curr_values),
-                        _mm256_mul_pd(one_minus_alpha_v, prev_ema)
-                    );
-                    
-                    _mm256_storeu_pd(&mut out[i], ema);
-                } else {
-                    // Handle remaining values
-                    for j in i..len {
-                        out[j] = alpha * values[j] + (1.0 - alpha) * out[j - 1];
-                    }
-                }
-            }
+        for i in 1..len {
+            out[i] = alpha * values[i] + (1.0 - alpha) * out[i - 1];
         }
 
         0
@@ -188,55 +335,26 @@ pub mod simd {
         let values = unsafe { std::slice::from_raw_parts(values, len) };
         let out = unsafe { std::slice::from_raw_parts_mut(out, len) };
 
-        unsafe {
-            for i in (window-1)..len {
-                let start = i + 1 - window;
-                let window_slice = &values[start..=i];
-
-                // Compute mean using SIMD
-                let mut sum = 0.0;
-                let mut j = 0;
-                while j + 4 <= window {
-                    let v = _mm256_loadu_pd(&window_slice[j]);
-                    sum += _mm256_reduce_add_pd(v);
-                    j += 4;
-                }
-                for k in j..window {
-                    sum += window_slice[k];
-                }
-                let mean = sum / window as f64;
-
-                // Compute variance using SIMD
-                let mean_v = _mm256_set1_pd(mean);
-                let mut var_sum = 0.0;
-                j = 0;
-                while j + 4 <= window {
-                    let v = _mm256_loadu_pd(&window_slice[j]);
-                    let diff = _mm256_sub_pd(v, mean_v);
-                    let sq = _mm256_mul_pd(diff, diff);
-                    var_sum += _mm256_reduce_add_pd(sq);
-                    j += 4;
-                }
-                for k in j..window {
-                    let diff = window_slice[k] - mean;
-                    var_sum += diff * diff;
-                }
-
-                out[i] = (var_sum / window as f64).sqrt();
-            }
+        // Welford over the first window, then a sliding update per point
+        let n = window as f64;
+        let mut mean = 0.0;
+        let mut m2 = 0.0;
+        for (k, &x) in values[..window].iter().enumerate() {
+            let delta = x - mean;
+            mean += delta / (k + 1) as f64;
+            m2 += delta * (x - mean);
         }
+        out[window - 1] = (m2 / n).max(0.0).sqrt();
 
-        0
-    }
+        for i in window..len {
+            let (x_new, x_old) = (values[i], values[i - window]);
+            let old_mean = mean;
+            mean += (x_new - x_old) / n;
+            m2 += (x_new - x_old) * (x_new - mean + x_old - old_mean);
+            out[i] = (m2 / n).max(0.0).sqrt();
+        }
 
-    // Helper function to sum 4 doubles in a vector
-    #[inline]
-    unsafe fn _mm256_reduce_add_pd(v: __m256d) -> f64 {
-        let sum = _mm256_hadd_pd(v, v);
-        let lo = _mm256_castpd256_pd128(sum);
-        let hi = _mm256_extractf128_pd(sum, 1);
-        let sum = _mm_add_pd(lo, hi);
-        _mm_cvtsd_f64(sum)
+        0
     }
 }
 
@@ -0,0 +1,145 @@
+#include "findata_engine/analytics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace findata_engine {
+namespace analytics {
+
+namespace {
+
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+} // namespace
+
+RollingAnalyzer::RollingAnalyzer(const RollingSpec& spec, bool with_volume)
+    : with_volume_(with_volume) {
+    size_t max_window = 0;
+    for (size_t window : spec.windows) {
+        if (window == 0) {
+            throw std::runtime_error("Rolling window must be at least one point");
+        }
+        max_window = std::max(max_window, window);
+        result_.windows.push_back(RollingWindow{.window = window, .mean = {}, .stddev = {}, .zscore = {}, .vwap = {}});
+    }
+    for (double alpha : spec.ema_alphas) {
+        if (!(alpha > 0.0 && alpha <= 1.0)) {
+            throw std::runtime_error("EMA alpha must be in (0, 1]");
+        }
+    }
+    
+    history_.resize(max_window);
+    if (with_volume_) {
+        volume_history_.resize(max_window);
+    }
+    states_.resize(spec.windows.size());
+    ema_state_.resize(spec.ema_alphas.size());
+    result_.emas.resize(spec.ema_alphas.size());
+    ema_alphas_ = spec.ema_alphas;
+}
+
+void RollingAnalyzer::push(std::span<const int64_t> timestamps,
+                           std::span<const double> values,
+                           std::span<const double> volumes) {
+    if (timestamps.size() != values.size() || (with_volume_ && volumes.size() != values.size())) {
+        throw std::runtime_error("Rolling analytics columns differ in length");
+    }
+    
+    const size_t n = values.size();
+    result_.timestamps.insert(result_.timestamps.end(), timestamps.begin(), timestamps.end());
+    
+    // Window-major so each window's state stays in registers across the chunk
+    for (size_t w = 0; w < states_.size(); ++w) {
+        auto& out = result_.windows[w];
+        auto state = states_[w];
+        const size_t window = out.window;
+        const double inv_window = 1.0 / static_cast<double>(window);
+        out.mean.reserve(out.mean.size() + n);
+        out.stddev.reserve(out.stddev.size() + n);
+        out.zscore.reserve(out.zscore.size() + n);
+        if (with_volume_) {
+            out.vwap.reserve(out.vwap.size() + n);
+        }
+        
+        for (size_t i = 0; i < n; ++i) {
+            const size_t index = count_ + i;
+            const double x = values[i];
+            const double v = with_volume_ ? volumes[i] : 0.0;
+            
+            if (index < window) {
+                // Still filling: plain Welford accumulation
+                const double delta = x - state.mean;
+                state.mean += delta / static_cast<double>(index + 1);
+                state.m2 += delta * (x - state.mean);
+            } else {
+                // Slide: the point leaving is either in this chunk or the ring
+                const size_t old_index = index - window;
+                const double x_old = old_index >= count_ ? values[old_index - count_]
+                                                         : history_[old_index % history_.size()];
+                const double old_mean = state.mean;
+                state.mean += (x - x_old) * inv_window;
+                state.m2 += (x - x_old) * (x - state.mean + x_old - old_mean);
+                if (with_volume_) {
+                    const double v_old = old_index >= count_ ? volumes[old_index - count_]
+                                                             : volume_history_[old_index % volume_history_.size()];
+                    state.price_volume -= x_old * v_old;
+                    state.volume -= v_old;
+                }
+            }
+            if (with_volume_) {
+                state.price_volume += x * v;
+                state.volume += v;
+            }
+            
+            if (index + 1 < window) {
+                out.mean.push_back(NaN);
+                out.stddev.push_back(NaN);
+                out.zscore.push_back(NaN);
+                if (with_volume_) {
+                    out.vwap.push_back(NaN);
+                }
+                continue;
+            }
+            const double stddev = std::sqrt(std::max(state.m2 * inv_window, 0.0));
+            out.mean.push_back(state.mean);
+            out.stddev.push_back(stddev);
+            out.zscore.push_back(stddev > 0.0 ? (x - state.mean) / stddev : NaN);
+            if (with_volume_) {
+                out.vwap.push_back(state.volume != 0.0 ? state.price_volume / state.volume : NaN);
+            }
+        }
+        states_[w] = state;
+    }
+    
+    for (size_t e = 0; e < ema_state_.size(); ++e) {
+        auto& out = result_.emas[e];
+        const double alpha = ema_alphas_[e];
+        double ema = ema_state_[e];
+        out.reserve(out.size() + n);
+        for (size_t i = 0; i < n; ++i) {
+            ema = count_ + i == 0 ? values[i] : alpha * values[i] + (1.0 - alpha) * ema;
+            out.push_back(ema);
+        }
+        ema_state_[e] = ema;
+    }
+    
+    // Keep the trailing points later chunks may still need
+    if (!history_.empty()) {
+        const size_t keep = std::min(n, history_.size());
+        for (size_t i = n - keep; i < n; ++i) {
+            history_[(count_ + i) % history_.size()] = values[i];
+            if (with_volume_) {
+                volume_history_[(count_ + i) % volume_history_.size()] = volumes[i];
+            }
+        }
+    }
+    count_ += n;
+}
+
+RollingResult RollingAnalyzer::take_result() {
+    return std::move(result_);
+}
+
+} // namespace analytics
+} // namespace findata_engine
@@ -0,0 +1,412 @@
+#include "findata_engine/async_io.hpp"
+#include "findata_engine/utils.hpp"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace findata_engine {
+
+namespace {
+
+// Reads until size bytes arrive or end of file; returns bytes read or -errno
+ssize_t pread_full(int fd, uint8_t* dest, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, dest + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    while (true) {
+        long r = syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+        if (r >= 0) return static_cast<int>(r);
+        if (errno != EINTR) return -errno;
+    }
+}
+
+// IORING_OP_READ arrived in 5.6, after io_uring itself; so did the probe,
+// so a kernel that can't answer doesn't have the opcode either
+bool supports_read(int ring_fd) {
+    constexpr unsigned max_ops = 256;
+    std::vector<uint8_t> buffer(sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, max_ops) < 0) {
+        return false;
+    }
+    return probe->last_op >= IORING_OP_READ && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+}
+
+} // namespace
+
+struct AsyncReader::Completion {
+    int fd;
+    uint64_t offset;
+    std::span<uint8_t> dest;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    ssize_t result = 0; // Bytes read, or -errno
+
+    Completion(int file, uint64_t off, std::span<uint8_t> buffer) : fd(file), offset(off), dest(buffer) {}
+
+    void finish(ssize_t bytes) {
+        {
+            std::lock_guard lock(mutex);
+            result = bytes;
+            done = true;
+        }
+        cv.notify_all();
+    }
+};
+
+// Submission and completion rings shared by all callers. Submitters
+// serialize on a mutex; one reaper thread waits for completions and wakes
+// whoever is waiting on them. A semaphore keeps reads in flight within the
+// completion ring, so it can never overflow. If the ring stops reporting
+// completions, every read still waiting on it fails with that error and
+// later reads fail straight away.
+class AsyncReader::Ring {
+public:
+    explicit Ring(unsigned entries) : slots_(entries) {
+        io_uring_params params{};
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+        }
+        if (!supports_read(fd_)) {
+            close(fd_);
+            throw std::runtime_error("io_uring does not support IORING_OP_READ on this kernel");
+        }
+        try {
+            map_rings(params);
+        } catch (...) {
+            unmap_rings();
+            close(fd_);
+            throw;
+        }
+        reaper_ = std::thread([this] { reap_loop(); });
+    }
+
+    ~Ring() {
+        // A no-op tagged 0 tells the reaper to exit once the ring drains.
+        // A failed ring has already stopped its reaper.
+        while (submit(IORING_OP_NOP, -1, 0, nullptr, 0, 0) < 0 && !failed()) {
+            std::this_thread::yield();
+        }
+        reaper_.join();
+        unmap_rings();
+        close(fd_);
+    }
+
+    // A read the ring can't take completes with the error instead
+    void read(const std::shared_ptr<AsyncReader::Completion>& completion) {
+        const uint64_t tag = track(completion);
+        const int r = submit(IORING_OP_READ, completion->fd, completion->offset, completion->dest.data(),
+                             static_cast<uint32_t>(completion->dest.size()), tag);
+        if (r < 0) {
+            if (auto failed_read = untrack(tag)) failed_read->finish(r);
+        }
+    }
+
+private:
+    void map_rings(const io_uring_params& params) {
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        }
+
+        sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) {
+            sq_ptr_ = nullptr;
+            throw std::runtime_error("Failed to map io_uring submission ring");
+        }
+        if (single_mmap) {
+            cq_ptr_ = sq_ptr_;
+        } else {
+            cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED) {
+                cq_ptr_ = nullptr;
+                throw std::runtime_error("Failed to map io_uring completion ring");
+            }
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            throw std::runtime_error("Failed to map io_uring submission entries");
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<uint8_t*>(sq_ptr_);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* cq = static_cast<uint8_t*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    void unmap_rings() {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_) munmap(sq_ptr_, sq_size_);
+    }
+
+    bool failed() const {
+        return ring_error_.load(std::memory_order_acquire) != 0;
+    }
+
+    // The ring holds a reference to each read until it is reaped; the tag
+    // is its user_data, 0 being the shutdown no-op
+    uint64_t track(const std::shared_ptr<AsyncReader::Completion>& completion) {
+        std::lock_guard lock(reads_mutex_);
+        if (free_reads_.empty()) {
+            reads_.push_back(completion);
+            return reads_.size();
+        }
+        const size_t index = free_reads_.back();
+        free_reads_.pop_back();
+        reads_[index] = completion;
+        return index + 1;
+    }
+
+    // Null if the read was already failed along with the ring
+    std::shared_ptr<AsyncReader::Completion> untrack(uint64_t tag) {
+        std::lock_guard lock(reads_mutex_);
+        auto completion = std::move(reads_[tag - 1]);
+        if (completion) free_reads_.push_back(tag - 1);
+        return completion;
+    }
+
+    // Returns 0, or -errno with the entry withdrawn if the kernel didn't
+    // take it
+    int submit(uint8_t opcode, int fd, uint64_t offset, void* addr, uint32_t len, uint64_t user_data) {
+        slots_.acquire();
+        std::lock_guard lock(submit_mutex_);
+        if (const int error = ring_error_.load(std::memory_order_acquire)) {
+            slots_.release();
+            return -error;
+        }
+        const unsigned tail = *sq_tail_;
+        const unsigned index = tail & sq_mask_;
+        io_uring_sqe& sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.off = offset;
+        sqe.addr = reinterpret_cast<uint64_t>(addr);
+        sqe.len = len;
+        sqe.user_data = user_data;
+        sq_array_[index] = index;
+        in_flight_.fetch_add(1, std::memory_order_relaxed);
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+        // Without SQPOLL the kernel consumes the entry during this call
+        int r;
+        while ((r = io_uring_enter(fd_, 1, 0, 0)) == -EAGAIN || r == -EBUSY) {
+            std::this_thread::yield();
+        }
+        if (r < 0) {
+            // Without SQPOLL nothing else reads the tail, so the entry can
+            // simply be taken back
+            __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+            in_flight_.fetch_sub(1, std::memory_order_relaxed);
+            slots_.release();
+            return r;
+        }
+        return 0;
+    }
+
+    // Fails every tracked read with the ring's error and frees the slots of
+    // everything in flight, so no submitter or waiter is left blocked
+    void fail_outstanding(int error) {
+        {
+            std::lock_guard lock(submit_mutex_);
+            ring_error_.store(-error, std::memory_order_release);
+        }
+        std::vector<std::shared_ptr<AsyncReader::Completion>> failed_reads;
+        {
+            std::lock_guard lock(reads_mutex_);
+            for (auto& completion : reads_) {
+                if (completion) failed_reads.push_back(std::move(completion));
+            }
+        }
+        for (const auto& completion : failed_reads) {
+            completion->finish(error);
+        }
+        slots_.release(static_cast<std::ptrdiff_t>(in_flight_.exchange(0, std::memory_order_acq_rel)));
+    }
+
+    void reap_loop() {
+        bool stopping = false;
+        while (true) {
+            unsigned head = *cq_head_;
+            const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                if (cqe.user_data == 0) {
+                    stopping = true;
+                } else if (auto completion = untrack(cqe.user_data)) {
+                    completion->finish(cqe.res);
+                }
+                in_flight_.fetch_sub(1, std::memory_order_release);
+                slots_.release();
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+            // Reads submitted before the no-op can complete after it, so
+            // exit only once nothing is in flight
+            if (stopping && in_flight_.load(std::memory_order_acquire) == 0) break;
+            int r = io_uring_enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+            if (r < 0 && r != -EAGAIN && r != -EBUSY) {
+                fail_outstanding(r);
+                break;
+            }
+        }
+    }
+
+    int fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    std::mutex submit_mutex_;
+    std::counting_semaphore<> slots_;
+    std::atomic<size_t> in_flight_{0};
+    std::atomic<int> ring_error_{0}; // errno once the reaper has given up
+
+    std::mutex reads_mutex_;
+    std::vector<std::shared_ptr<AsyncReader::Completion>> reads_; // Indexed by tag - 1
+    std::vector<size_t> free_reads_;
+    std::thread reaper_;
+};
+
+struct AsyncReader::Impl {
+    std::unique_ptr<Ring> ring;
+    std::optional<utils::ThreadPool> pool; // Fallback when there is no ring
+
+    Impl(Backend backend, unsigned queue_depth, size_t threads) {
+        if (backend != Backend::Threads) {
+            try {
+                ring = std::make_unique<Ring>(std::max(queue_depth, 1u));
+            } catch (const std::exception&) {
+                if (backend == Backend::IoUring) throw;
+            }
+        }
+        if (!ring) {
+            pool.emplace(std::max<size_t>(threads, 1));
+        }
+    }
+};
+
+AsyncReader::Pending::Pending(std::shared_ptr<Completion> completion) : completion_(std::move(completion)) {}
+AsyncReader::Pending::Pending(Pending&& other) noexcept
+    : completion_(std::move(other.completion_)), waited_(other.waited_) {}
+
+AsyncReader::Pending& AsyncReader::Pending::operator=(Pending&& other) noexcept {
+    if (this != &other) {
+        settle();
+        completion_ = std::move(other.completion_);
+        waited_ = other.waited_;
+    }
+    return *this;
+}
+
+AsyncReader::Pending::~Pending() {
+    settle();
+}
+
+void AsyncReader::Pending::settle() noexcept {
+    if (completion_ && !waited_) {
+        std::unique_lock lock(completion_->mutex);
+        completion_->cv.wait(lock, [&] { return completion_->done; });
+    }
+}
+
+void AsyncReader::Pending::wait() {
+    if (!completion_ || waited_) return;
+    auto& c = *completion_;
+    {
+        std::unique_lock lock(c.mutex);
+        c.cv.wait(lock, [&] { return c.done; });
+    }
+    waited_ = true;
+
+    if (c.result < 0) {
+        throw std::runtime_error(std::string("Async read failed: ") + std::strerror(static_cast<int>(-c.result)));
+    }
+    // A short read is finished synchronously; coming up short again means
+    // the file ends before the requested range
+    auto done = static_cast<size_t>(c.result);
+    if (done < c.dest.size()) {
+        ssize_t rest = pread_full(c.fd, c.dest.data() + done, c.dest.size() - done, c.offset + done);
+        if (rest < 0) {
+            throw std::runtime_error(std::string("Async read failed: ") + std::strerror(static_cast<int>(-rest)));
+        }
+        if (done + static_cast<size_t>(rest) < c.dest.size()) {
+            throw std::runtime_error("Async read past end of file");
+        }
+    }
+}
+
+AsyncReader::AsyncReader(Backend backend, unsigned queue_depth, size_t threads)
+    : pimpl_(std::make_unique<Impl>(backend, queue_depth, threads)) {}
+
+AsyncReader::~AsyncReader() = default;
+
+AsyncReader::Pending AsyncReader::read(int fd, uint64_t offset, std::span<uint8_t> dest) const {
+    auto completion = std::make_shared<Completion>(fd, offset, dest);
+    if (dest.empty()) {
+        completion->finish(0);
+    } else if (pimpl_->ring) {
+        pimpl_->ring->read(completion);
+    } else {
+        pimpl_->pool->submit([completion] {
+            completion->finish(pread_full(completion->fd, completion->dest.data(),
+                                          completion->dest.size(), completion->offset));
+        });
+    }
+    return Pending(completion);
+}
+
+bool AsyncReader::uses_io_uring() const {
+    return pimpl_->ring != nullptr;
+}
+
+} // namespace findata_engine
@@ -1,348 +1,1940 @@
 #include "findata_engine/disk_layer.hpp"
+#include "findata_engine/async_io.hpp"
+#include "findata_engine/metrics.hpp"
 #include "findata_engine/rust_bindings.hpp"
+#include "findata_engine/utils.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <filesystem>
 #include <fstream>
 #include <algorithm>
 #include <unordered_map>
 #include <shared_mutex>
+#include <mutex>
 #include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <limits>
+#include <optional>
+#include <span>
+#include <array>
+#include <functional>
+#include <queue>
+#include <deque>
+#include <map>
+#include <unordered_set>
+#include <condition_variable>
+#include <thread>
+#include <cerrno>
+#include <utility>
 
 namespace findata_engine {
 
 namespace {
-constexpr size_t SEGMENT_SIZE = 64 * 1024 * 1024; // 64MB segments
-constexpr size_t INDEX_BLOCK_SIZE = 4096; // 4KB index blocks
+
+// Segment file layout:
+//   [FileHeader][block 0]...[block N-1][BlockIndexEntry x N][FileTrailer]
+// Each block holds up to points_per_block points, encoded independently so a
+// range read only has to fetch and decode the blocks that overlap it.
+constexpr uint32_t SEGMENT_MAGIC = 0x47534446; // "FDSG"
+constexpr uint32_t SEGMENT_VERSION = 3;         // v3 adds block statistics
+constexpr uint32_t SEGMENT_VERSION_NO_STATS = 2;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_points;
+    int64_t start_ticks;
+    int64_t end_ticks;
+    uint32_t codec; // BlockCodec
+    uint32_t num_blocks;
+};
+
+// Set when no timestamp repeats within the block or across its edges, so
+// its statistics describe exactly the points a reader would see
+constexpr uint64_t BLOCK_DISTINCT = 1;
+
+// Largest Gorilla block a point count can produce: the timestamp-stream
+// length prefix, both streams' count headers and first values, then at most
+// 69 bits per timestamp and 77 bits per value
+constexpr size_t GORILLA_BLOCK_OVERHEAD = sizeof(uint32_t) + 4 * sizeof(uint64_t);
+constexpr size_t MAX_GORILLA_BYTES_PER_POINT = (69 + 77 + 7) / 8;
+
+struct BlockIndexEntry {
+    int64_t min_ticks;
+    int64_t max_ticks;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t num_points;
+    double min_value;
+    double max_value;
+    double sum;
+    uint64_t flags;
+};
+
+// Version 2 index entry, without statistics
+struct BlockIndexEntryNoStats {
+    int64_t min_ticks;
+    int64_t max_ticks;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t num_points;
+};
+
+// Parses `count` index entries of the given segment version
+bool decode_block_index(uint32_t version, const uint8_t* data, size_t size,
+                        size_t count, std::vector<BlockIndexEntry>& blocks) {
+    if (version == SEGMENT_VERSION) {
+        if (size != count * sizeof(BlockIndexEntry)) return false;
+        blocks.resize(count);
+        std::memcpy(blocks.data(), data, size);
+        return true;
+    }
+    if (version != SEGMENT_VERSION_NO_STATS || size != count * sizeof(BlockIndexEntryNoStats)) {
+        return false;
+    }
+    blocks.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        BlockIndexEntryNoStats legacy;
+        std::memcpy(&legacy, data + i * sizeof(legacy), sizeof(legacy));
+        blocks[i] = BlockIndexEntry{
+            .min_ticks = legacy.min_ticks,
+            .max_ticks = legacy.max_ticks,
+            .offset = legacy.offset,
+            .size = legacy.size,
+            .num_points = legacy.num_points,
+            .min_value = 0.0,
+            .max_value = 0.0,
+            .sum = 0.0,
+            .flags = 0
+        };
+    }
+    return true;
+}
+
+size_t block_index_entry_size(uint32_t version) {
+    return version == SEGMENT_VERSION ? sizeof(BlockIndexEntry) : sizeof(BlockIndexEntryNoStats);
+}
+
+// Keeps uncompressed block columns 8-byte aligned within the file
+static_assert(sizeof(FileHeader) % alignof(int64_t) == 0);
+
+struct FileTrailer {
+    uint64_t index_offset;
+    uint32_t num_blocks;
+    uint32_t magic;
+};
+
+int64_t to_ticks(std::chrono::system_clock::time_point tp) {
+    return tp.time_since_epoch().count();
+}
+
+std::chrono::system_clock::time_point from_ticks(int64_t ticks) {
+    return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(ticks));
+}
+
+// Manifest layout: sequence of [uint32 payload_size][uint32 crc32(payload)][payload]
+// Payload: [uint8 type][uint16 symbol_len][symbol][uint64 segment_id]
+//          followed, for adds, by [FileHeader][BlockIndexEntry x num_blocks]
+constexpr const char* MANIFEST_FILE = "MANIFEST";
+constexpr const char* SYMBOL_CATALOG_FILE = "SYMBOLS";
+// Left by a clean close and consumed on open; without it the last run may
+// have crashed mid-write, so segment files the manifest lacks are swept
+constexpr const char* CLEAN_SHUTDOWN_FILE = "CLEAN";
+constexpr size_t MANIFEST_RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr size_t MANIFEST_CHECKPOINT_SLACK = 1024;
+constexpr uint8_t MANIFEST_ADD = 1;
+constexpr uint8_t MANIFEST_REMOVE = 2;
+
+template<typename T>
+void put(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool get(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) return false;
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+void frame_record(std::vector<uint8_t>& out, const std::vector<uint8_t>& payload) {
+    put<uint32_t>(out, static_cast<uint32_t>(payload.size()));
+    put<uint32_t>(out, utils::crc32(payload.data(), payload.size()));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// Owns a file descriptor; -1 when empty
+class FileDescriptor {
+public:
+    FileDescriptor() = default;
+    explicit FileDescriptor(int fd) : fd_(fd) {}
+    FileDescriptor(FileDescriptor&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+    FileDescriptor& operator=(FileDescriptor&& other) noexcept {
+        if (this != &other) {
+            if (fd_ != -1) close(fd_);
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+    ~FileDescriptor() {
+        if (fd_ != -1) close(fd_);
+    }
+    
+    int get() const { return fd_; }
+    
+private:
+    int fd_ = -1;
+};
+
+bool read_at(int fd, uint64_t offset, std::span<uint8_t> dest) {
+    size_t done = 0;
+    while (done < dest.size()) {
+        ssize_t n = ::pread(fd, dest.data() + done, dest.size() - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Asks the kernel to start reading [first, last) of a mapping in the
+// background; only a hint, so failures are ignored
+void advise_will_need(std::span<const uint8_t> mapped, uint64_t first, uint64_t last) {
+    static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    last = std::min<uint64_t>(last, mapped.size());
+    if (first >= last) return;
+    first &= ~(page_size - 1);
+    madvise(const_cast<uint8_t*>(mapped.data()) + first, last - first, MADV_WILLNEED);
+}
+
+bool write_all(int fd, const std::vector<uint8_t>& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Flushes a file, or a directory's entries, to stable storage
+bool sync_path(const std::filesystem::path& path, bool directory = false) {
+    int fd = open(path.c_str(), O_RDONLY | (directory ? O_DIRECTORY : 0));
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// Decoded columns of one compressed block
+struct DecodedBlock {
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+};
+
+// Buffers reused across the blocks of one segment write
+struct EncodeScratch {
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    std::vector<uint8_t> staging;
+    std::vector<uint8_t> out;
+};
+
+// Idle buffers kept for reuse. Decoded blocks are recycled as the block
+// cache evicts them, so enough are kept to cover a burst of evictions;
+// encode scratch is held by at most one writer per flush or compaction.
+constexpr size_t MAX_IDLE_DECODED_BLOCKS = 64;
+constexpr size_t MAX_IDLE_ENCODE_SCRATCH = 8;
+
+struct BlockKey {
+    std::string symbol;
+    size_t segment_id;
+    size_t block;
+    
+    bool operator==(const BlockKey& other) const = default;
+};
+
+struct BlockKeyHash {
+    size_t operator()(const BlockKey& key) const {
+        size_t h = std::hash<std::string>{}(key.symbol);
+        h ^= std::hash<size_t>{}(key.segment_id) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        h ^= std::hash<size_t>{}(key.block) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+// Byte-budgeted LRU of decoded blocks, sharded to keep readers of different
+// blocks off each other's locks. Segment ids are never reused, so entries
+// of compacted segments simply age out.
+class BlockCache {
+public:
+    explicit BlockCache(size_t budget_bytes) {
+        for (auto& shard : shards_) {
+            shard = std::make_unique<Shard>(budget_bytes / NUM_SHARDS);
+        }
+    }
+    
+    std::shared_ptr<const DecodedBlock> get(const BlockKey& key) {
+        auto& shard = shard_for(key);
+        std::optional<std::shared_ptr<const DecodedBlock>> block;
+        {
+            std::lock_guard lock(shard.mutex);
+            block = shard.lru.get(key);
+        }
+        if (block) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return *block;
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    
+    void put(const BlockKey& key, std::shared_ptr<const DecodedBlock> block) {
+        const size_t charge = sizeof(DecodedBlock) + key.symbol.size() +
+            block->timestamps.size() * sizeof(int64_t) + block->values.size() * sizeof(double);
+        auto& shard = shard_for(key);
+        std::lock_guard lock(shard.mutex);
+        shard.lru.put(key, std::move(block), charge);
+    }
+    
+    size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    
+private:
+    static constexpr size_t NUM_SHARDS = 16;
+    
+    struct Shard {
+        explicit Shard(size_t budget) : lru(budget) {}
+        std::mutex mutex;
+        utils::LRUCache<BlockKey, std::shared_ptr<const DecodedBlock>, BlockKeyHash> lru;
+    };
+    
+    Shard& shard_for(const BlockKey& key) {
+        return *shards_[BlockKeyHash{}(key) % NUM_SHARDS];
+    }
+    
+    std::array<std::unique_ptr<Shard>, NUM_SHARDS> shards_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
+
 } // namespace
 
 struct DiskLayer::Impl {
+    using ColumnVisitor = DiskLayer::ColumnVisitor;
+    
+    // State of a segment file shared by every copy of its SegmentInfo: the
+    // read-only mapping, created on first read, and whether a newer version
+    // dropped the segment. A retired file is deleted with the last copy, so
+    // readers still holding an older version can finish with it.
+    struct SegmentFile {
+        std::once_flag once;
+        std::unique_ptr<utils::MemoryMappedFile> mapping;
+        std::string retired_path; // Written before the retiring version is published
+        
+        ~SegmentFile() {
+            mapping.reset();
+            if (!retired_path.empty()) {
+                std::error_code ec;
+                std::filesystem::remove(retired_path, ec);
+            }
+        }
+    };
+    
     struct SegmentInfo {
         std::chrono::system_clock::time_point start_time;
         std::chrono::system_clock::time_point end_time;
         size_t num_points;
         std::string file_path;
-        bool compressed;
+        BlockCodec codec;
+        std::vector<BlockIndexEntry> blocks;
+        std::shared_ptr<SegmentFile> file = std::make_shared<SegmentFile>();
+        RangeStats stats{};           // Totals over blocks
+        bool stats_complete = false;  // Every block is BLOCK_DISTINCT
+        
+        void retire() const {
+            file->retired_path = file_path;
+        }
+        
+        void summarize() {
+            stats = RangeStats{};
+            stats_complete = true;
+            for (const auto& block : blocks) {
+                stats.merge(block_stats(block));
+                stats_complete = stats_complete && (block.flags & BLOCK_DISTINCT);
+            }
+        }
     };
     
-    struct SegmentHeader {
-        size_t num_points;
-        std::chrono::system_clock::time_point start_time;
-        std::chrono::system_clock::time_point end_time;
+    static RangeStats block_stats(const BlockIndexEntry& block) {
+        return RangeStats{
+            .count = block.num_points,
+            .sum = block.sum,
+            .min = block.min_value,
+            .max = block.max_value
+        };
+    }
+    
+    // One symbol's segments, by id for bookkeeping and by time for reads.
+    // The time index is sorted by start and carries the running maximum end,
+    // so the segments overlapping a range lie in a slice found by two binary
+    // searches: O(log n + k) for the usual mostly-disjoint layout. Updates
+    // rebuild the slice after the change, which only flushes and compactions do.
+    // Published indexes are immutable versions (see SymbolState), so entries
+    // are shared between a version and its successor.
+    class SegmentIndex {
+    public:
+        using SharedInfo = std::shared_ptr<const SegmentInfo>;
+        using const_iterator = std::map<size_t, SharedInfo>::const_iterator;
+        
+        bool empty() const { return by_id_.empty(); }
+        size_t size() const { return by_id_.size(); }
+        bool contains(size_t id) const { return by_id_.contains(id); }
+        const SegmentInfo& at(size_t id) const { return *by_id_.at(id); }
+        const SharedInfo& share(size_t id) const { return by_id_.at(id); }
+        
+        // Oldest first
+        const_iterator begin() const { return by_id_.begin(); }
+        const_iterator end() const { return by_id_.end(); }
+        
+        void insert(size_t id, SegmentInfo info) {
+            insert(id, std::make_shared<const SegmentInfo>(std::move(info)));
+        }
+        
+        void insert(size_t id, SharedInfo info) {
+            erase(id);
+            const Span span{to_ticks(info->start_time), to_ticks(info->end_time), id};
+            by_id_.emplace(id, std::move(info));
+            auto pos = std::upper_bound(by_start_.begin(), by_start_.end(), span, start_order);
+            const size_t index = static_cast<size_t>(pos - by_start_.begin());
+            by_start_.insert(pos, span);
+            max_end_.insert(max_end_.begin() + index, 0);
+            refresh_max_end(index);
+        }
+        
+        void erase(size_t id) {
+            auto it = by_id_.find(id);
+            if (it == by_id_.end()) return;
+            const Span span{to_ticks(it->second->start_time), to_ticks(it->second->end_time), id};
+            auto pos = std::lower_bound(by_start_.begin(), by_start_.end(), span, start_order);
+            const size_t index = static_cast<size_t>(pos - by_start_.begin());
+            by_start_.erase(pos);
+            max_end_.erase(max_end_.begin() + index);
+            refresh_max_end(index);
+            by_id_.erase(it);
+        }
+        
+        // Ids of the segments overlapping [lo, hi] in ticks, oldest first
+        std::vector<size_t> overlapping(int64_t lo, int64_t hi) const {
+            // Entries past `last` start after hi; none before `first` reaches lo
+            auto last = std::upper_bound(by_start_.begin(), by_start_.end(), hi,
+                [](int64_t ts, const Span& span) { return ts < span.start; });
+            auto first_end = std::lower_bound(max_end_.begin(), max_end_.end(), lo);
+            std::vector<size_t> ids;
+            for (auto it = by_start_.begin() + (first_end - max_end_.begin()); it < last; ++it) {
+                if (it->end >= lo) {
+                    ids.push_back(it->id);
+                }
+            }
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        }
+        
+        // Latest end time over all segments; only meaningful when not empty
+        int64_t max_end() const { return max_end_.back(); }
+        
+    private:
+        struct Span {
+            int64_t start;
+            int64_t end;
+            size_t id;
+        };
+        
+        static bool start_order(const Span& a, const Span& b) {
+            return a.start < b.start || (a.start == b.start && a.id < b.id);
+        }
+        
+        void refresh_max_end(size_t from) {
+            int64_t running = from > 0 ? max_end_[from - 1] : std::numeric_limits<int64_t>::min();
+            for (size_t i = from; i < by_start_.size(); ++i) {
+                running = std::max(running, by_start_[i].end);
+                max_end_[i] = running;
+            }
+        }
+        
+        std::map<size_t, SharedInfo> by_id_;
+        std::vector<Span> by_start_;
+        std::vector<int64_t> max_end_; // max_end_[i] = max end over by_start_[0..i]
+    };
+    
+    using SegmentVersion = std::shared_ptr<const SegmentIndex>;
+    
+    // Everything the layer tracks about one symbol
+    struct SymbolState {
+        // Current segments. Flushes and compactions publish a successor under
+        // the unique lock; readers pin whichever version is current without
+        // taking any lock, and keep its files alive until they let it go.
+        std::atomic<SegmentVersion> version{std::make_shared<const SegmentIndex>()};
+        
+        SegmentVersion pin() const { return version.load(std::memory_order_acquire); }
+        
+        // Caller holds the unique lock, so the version can't be replaced
+        const SegmentIndex& segments() const { return *version.load(std::memory_order_relaxed); }
+        
+        // Everything below is guarded by the unique lock
+        // Segment ids order writes: a higher id is newer. Ids are handed out
+        // under the unique lock and never reused within a process.
+        size_t next_segment_id = 0;
+        // Flushes that hold an id but are not installed yet, with their range
+        std::map<size_t, std::pair<int64_t, int64_t>> pending;
+        bool compacting = false; // At most one compaction in flight
     };
     
     std::filesystem::path data_dir;
-    std::unordered_map<std::string, std::unordered_map<size_t, SegmentInfo>> metadata;
+    std::shared_ptr<SymbolCatalog> catalog;
+    // Indexed by SymbolId; entries are created under the unique lock and
+    // looked up without it
+    SymbolTable<SymbolState> symbols;
+    // Serializes flushes, compactions and manifest writes; readers pin
+    // versions instead of taking it
     std::shared_mutex mutex;
     DiskConfig config;
+    BlockCodec write_codec;
+    mutable BlockCache block_cache;
+    // Scratch recycled across decodes and segment writes; buffers released
+    // after the pool is destroyed are simply freed
+    utils::ObjectPool<DecodedBlock> block_pool{MAX_IDLE_DECODED_BLOCKS};
+    utils::ObjectPool<EncodeScratch> scratch_pool{MAX_IDLE_ENCODE_SCRATCH};
+    // Block reads ahead of cursors and scans when segments aren't mapped
+    std::unique_ptr<AsyncReader> io;
+    
+    // See DiskStats
+    mutable metrics::Counter bytes_read;
+    mutable metrics::Counter bytes_written;
+    mutable metrics::Histogram decode_latency;
+    mutable metrics::Histogram compaction_latency;
+    mutable metrics::Histogram lock_wait;
+    
+    // Append-only log of segment add/remove records, checkpointed on open
+    int manifest_fd = -1;
+    size_t manifest_records = 0;
+    size_t live_segments = 0; // Across all symbols' current versions
+    // Segments read back on open, before their first versions are published
+    std::map<std::string, SegmentIndex> loading;
+    
+    std::condition_variable_any segments_changed;
+    
+    // Background compaction workers
+    std::mutex worker_mutex;
+    std::condition_variable worker_cv;
+    bool work_signalled = true; // Look at the loaded segments once on start
+    std::atomic<bool> stopping{false};
+    std::vector<std::thread> workers;
+    
+    Impl(const std::filesystem::path& dir, const DiskConfig& cfg, std::shared_ptr<SymbolCatalog> symbol_catalog)
+        : data_dir(dir),
+          catalog(std::move(symbol_catalog)),
+          config(cfg),
+          write_codec(cfg.enable_compression ? cfg.codec : BlockCodec::None),
+          block_cache(cfg.block_cache_size_mb * 1024 * 1024) {
+        std::filesystem::create_directories(dir);
+        if (!catalog) {
+            catalog = std::make_shared<SymbolCatalog>(dir / SYMBOL_CATALOG_FILE);
+        }
+        if (!config.use_mmap && config.read_ahead_blocks > 0) {
+            io = std::make_unique<AsyncReader>(AsyncReader::Backend::Auto, config.io_queue_depth);
+        }
+        load_existing_segments();
+        
+        if (config.background_compaction) {
+            for (size_t i = 0; i < config.compaction_threads; ++i) {
+                workers.emplace_back([this] { compaction_loop(); });
+            }
+        }
+    }
+    
+    ~Impl() {
+        {
+            std::lock_guard lock(worker_mutex);
+            stopping = true;
+        }
+        worker_cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (manifest_fd != -1) {
+            close(manifest_fd);
+            // Every segment file written is now recorded or removed
+            std::ofstream(data_dir / CLEAN_SHUTDOWN_FILE);
+        }
+    }
+    
+    std::filesystem::path segment_path(const std::string& symbol, size_t segment_id) const {
+        return data_dir / (symbol + "_" + std::to_string(segment_id) + ".seg");
+    }
+    
+    const SymbolState* find_state(SymbolId id) const {
+        return symbols.find(id);
+    }
+    
+    const SymbolState* find_state(const std::string& symbol) const {
+        auto id = catalog->find(symbol);
+        return id ? find_state(*id) : nullptr;
+    }
+    
+    SymbolState* find_state(const std::string& symbol) {
+        return const_cast<SymbolState*>(std::as_const(*this).find_state(symbol));
+    }
+    
+    // Interns the symbol on first sight. Caller holds the unique lock.
+    SymbolState& state_locked(const std::string& symbol) {
+        return symbols.get_or_create(catalog->intern(symbol));
+    }
+    
+    // Pinned segments of a symbol; empty if it has none
+    SegmentVersion pin(SymbolId id) const {
+        const auto* state = find_state(id);
+        return state ? state->pin() : std::make_shared<const SegmentIndex>();
+    }
+    
+    SegmentVersion pin(const std::string& symbol) const {
+        auto id = catalog->find(symbol);
+        return id ? pin(*id) : std::make_shared<const SegmentIndex>();
+    }
+    
+    // Publishes a successor of the symbol's current segments made by
+    // change(index). Caller holds the unique lock.
+    template<typename Fn>
+    void update_segments_locked(SymbolState& state, Fn&& change) {
+        auto next = std::make_shared<SegmentIndex>(state.segments());
+        change(*next);
+        publish_locked(state, std::move(next));
+    }
+    
+    // Installs a version of the symbol's segments, keeping live_segments in
+    // step. Caller holds the unique lock.
+    void publish_locked(SymbolState& state, SegmentVersion next) {
+        live_segments = live_segments - state.segments().size() + next->size();
+        state.version.store(std::move(next), std::memory_order_release);
+    }
+    
+    // Visits the current segments of symbols that have any, in id order.
+    // Under the unique lock these are the versions writers see.
+    template<typename Fn>
+    void for_each_symbol(Fn&& fn) const {
+        const SymbolId count = catalog->size();
+        for (SymbolId id = 0; id < count; ++id) {
+            const auto* state = find_state(id);
+            if (state == nullptr) continue;
+            auto version = state->pin();
+            if (!version->empty()) {
+                fn(catalog->name(id), *state, *version);
+            }
+        }
+    }
+    
+    void load_existing_segments() {
+        auto lock = metrics::lock_unique(mutex, lock_wait);
+        const auto clean_marker = data_dir / CLEAN_SHUTDOWN_FILE;
+        const bool clean = std::filesystem::exists(clean_marker);
+        if (clean) {
+            // Gone for good before anything is written, so a crash in this
+            // run is never mistaken for a clean close
+            std::filesystem::remove(clean_marker);
+            if (!sync_path(data_dir, true)) {
+                throw std::runtime_error("Failed to sync " + data_dir.string());
+            }
+        }
+        if (load_manifest()) {
+            if (!clean) {
+                remove_orphaned_segments();
+            }
+        } else {
+            // No manifest yet: rebuild it from the segment footers once
+            recover_from_directory();
+        }
+        for (auto& [symbol, segments] : loading) {
+            publish_locked(state_locked(symbol), std::make_shared<const SegmentIndex>(segments));
+        }
+        checkpoint_manifest_locked();
+        
+        for (const auto& [symbol, segments] : loading) {
+            auto& state = state_locked(symbol);
+            for (const auto& [segment_id, _] : segments) {
+                state.next_segment_id = std::max(state.next_segment_id, segment_id + 1);
+            }
+        }
+        loading.clear();
+    }
+    
+    // Parses symbol_segmentid.seg (symbols may contain '_')
+    static bool parse_segment_name(const std::filesystem::path& path,
+                                   std::string& symbol,
+                                   size_t& segment_id) {
+        if (path.extension() != ".seg") return false;
+        
+        std::string filename = path.stem().string();
+        auto last_underscore = filename.rfind('_');
+        if (last_underscore == std::string::npos || last_underscore == 0) {
+            return false;
+        }
+        
+        symbol = filename.substr(0, last_underscore);
+        try {
+            segment_id = std::stoull(filename.substr(last_underscore + 1));
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+    
+    // Deletes segment files the manifest never recorded: output of a flush
+    // or compaction that crashed before installing it
+    void remove_orphaned_segments() const {
+        for (const auto& entry : std::filesystem::directory_iterator(data_dir)) {
+            std::string symbol;
+            size_t segment_id;
+            if (!entry.is_regular_file() || !parse_segment_name(entry.path(), symbol, segment_id)) {
+                continue;
+            }
+            auto it = loading.find(symbol);
+            if (it == loading.end() || !it->second.contains(segment_id)) {
+                std::error_code ec;
+                std::filesystem::remove(entry.path(), ec);
+            }
+        }
+    }
+    
+    bool load_manifest() {
+        std::ifstream in(data_dir / MANIFEST_FILE, std::ios::binary);
+        if (!in) return false;
+        
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+        const uint8_t* ptr = data.data();
+        const uint8_t* end = data.data() + data.size();
+        while (static_cast<size_t>(end - ptr) >= MANIFEST_RECORD_HEADER_SIZE) {
+            uint32_t payload_size, crc;
+            std::memcpy(&payload_size, ptr, sizeof(payload_size));
+            std::memcpy(&crc, ptr + sizeof(payload_size), sizeof(crc));
+            const uint8_t* payload = ptr + MANIFEST_RECORD_HEADER_SIZE;
+            if (static_cast<size_t>(end - payload) < payload_size ||
+                utils::crc32(payload, payload_size) != crc ||
+                !apply_manifest_record(payload, payload + payload_size)) {
+                break; // Torn tail from a crash mid-append
+            }
+            ptr = payload + payload_size;
+        }
+        return true;
+    }
+    
+    bool apply_manifest_record(const uint8_t* ptr, const uint8_t* end) {
+        uint8_t type;
+        uint16_t symbol_len;
+        uint64_t segment_id;
+        if (!get(ptr, end, type) || !get(ptr, end, symbol_len) ||
+            static_cast<size_t>(end - ptr) < symbol_len) {
+            return false;
+        }
+        std::string symbol(reinterpret_cast<const char*>(ptr), symbol_len);
+        ptr += symbol_len;
+        if (!get(ptr, end, segment_id)) return false;
+        
+        if (type == MANIFEST_REMOVE) {
+            if (auto it = loading.find(symbol); it != loading.end()) {
+                it->second.erase(segment_id);
+            }
+            return ptr == end;
+        }
+        if (type != MANIFEST_ADD) return false;
+        
+        FileHeader header;
+        if (!get(ptr, end, header)) return false;
+        std::vector<BlockIndexEntry> blocks;
+        if (!decode_block_index(header.version, ptr, end - ptr, header.num_blocks, blocks)) {
+            return false;
+        }
+        
+        SegmentInfo info{
+            .start_time = from_ticks(header.start_ticks),
+            .end_time = from_ticks(header.end_ticks),
+            .num_points = header.num_points,
+            .file_path = segment_path(symbol, segment_id).string(),
+            .codec = static_cast<BlockCodec>(header.codec),
+            .blocks = std::move(blocks)
+        };
+        info.summarize();
+        loading[symbol].insert(segment_id, std::move(info));
+        return true;
+    }
+    
+    void recover_from_directory() {
+        for (const auto& entry : std::filesystem::directory_iterator(data_dir)) {
+            std::string symbol;
+            size_t segment_id;
+            if (!entry.is_regular_file() || !parse_segment_name(entry.path(), symbol, segment_id)) {
+                continue;
+            }
+            
+            if (auto info = read_segment_info(entry.path())) {
+                loading[symbol].insert(segment_id, std::move(*info));
+            }
+        }
+    }
+    
+    // Loads a segment's header and block index from its footer
+    std::optional<SegmentInfo> read_segment_info(const std::filesystem::path& path) const {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return std::nullopt;
+        
+        FileHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || header.magic != SEGMENT_MAGIC ||
+            (header.version != SEGMENT_VERSION && header.version != SEGMENT_VERSION_NO_STATS)) {
+            return std::nullopt;
+        }
+        
+        FileTrailer trailer;
+        in.seekg(-static_cast<std::streamoff>(sizeof(trailer)), std::ios::end);
+        in.read(reinterpret_cast<char*>(&trailer), sizeof(trailer));
+        if (!in || trailer.magic != SEGMENT_MAGIC || trailer.num_blocks != header.num_blocks) {
+            return std::nullopt;
+        }
+        
+        std::vector<uint8_t> index(trailer.num_blocks * block_index_entry_size(header.version));
+        in.seekg(trailer.index_offset);
+        in.read(reinterpret_cast<char*>(index.data()), index.size());
+        std::vector<BlockIndexEntry> blocks;
+        if (!in || !decode_block_index(header.version, index.data(), index.size(), trailer.num_blocks, blocks)) {
+            return std::nullopt;
+        }
+        
+        SegmentInfo info{
+            .start_time = from_ticks(header.start_ticks),
+            .end_time = from_ticks(header.end_ticks),
+            .num_points = header.num_points,
+            .file_path = path.string(),
+            .codec = static_cast<BlockCodec>(header.codec),
+            .blocks = std::move(blocks)
+        };
+        info.summarize();
+        return info;
+    }
+    
+    static void encode_add(std::vector<uint8_t>& out, const std::string& symbol,
+                           size_t segment_id, const SegmentInfo& info) {
+        std::vector<uint8_t> payload;
+        put<uint8_t>(payload, MANIFEST_ADD);
+        put<uint16_t>(payload, static_cast<uint16_t>(symbol.size()));
+        payload.insert(payload.end(), symbol.begin(), symbol.end());
+        put<uint64_t>(payload, segment_id);
+        put(payload, FileHeader{
+            .magic = SEGMENT_MAGIC,
+            .version = SEGMENT_VERSION,
+            .num_points = info.num_points,
+            .start_ticks = to_ticks(info.start_time),
+            .end_ticks = to_ticks(info.end_time),
+            .codec = static_cast<uint32_t>(info.codec),
+            .num_blocks = static_cast<uint32_t>(info.blocks.size())
+        });
+        const auto* blocks = reinterpret_cast<const uint8_t*>(info.blocks.data());
+        payload.insert(payload.end(), blocks, blocks + info.blocks.size() * sizeof(BlockIndexEntry));
+        frame_record(out, payload);
+    }
+    
+    static void encode_remove(std::vector<uint8_t>& out, const std::string& symbol, size_t segment_id) {
+        std::vector<uint8_t> payload;
+        put<uint8_t>(payload, MANIFEST_REMOVE);
+        put<uint16_t>(payload, static_cast<uint16_t>(symbol.size()));
+        payload.insert(payload.end(), symbol.begin(), symbol.end());
+        put<uint64_t>(payload, segment_id);
+        frame_record(out, payload);
+    }
+    
+    // Appends encoded records durably; once this returns they survive a
+    // crash. Caller holds the unique lock.
+    void append_manifest_locked(const std::vector<uint8_t>& records, size_t count) {
+        if (!write_all(manifest_fd, records) || fdatasync(manifest_fd) != 0) {
+            throw std::runtime_error("Failed to append to segment manifest");
+        }
+        bytes_written.add(records.size());
+        manifest_records += count;
+    }
+    
+    // Compacts the manifest once dead records outweigh live segments. Runs
+    // after an append is durable and published, so a failure loses nothing:
+    // the log still holds every record and a later append retries. Caller
+    // holds the unique lock.
+    void checkpoint_if_due_locked() {
+        if (manifest_records <= 2 * live_segments + MANIFEST_CHECKPOINT_SLACK) return;
+        try {
+            checkpoint_manifest_locked();
+        } catch (const std::exception&) {
+        }
+    }
+    
+    // Replaces the manifest with one add record per live segment
+    void checkpoint_manifest_locked() {
+        std::vector<uint8_t> records;
+        size_t count = 0;
+        for_each_symbol([&](const std::string& symbol, const SymbolState&, const SegmentIndex& segments) {
+            for (const auto& [segment_id, info] : segments) {
+                encode_add(records, symbol, segment_id, *info);
+                ++count;
+            }
+        });
+        
+        auto tmp_path = data_dir / (std::string(MANIFEST_FILE) + ".tmp");
+        int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+            throw std::runtime_error("Failed to create manifest: " + tmp_path.string());
+        }
+        if (!write_all(fd, records) || fdatasync(fd) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to write manifest: " + tmp_path.string());
+        }
+        close(fd);
+        bytes_written.add(records.size());
+        std::filesystem::rename(tmp_path, data_dir / MANIFEST_FILE);
+        if (!sync_path(data_dir, true)) {
+            throw std::runtime_error("Failed to sync manifest rename in " + data_dir.string());
+        }
+        
+        if (manifest_fd != -1) {
+            close(manifest_fd);
+            manifest_fd = -1;
+        }
+        manifest_fd = open((data_dir / MANIFEST_FILE).c_str(), O_WRONLY | O_APPEND);
+        if (manifest_fd == -1) {
+            throw std::runtime_error("Failed to open manifest in " + data_dir.string());
+        }
+        manifest_records = count;
+    }
+    
+    // Encodes one block into scratch.out; timestamps are stored as
+    // system_clock ticks
+    std::span<const uint8_t> encode_block(const TimeSeriesPoint* points,
+                                          size_t count,
+                                          EncodeScratch& scratch) const {
+        auto& timestamps = scratch.timestamps;
+        auto& values = scratch.values;
+        auto& out = scratch.out;
+        timestamps.resize(count);
+        values.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            timestamps[i] = to_ticks(points[i].timestamp);
+            values[i] = points[i].value;
+        }
+        
+        switch (write_codec) {
+        case BlockCodec::None: {
+            // Store raw timestamp column followed by the value column
+            out.resize(count * (sizeof(int64_t) + sizeof(double)));
+            std::memcpy(out.data(), timestamps.data(), count * sizeof(int64_t));
+            std::memcpy(out.data() + count * sizeof(int64_t), values.data(), count * sizeof(double));
+            break;
+        }
+        case BlockCodec::Zstd: {
+            // Compress using Rust, straight from the columns into the output buffer
+            out.resize(compress_columns_bound(count));
+            size_t compressed_size;
+            if (compress_columns(timestamps.data(), values.data(), count, 3,
+                                 out.data(), out.size(), &compressed_size) != 0) {
+                throw std::runtime_error("Failed to compress segment block");
+            }
+            out.resize(compressed_size);
+            break;
+        }
+        case BlockCodec::Gorilla:
+        case BlockCodec::GorillaZstd: {
+            // [uint32 timestamps_size][timestamp stream][value stream],
+            // encoded in place with the size patched in afterwards
+            auto& gorilla = write_codec == BlockCodec::GorillaZstd ? scratch.staging : out;
+            gorilla.clear();
+            put<uint32_t>(gorilla, 0);
+            utils::compress_timestamps(timestamps, gorilla);
+            const auto ts_size = static_cast<uint32_t>(gorilla.size() - sizeof(uint32_t));
+            std::memcpy(gorilla.data(), &ts_size, sizeof(ts_size));
+            utils::compress_doubles(values, gorilla);
+            
+            if (write_codec == BlockCodec::GorillaZstd) {
+                out.resize(zstd_compress_bound(gorilla.size()));
+                size_t compressed_size;
+                if (zstd_compress_into(gorilla.data(), gorilla.size(), 3,
+                                       out.data(), out.size(), &compressed_size) != 0) {
+                    throw std::runtime_error("Failed to compress segment block");
+                }
+                out.resize(compressed_size);
+            }
+            break;
+        }
+        }
+        
+        return out;
+    }
+    
+    // Visits the part of a sorted column pair that lies within [start, end]
+    static void visit_trimmed(std::span<const int64_t> timestamps,
+                              std::span<const double> values,
+                              int64_t start,
+                              int64_t end,
+                              const ColumnVisitor& visitor) {
+        auto first = std::lower_bound(timestamps.begin(), timestamps.end(), start);
+        auto last = std::upper_bound(first, timestamps.end(), end);
+        if (first == last) return;
+        size_t offset = first - timestamps.begin();
+        size_t count = last - first;
+        visitor(timestamps.subspan(offset, count), values.subspan(offset, count));
+    }
+    
+    std::shared_ptr<const DecodedBlock> decode_gorilla(std::span<const uint8_t> data) const {
+        const uint8_t* ptr = data.data();
+        const uint8_t* end = data.data() + data.size();
+        uint32_t ts_size;
+        if (!get(ptr, end, ts_size) || static_cast<size_t>(end - ptr) < ts_size) {
+            throw std::runtime_error("Corrupt Gorilla segment block");
+        }
+        
+        auto block = block_pool.acquire();
+        utils::decompress_timestamps({ptr, ts_size}, block->timestamps);
+        utils::decompress_doubles({ptr + ts_size, end}, block->values);
+        if (block->timestamps.size() != block->values.size()) {
+            throw std::runtime_error("Corrupt Gorilla segment block");
+        }
+        return block;
+    }
+    
+    std::shared_ptr<const DecodedBlock> decode_compressed(BlockCodec codec,
+                                                          std::span<const uint8_t> data,
+                                                          size_t num_points) const {
+        if (codec == BlockCodec::Gorilla) {
+            return decode_gorilla(data);
+        }
+        if (codec == BlockCodec::GorillaZstd) {
+            // Per-thread staging buffer, reused across blocks
+            thread_local std::vector<uint8_t> staging;
+            // Bound the frame header's claim before allocating for it
+            const size_t decompressed = zstd_decompressed_size(data.data(), data.size());
+            if (decompressed == 0 ||
+                decompressed > GORILLA_BLOCK_OVERHEAD + num_points * MAX_GORILLA_BYTES_PER_POINT) {
+                throw std::runtime_error("Corrupt GorillaZstd segment block");
+            }
+            staging.resize(decompressed);
+            size_t size;
+            if (zstd_decompress_into(data.data(), data.size(), staging.data(), staging.size(), &size) != 0) {
+                throw std::runtime_error("Corrupt GorillaZstd segment block");
+            }
+            return decode_gorilla({staging.data(), size});
+        }
+        
+        // Decompress using Rust, straight into the block's columns
+        auto block = block_pool.acquire();
+        block->timestamps.resize(num_points);
+        block->values.resize(num_points);
+        size_t decoded_points;
+        if (decompress_columns(data.data(), data.size(),
+                               block->timestamps.data(), block->values.data(),
+                               num_points, &decoded_points) != 0 ||
+            decoded_points != num_points) {
+            throw std::runtime_error("Corrupt Zstd segment block");
+        }
+        return block;
+    }
+    
+    // Fetches raw block bytes of one segment, from the mapping or with
+    // positional reads. Blocks announced by plan() are fetched ahead: mapped
+    // ranges go to kernel readahead, and file reads are kept a few blocks
+    // deep on the async reader, so decoding one block overlaps the I/O of
+    // the next ones.
+    struct BlockReader {
+        // A block read issued ahead of its use
+        struct Ahead {
+            uint64_t offset;
+            std::vector<uint8_t> buffer;
+            AsyncReader::Pending read;
+        };
+        
+        std::string file_path;
+        std::span<const uint8_t> mapped; // empty when reading through `file`
+        FileDescriptor file;
+        const AsyncReader* io = nullptr; // null reads synchronously
+        metrics::Counter* bytes_counter = nullptr; // Counts every block fetched
+        size_t read_ahead = 0;
+        std::span<const BlockIndexEntry> planned;
+        size_t next_planned = 0;
+        std::deque<Ahead> ahead; // Declared after `file`, so waited for before it closes
+        std::vector<std::vector<uint8_t>> spare;
+        std::vector<uint8_t> buffer;
+        
+        bool in_place() const { return file.get() == -1; }
+        
+        // Announces the blocks about to be read, in order
+        void plan(std::span<const BlockIndexEntry> blocks) {
+            if (blocks.empty()) return;
+            if (in_place()) {
+                advise_will_need(mapped, blocks.front().offset,
+                                 blocks.back().offset + blocks.back().size);
+                return;
+            }
+            ahead.clear();
+            planned = blocks;
+            next_planned = 0;
+            top_up();
+        }
+        
+        // Valid until the next call; forever when in_place()
+        std::span<const uint8_t> read(const BlockIndexEntry& block) {
+            if (bytes_counter) bytes_counter->add(block.size);
+            if (in_place()) {
+                if (block.offset + block.size > mapped.size()) {
+                    throw std::runtime_error("Segment block out of bounds: " + file_path);
+                }
+                return mapped.subspan(block.offset, block.size);
+            }
+            
+            if (!ahead.empty() && ahead.front().offset == block.offset) {
+                auto& next = ahead.front();
+                try {
+                    next.read.wait();
+                } catch (const std::exception& e) {
+                    throw std::runtime_error("Failed to read segment block: " + file_path + ": " + e.what());
+                }
+                spare.push_back(std::move(buffer));
+                buffer = std::move(next.buffer);
+                ahead.pop_front();
+                top_up();
+                return buffer;
+            }
+            
+            // Off the plan: drop the read-ahead and read directly
+            ahead.clear();
+            planned = {};
+            buffer.resize(block.size);
+            if (!read_at(file.get(), block.offset, buffer)) {
+                throw std::runtime_error("Failed to read segment block: " + file_path);
+            }
+            return buffer;
+        }
+        
+        // A planned block served from elsewhere, e.g. the block cache
+        void skip(const BlockIndexEntry& block) {
+            if (!ahead.empty() && ahead.front().offset == block.offset) {
+                spare.push_back(std::move(ahead.front().buffer));
+                ahead.pop_front();
+                top_up();
+            }
+        }
+        
+    private:
+        void top_up() {
+            while (io && ahead.size() < read_ahead && next_planned < planned.size()) {
+                const auto& block = planned[next_planned++];
+                auto& next = ahead.emplace_back();
+                next.offset = block.offset;
+                if (!spare.empty()) {
+                    next.buffer = std::move(spare.back());
+                    spare.pop_back();
+                }
+                next.buffer.resize(block.size);
+                next.read = io->read(file.get(), block.offset, next.buffer);
+            }
+        }
+    };
+    
+    // Opens the segment file now, so the reader survives a later unlink
+    BlockReader open_block_reader(const SegmentInfo& info) const {
+        BlockReader reader;
+        reader.file_path = info.file_path;
+        reader.bytes_counter = &bytes_read;
+        if (config.use_mmap) {
+            reader.mapped = mapped_bytes(info);
+        } else {
+            reader.file = FileDescriptor(open(info.file_path.c_str(), O_RDONLY | O_CLOEXEC));
+            if (reader.file.get() == -1) {
+                throw std::runtime_error("Failed to open segment file: " + info.file_path);
+            }
+            reader.io = io.get();
+            reader.read_ahead = config.read_ahead_blocks;
+        }
+        return reader;
+    }
+    
+    // Decoded columns of a block. Uncompressed blocks are views into the
+    // mapping (owner is null) unless they were read through a stream and
+    // must outlive the next read, in which case they are copied.
+    struct BlockView {
+        std::shared_ptr<const DecodedBlock> owner;
+        std::span<const int64_t> timestamps;
+        std::span<const double> values;
+    };
     
-    explicit Impl(const std::filesystem::path& dir, const DiskConfig& cfg) 
-        : data_dir(dir), config(cfg) {
-        std::filesystem::create_directories(dir);
-        load_existing_segments();
+    // Uncompressed blocks are viewed in place; compressed ones are decoded
+    // once and then served from the block cache. Compaction reads blocks
+    // that are about to be dropped and passes use_cache = false.
+    BlockView load_block(const BlockKey& key,
+                         const BlockIndexEntry& block,
+                         BlockCodec codec,
+                         BlockReader& reader,
+                         bool must_persist,
+                         bool use_cache = true) const {
+        BlockView view;
+        if (codec == BlockCodec::None) {
+            auto data = reader.read(block);
+            if (data.size() != block.num_points * (sizeof(int64_t) + sizeof(double))) {
+                throw std::runtime_error("Corrupt uncompressed segment block");
+            }
+            // Blocks start 8-byte aligned, so the columns can be viewed directly
+            const auto* timestamps = reinterpret_cast<const int64_t*>(data.data());
+            const auto* values = reinterpret_cast<const double*>(data.data() + block.num_points * sizeof(int64_t));
+            view.timestamps = {timestamps, block.num_points};
+            view.values = {values, block.num_points};
+            
+            if (must_persist && !reader.in_place()) {
+                auto copy = block_pool.acquire();
+                copy->timestamps.assign(view.timestamps.begin(), view.timestamps.end());
+                copy->values.assign(view.values.begin(), view.values.end());
+                view.timestamps = copy->timestamps;
+                view.values = copy->values;
+                view.owner = std::move(copy);
+            }
+            return view;
+        }
+        
+        auto decoded = use_cache ? block_cache.get(key) : nullptr;
+        if (decoded) {
+            reader.skip(block);
+        } else {
+            auto data = reader.read(block);
+            metrics::ScopedTimer timer(decode_latency);
+            decoded = decode_compressed(codec, data, block.num_points);
+            if (use_cache) {
+                block_cache.put(key, decoded);
+            }
+        }
+        view.timestamps = decoded->timestamps;
+        view.values = decoded->values;
+        view.owner = std::move(decoded);
+        return view;
     }
     
-    void load_existing_segments() {
-        for (const auto& entry : std::filesystem::directory_iterator(data_dir)) {
-            if (!entry.is_regular_file()) continue;
+    // Streams sorted points into a new segment file, one block at a time
+    class SegmentWriter {
+    public:
+        SegmentWriter(const Impl& layer, std::string file_path)
+            : layer_(layer),
+              file_path_(std::move(file_path)),
+              points_per_block_(std::max<size_t>(layer.config.points_per_block, 1)),
+              out_(file_path_, std::ios::binary),
+              scratch_(layer.scratch_pool.acquire()) {
+            if (!out_) {
+                throw std::runtime_error("Failed to create segment file: " + file_path_);
+            }
+            // Placeholder header; an unfinished file never passes validation
+            FileHeader header{};
+            out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            pending_.reserve(points_per_block_);
+        }
+        
+        const std::string& file_path() const { return file_path_; }
+        size_t num_points() const { return num_points_; }
+        
+        void append(const TimeSeriesPoint* points, size_t count) {
+            while (count > 0) {
+                if (pending_.empty() && count >= points_per_block_) {
+                    write_block(points, points_per_block_);
+                    points += points_per_block_;
+                    count -= points_per_block_;
+                    continue;
+                }
+                size_t take = std::min(points_per_block_ - pending_.size(), count);
+                pending_.insert(pending_.end(), points, points + take);
+                points += take;
+                count -= take;
+                if (pending_.size() == points_per_block_) {
+                    write_block(pending_.data(), pending_.size());
+                    pending_.clear();
+                }
+            }
+        }
+        
+        // Writes the index and trailer, then the real header
+        SegmentInfo finish() {
+            if (!pending_.empty()) {
+                write_block(pending_.data(), pending_.size());
+                pending_.clear();
+            }
+            if (num_points_ == 0) {
+                throw std::runtime_error("Empty segment file: " + file_path_);
+            }
             
-            const auto& path = entry.path();
-            if (path.extension() != ".dat") continue;
+            out_.write(reinterpret_cast<const char*>(blocks_.data()), blocks_.size() * sizeof(BlockIndexEntry));
+            FileTrailer trailer{
+                .index_offset = offset_,
+                .num_blocks = static_cast<uint32_t>(blocks_.size()),
+                .magic = SEGMENT_MAGIC
+            };
+            out_.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
             
-            // Parse filename: symbol_starttime_endtime.dat
-            std::string filename = path.stem().string();
-            auto first_underscore = filename.find('_');
-            auto last_underscore = filename.rfind('_');
+            FileHeader header{
+                .magic = SEGMENT_MAGIC,
+                .version = SEGMENT_VERSION,
+                .num_points = num_points_,
+                .start_ticks = blocks_.front().min_ticks,
+                .end_ticks = blocks_.back().max_ticks,
+                .codec = static_cast<uint32_t>(layer_.write_codec),
+                .num_blocks = static_cast<uint32_t>(blocks_.size())
+            };
+            out_.seekp(0);
+            out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
             
-            if (first_underscore == std::string::npos || last_underscore == std::string::npos) {
-                continue;
+            out_.close();
+            if (!out_) {
+                throw std::runtime_error("Failed to write segment file: " + file_path_);
             }
-            
-            std::string symbol = filename.substr(0, first_underscore);
-            int64_t start_time = std::stoll(filename.substr(first_underscore + 1, last_underscore - first_underscore - 1));
-            int64_t end_time = std::stoll(filename.substr(last_underscore + 1));
+            // Durable before the manifest names it: the caller then drops the
+            // WAL or the compaction inputs that are its only other copy
+            const std::filesystem::path path(file_path_);
+            if (!sync_path(path) || !sync_path(path.parent_path(), true)) {
+                throw std::runtime_error("Failed to sync segment file: " + file_path_);
+            }
+            layer_.bytes_written.add(offset_ + blocks_.size() * sizeof(BlockIndexEntry) + sizeof(trailer));
             
             SegmentInfo info{
-                .start_time = std::chrono::system_clock::time_point(std::chrono::microseconds(start_time)),
-                .end_time = std::chrono::system_clock::time_point(std::chrono::microseconds(end_time)),
-                .num_points = count_points_in_segment(path),
-                .file_path = path.string(),
-                .compressed = false
+                .start_time = from_ticks(header.start_ticks),
+                .end_time = from_ticks(header.end_ticks),
+                .num_points = num_points_,
+                .file_path = file_path_,
+                .codec = layer_.write_codec,
+                .blocks = std::move(blocks_)
             };
+            info.summarize();
+            return info;
+        }
+        
+    private:
+        void write_block(const TimeSeriesPoint* points, size_t count) {
+            auto data = layer_.encode_block(points, count, *scratch_);
+            out_.write(reinterpret_cast<const char*>(data.data()), data.size());
+            
+            RangeStats stats;
+            uint64_t flags = BLOCK_DISTINCT;
+            for (size_t i = 0; i < count; ++i) {
+                stats.add(points[i].value);
+                if (i > 0 && points[i].timestamp == points[i - 1].timestamp) {
+                    flags = 0;
+                }
+            }
+            const int64_t min_ticks = to_ticks(points[0].timestamp);
+            if (!blocks_.empty() && blocks_.back().max_ticks == min_ticks) {
+                blocks_.back().flags = 0;
+                flags = 0;
+            }
             
-            std::unique_lock lock(mutex);
-            metadata[symbol][0] = info;
+            blocks_.push_back(BlockIndexEntry{
+                .min_ticks = min_ticks,
+                .max_ticks = to_ticks(points[count - 1].timestamp),
+                .offset = offset_,
+                .size = data.size(),
+                .num_points = count,
+                .min_value = stats.min,
+                .max_value = stats.max,
+                .sum = stats.sum,
+                .flags = flags
+            });
+            offset_ += data.size();
+            num_points_ += count;
         }
+        
+        const Impl& layer_;
+        std::string file_path_;
+        size_t points_per_block_;
+        std::ofstream out_;
+        std::vector<TimeSeriesPoint> pending_;
+        std::vector<BlockIndexEntry> blocks_;
+        std::shared_ptr<EncodeScratch> scratch_; // Pooled, so back-to-back writes reuse buffers
+        uint64_t offset_ = sizeof(FileHeader);
+        size_t num_points_ = 0;
+    };
+    
+    // Points must be sorted by timestamp. Does not touch metadata.
+    SegmentInfo write_segment_file(const std::string& symbol,
+                                   const std::vector<TimeSeriesPoint>& points,
+                                   size_t segment_id) const {
+        SegmentWriter writer(*this, segment_path(symbol, segment_id).string());
+        writer.append(points.data(), points.size());
+        return writer.finish();
     }
     
-    size_t count_points_in_segment(const std::filesystem::path& path) {
-        std::ifstream file(path, std::ios::binary);
-        if (!file) return 0;
-        
-        file.seekg(0, std::ios::end);
-        auto size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        
-        // Read header to get point count
-        uint64_t num_points;
-        file.read(reinterpret_cast<char*>(&num_points), sizeof(num_points));
-        
-        return num_points;
+    // Removes a flush's id reservation. Caller holds the unique lock.
+    void drop_pending_locked(const std::string& symbol, size_t segment_id) {
+        state_locked(symbol).pending.erase(segment_id);
     }
     
-    void write_segment(const std::string& symbol,
-                      const std::vector<TimeSeriesPoint>& points,
-                      size_t segment_id) {
+    // Points must be sorted by timestamp
+    void write_segment(const std::string& symbol, const std::vector<TimeSeriesPoint>& points) {
         if (points.empty()) return;
-
-        // Create segment file path
-        auto segment_file = (data_dir / (symbol + "_" + std::to_string(segment_id) + ".seg")).string();
-        
-        std::vector<uint8_t> data;
-        size_t data_size = 0;
         
-        if (config.enable_compression) {
-            // Convert C++ points to Rust TimePoints
-            std::vector<TimePoint> rust_points;
-            rust_points.reserve(points.size());
-            for (const auto& p : points) {
-                rust_points.push_back(TimePoint{
-                    .timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-                        p.timestamp.time_since_epoch()).count(),
-                    .value = p.value
-                });
-            }
-            
-            // Compress using Rust
-            size_t compressed_size;
-            uint8_t* compressed = compress_time_series(
-                rust_points.data(),
-                rust_points.size(),
-                &compressed_size
-            );
-            
-            // Copy compressed data
-            data.resize(compressed_size);
-            std::memcpy(data.data(), compressed, compressed_size);
-            data_size = compressed_size;
-            
-            // Free Rust-allocated memory
-            free_compressed_data(compressed, compressed_size);
-        } else {
-            // Store points directly
-            data.resize(points.size() * sizeof(TimeSeriesPoint));
-            std::memcpy(data.data(), points.data(), data.size());
-            data_size = data.size();
+        size_t segment_id;
+        {
+            auto lock = metrics::lock_unique(mutex, lock_wait);
+            auto& state = state_locked(symbol);
+            segment_id = state.next_segment_id++;
+            state.pending[segment_id] = {to_ticks(points.front().timestamp),
+                                         to_ticks(points.back().timestamp)};
         }
         
-        // Write to file
-        std::ofstream out(segment_file, std::ios::binary);
-        if (!out) {
-            throw std::runtime_error("Failed to create segment file: " + segment_file);
+        // Until the manifest records it, a failure removes the file
+        std::unique_lock<std::shared_mutex> lock;
+        try {
+            auto info = write_segment_file(symbol, points, segment_id);
+            std::vector<uint8_t> record;
+            encode_add(record, symbol, segment_id, info);
+            lock = metrics::lock_unique(mutex, lock_wait);
+            drop_pending_locked(symbol, segment_id);
+            append_manifest_locked(record, 1);
+            update_segments_locked(state_locked(symbol), [&](SegmentIndex& segments) {
+                segments.insert(segment_id, std::move(info));
+            });
+        } catch (...) {
+            if (lock) lock.unlock();
+            {
+                auto lock = metrics::lock_unique(mutex, lock_wait);
+                drop_pending_locked(symbol, segment_id);
+            }
+            segments_changed.notify_all();
+            std::error_code ec;
+            std::filesystem::remove(segment_path(symbol, segment_id), ec);
+            throw;
         }
-        
-        // Write header
-        SegmentInfo info{
-            .start_time = points.front().timestamp,
-            .end_time = points.back().timestamp,
-            .num_points = points.size(),
-            .file_path = segment_file,
-            .compressed = config.enable_compression
-        };
-        
-        out.write(reinterpret_cast<const char*>(&info), sizeof(info));
-        out.write(reinterpret_cast<const char*>(&data_size), sizeof(data_size));
-        out.write(reinterpret_cast<const char*>(data.data()), data_size);
-        
-        out.close();
-        
-        // Update metadata
-        std::unique_lock lock(mutex);
-        metadata[symbol][segment_id] = info;
+        checkpoint_if_due_locked();
+        lock.unlock();
+        segments_changed.notify_all();
+        signal_compaction();
     }
-
-    std::vector<TimeSeriesPoint> read_segment(const std::string& symbol, size_t segment_id) {
-        std::shared_lock lock(mutex);
-        
-        auto symbol_it = metadata.find(symbol);
-        if (symbol_it == metadata.end()) {
-            return {};
+    
+    // Maps the segment file on first use and keeps it mapped
+    std::span<const uint8_t> mapped_bytes(const SegmentInfo& info) const {
+        auto& file = *info.file;
+        std::call_once(file.once, [&] {
+            file.mapping = std::make_unique<utils::MemoryMappedFile>(info.file_path);
+        });
+        return {static_cast<const uint8_t*>(file.mapping->data()), file.mapping->size()};
+    }
+    
+    // Visits only the blocks of a segment that overlap [start, end]. Caller
+    // keeps the segment alive (pins a version holding it).
+    void scan_segment(const std::string& symbol,
+                      size_t segment_id,
+                      const SegmentInfo& info,
+                      int64_t start,
+                      int64_t end,
+                      const ColumnVisitor& visitor) const {
+        // Blocks are time-ordered: skip straight to the first one that can match
+        auto block_it = std::lower_bound(info.blocks.begin(), info.blocks.end(), start,
+            [](const BlockIndexEntry& block, int64_t ts) { return block.max_ticks < ts; });
+        if (block_it == info.blocks.end() || block_it->min_ticks > end) {
+            return;
         }
         
-        auto segment_it = symbol_it->second.find(segment_id);
-        if (segment_it == symbol_it->second.end()) {
-            return {};
+        auto reader = open_block_reader(info);
+        auto block_end = std::upper_bound(block_it, info.blocks.end(), end,
+            [](int64_t ts, const BlockIndexEntry& block) { return ts < block.min_ticks; });
+        reader.plan({&*block_it, static_cast<size_t>(block_end - block_it)});
+        for (; block_it != info.blocks.end() && block_it->min_ticks <= end; ++block_it) {
+            BlockKey key{symbol, segment_id, static_cast<size_t>(block_it - info.blocks.begin())};
+            auto view = load_block(key, *block_it, info.codec, reader, false);
+            visit_trimmed(view.timestamps, view.values, start, end, visitor);
         }
-        
-        const auto& info = segment_it->second;
-        
-        // Open segment file
-        std::ifstream in(info.file_path, std::ios::binary);
-        if (!in) {
-            throw std::runtime_error("Failed to open segment file: " + info.file_path);
+    }
+    
+    // Compaction unit: segments merged into new segments with fresh ids
+    struct CompactionJob {
+        std::string symbol;
+        std::vector<std::pair<size_t, SegmentIndex::SharedInfo>> inputs; // oldest first
+        size_t first_output_id;
+    };
+    
+    // Largest segment compaction produces; bigger ones are left alone
+    size_t max_segment_points() const {
+        constexpr size_t raw_point_size = sizeof(int64_t) + sizeof(double);
+        return std::max<size_t>(config.max_segment_size_mb * 1024 * 1024 / raw_point_size,
+                                config.points_per_block);
+    }
+    
+    size_t compaction_fanin() const {
+        return std::max<size_t>(config.compaction_fanin, 2);
+    }
+    
+    // Size tier: floor(log_fanin(blocks)), so a tier holds segments within a
+    // factor of fanin of each other
+    size_t tier_of(const SegmentInfo& info) const {
+        size_t units = info.num_points / std::max<size_t>(config.points_per_block, 1);
+        size_t tier = 0;
+        for (; units >= compaction_fanin(); units /= compaction_fanin()) {
+            ++tier;
         }
+        return tier;
+    }
+    
+    // Outputs get ids newer than every input, which is only safe if no
+    // segment newer than the oldest input shares a timestamp with the run.
+    // Grows the run over such overlapping segments; false when it can't.
+    // Caller holds the unique lock.
+    bool close_run_locked(const std::string& symbol, std::vector<size_t>& run) const {
+        const auto& state = *find_state(symbol);
+        const auto& segments = state.segments();
+        const size_t max_inputs = 4 * compaction_fanin();
         
-        // Skip header
-        in.seekg(sizeof(SegmentInfo));
-        
-        // Read data size
-        size_t data_size;
-        in.read(reinterpret_cast<char*>(&data_size), sizeof(data_size));
-        
-        // Read data
-        std::vector<uint8_t> data(data_size);
-        in.read(reinterpret_cast<char*>(data.data()), data_size);
-        
-        std::vector<TimeSeriesPoint> points;
-        
-        if (info.compressed) {
-            // Decompress using Rust
-            size_t num_points;
-            TimePoint* rust_points = decompress_time_series(
-                data.data(),
-                data_size,
-                &num_points
-            );
+        while (true) {
+            std::sort(run.begin(), run.end());
+            int64_t lo = std::numeric_limits<int64_t>::max();
+            int64_t hi = std::numeric_limits<int64_t>::min();
+            for (size_t segment_id : run) {
+                const auto& info = segments.at(segment_id);
+                lo = std::min(lo, to_ticks(info.start_time));
+                hi = std::max(hi, to_ticks(info.end_time));
+            }
             
-            // Convert Rust points to C++ points
-            points.reserve(num_points);
-            for (size_t i = 0; i < num_points; ++i) {
-                points.push_back(TimeSeriesPoint{
-                    .symbol = symbol,
-                    .timestamp = std::chrono::system_clock::time_point(
-                        std::chrono::microseconds(rust_points[i].timestamp)),
-                    .value = rust_points[i].value
-                });
+            for (const auto& [segment_id, range] : state.pending) {
+                if (segment_id > run.front() && range.first <= hi && range.second >= lo) {
+                    return false;
+                }
             }
             
-            // Free Rust-allocated memory
-            free_time_points(rust_points, num_points);
-        } else {
-            // Read uncompressed points directly
-            const auto* point_data = reinterpret_cast<const TimeSeriesPoint*>(data.data());
-            points = std::vector<TimeSeriesPoint>(point_data, point_data + info.num_points);
+            bool grew = false;
+            for (size_t segment_id : segments.overlapping(lo, hi)) {
+                if (segment_id < run.front() || std::binary_search(run.begin(), run.end(), segment_id)) {
+                    continue;
+                }
+                const auto& info = segments.at(segment_id);
+                if (info.num_points >= max_segment_points() || run.size() >= max_inputs) {
+                    return false;
+                }
+                run.push_back(segment_id);
+                grew = true;
+                break;
+            }
+            if (!grew) return true;
         }
-        
-        return points;
     }
     
-    std::vector<TimeSeriesPoint> range_query(const std::string& symbol,
-                                           std::chrono::system_clock::time_point start,
-                                           std::chrono::system_clock::time_point end) {
-        std::shared_lock<std::shared_mutex> lock(mutex);
-        std::vector<TimeSeriesPoint> results;
-        
-        auto symbol_it = metadata.find(symbol);
-        if (symbol_it == metadata.end()) {
-            return results;
+    // Tiered policy: merges fanin segments of the smallest tier that has
+    // enough of them. Caller holds the unique lock.
+    std::vector<size_t> pick_run_locked(const std::string& symbol) const {
+        std::map<size_t, std::vector<size_t>> tiers;
+        for (const auto& [segment_id, info] : find_state(symbol)->segments()) {
+            if (info->num_points < max_segment_points()) {
+                tiers[tier_of(*info)].push_back(segment_id);
+            }
         }
         
-        // Find relevant segments
-        std::vector<size_t> relevant_segments;
-        for (const auto& [segment_id, segment_info] : symbol_it->second) {
-            if (segment_info.start_time <= end && segment_info.end_time >= start) {
-                relevant_segments.push_back(segment_id);
+        const size_t fanin = compaction_fanin();
+        for (auto& [tier, members] : tiers) {
+            std::sort(members.begin(), members.end());
+            for (size_t first = 0; first + fanin <= members.size(); ++first) {
+                std::vector<size_t> run(members.begin() + first, members.begin() + first + fanin);
+                if (close_run_locked(symbol, run)) {
+                    return run;
+                }
             }
         }
+        return {};
+    }
+    
+    // Marks the symbol as compacting and reserves ids for the outputs.
+    // Caller holds the unique lock.
+    CompactionJob make_job_locked(const std::string& symbol, const std::vector<size_t>& run) {
+        CompactionJob job{.symbol = symbol, .inputs = {}, .first_output_id = 0};
+        auto& state = state_locked(symbol);
+        size_t total_points = 0;
+        for (size_t segment_id : run) {
+            job.inputs.emplace_back(segment_id, state.segments().share(segment_id));
+            total_points += job.inputs.back().second->num_points;
+        }
         
-        // Read and filter points from each relevant segment
-        for (size_t segment_id : relevant_segments) {
-            auto points = read_segment(symbol, segment_id);
-            for (const auto& point : points) {
-                if (point.timestamp >= start && point.timestamp < end) {
-                    results.push_back(point);
+        job.first_output_id = state.next_segment_id;
+        state.next_segment_id += total_points / max_segment_points() + 1;
+        state.compacting = true;
+        return job;
+    }
+    
+    std::optional<CompactionJob> pick_compaction() {
+        auto lock = metrics::lock_unique(mutex, lock_wait);
+        std::optional<CompactionJob> job;
+        const SymbolId count = catalog->size();
+        for (SymbolId id = 0; id < count && !job; ++id) {
+            const auto* state = find_state(id);
+            if (state == nullptr || state->compacting || state->segments().empty()) continue;
+            const auto& symbol = catalog->name(id);
+            auto run = pick_run_locked(symbol);
+            if (!run.empty()) {
+                job = make_job_locked(symbol, run);
+            }
+        }
+        return job;
+    }
+    
+    // Merges every segment of a symbol. Waits for in-flight flushes and
+    // compactions of that symbol so the merge sees all of them.
+    void compact_symbol(const std::string& symbol) {
+        CompactionJob job;
+        {
+            auto lock = metrics::lock_unique(mutex, lock_wait);
+            segments_changed.wait(lock, [&] {
+                const auto* state = find_state(symbol);
+                return state == nullptr || (!state->compacting && state->pending.empty());
+            });
+            const auto* state = find_state(symbol);
+            if (state == nullptr || state->segments().empty()) {
+                return;
+            }
+            std::vector<size_t> run;
+            for (const auto& [segment_id, _] : state->segments()) {
+                run.push_back(segment_id);
+            }
+            std::sort(run.begin(), run.end());
+            job = make_job_locked(symbol, run);
+        }
+        run_compaction(job);
+    }
+    
+    // Streams the inputs through a merging cursor into new segments, then
+    // swaps them in. Defined after Cursor::Impl.
+    void run_compaction(const CompactionJob& job);
+    
+    void signal_compaction() {
+        if (workers.empty()) return;
+        {
+            std::lock_guard lock(worker_mutex);
+            work_signalled = true;
+        }
+        worker_cv.notify_all();
+    }
+    
+    void compaction_loop() {
+        const auto interval = std::chrono::milliseconds(std::max<size_t>(config.compaction_interval_ms, 1));
+        while (true) {
+            {
+                std::unique_lock lock(worker_mutex);
+                worker_cv.wait_for(lock, interval, [this] { return work_signalled || stopping; });
+                if (stopping) return;
+                work_signalled = false;
+            }
+            
+            try {
+                while (!stopping) {
+                    auto job = pick_compaction();
+                    if (!job) break;
+                    run_compaction(*job);
                 }
+            } catch (const std::exception& e) {
+                fprintf(stderr, "Background compaction failed: %s\n", e.what());
             }
         }
-        
-        // Sort results by timestamp
-        std::sort(results.begin(), results.end(),
-                 [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                     return a.timestamp < b.timestamp;
-                 });
-        
-        return results;
     }
+};
+
+struct DiskLayer::Cursor::Impl {
+    using LayerImpl = DiskLayer::Impl;
     
-    void optimize_segments(const std::string& symbol) {
-        std::unique_lock<std::shared_mutex> lock(mutex);
-        
-        auto symbol_it = metadata.find(symbol);
-        if (symbol_it == metadata.end()) {
-            return;
+    struct SegmentStream {
+        size_t segment_id;
+        LayerImpl::SegmentIndex::SharedInfo info; // Keeps the file until the cursor is done
+        LayerImpl::BlockReader reader;
+        size_t next_block;
+        LayerImpl::BlockView view;
+        size_t pos = 0;
+    };
+    
+    // Heap entry: current timestamp of a stream. Ties pop the newest segment
+    // (highest stream index) first so it wins the duplicate.
+    using HeadEntry = std::pair<int64_t, size_t>;
+    struct HeadOrder {
+        bool operator()(const HeadEntry& a, const HeadEntry& b) const {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
         }
+    };
+    
+    const LayerImpl* layer;
+    std::string symbol;
+    int64_t start;
+    int64_t end;
+    bool use_cache = true;
+    std::vector<SegmentStream> streams;
+    std::priority_queue<HeadEntry, std::vector<HeadEntry>, HeadOrder> heads;
+    
+    // Streams must be added oldest first, then primed once
+    void add_stream(size_t segment_id, LayerImpl::SegmentIndex::SharedInfo info) {
+        auto block_it = std::lower_bound(info->blocks.begin(), info->blocks.end(), start,
+            [](const BlockIndexEntry& block, int64_t ts) { return block.max_ticks < ts; });
+        const size_t next_block = static_cast<size_t>(block_it - info->blocks.begin());
+        auto reader = layer->open_block_reader(*info);
+        streams.push_back(SegmentStream{
+            .segment_id = segment_id,
+            .info = std::move(info),
+            .reader = std::move(reader),
+            .next_block = next_block,
+            .view = {}
+        });
         
-        // Collect all points
-        std::vector<TimeSeriesPoint> all_points;
-        for (const auto& [segment_id, segment_info] : symbol_it->second) {
-            auto points = read_segment(symbol, segment_id);
-            all_points.insert(all_points.end(), points.begin(), points.end());
+        // Every stream's first reads go out now, before any is decoded
+        auto& stream = streams.back();
+        const auto& blocks = stream.info->blocks;
+        auto first = blocks.begin() + stream.next_block;
+        auto last = std::upper_bound(first, blocks.end(), end,
+            [](int64_t ts, const BlockIndexEntry& block) { return ts < block.min_ticks; });
+        stream.reader.plan({blocks.data() + stream.next_block, static_cast<size_t>(last - first)});
+    }
+    
+    void prime() {
+        for (size_t idx = 0; idx < streams.size(); ++idx) {
+            if (load_next_block(idx)) {
+                heads.emplace(streams[idx].view.timestamps[0], idx);
+            }
+        }
+    }
+    
+    // Loads the next non-empty trimmed block of a stream
+    bool load_next_block(size_t idx) {
+        auto& stream = streams[idx];
+        const auto& blocks = stream.info->blocks;
+        while (stream.next_block < blocks.size() && blocks[stream.next_block].min_ticks <= end) {
+            const auto& block = blocks[stream.next_block];
+            BlockKey key{symbol, stream.segment_id, stream.next_block++};
+            auto view = layer->load_block(key, block, stream.info->codec, stream.reader, true, use_cache);
             
-            // Remove old segment file
-            std::filesystem::remove(segment_info.file_path);
+            auto first = std::lower_bound(view.timestamps.begin(), view.timestamps.end(), start);
+            auto last = std::upper_bound(first, view.timestamps.end(), end);
+            if (first == last) continue;
+            
+            size_t offset = first - view.timestamps.begin();
+            size_t count = last - first;
+            view.timestamps = view.timestamps.subspan(offset, count);
+            view.values = view.values.subspan(offset, count);
+            stream.view = std::move(view);
+            stream.pos = 0;
+            return true;
         }
-        
-        if (all_points.empty()) {
-            return;
+        stream.view = {};
+        return false;
+    }
+    
+    // Moves a stream to its next point; false once it is exhausted
+    bool step(size_t idx) {
+        auto& stream = streams[idx];
+        return ++stream.pos < stream.view.timestamps.size() || load_next_block(idx);
+    }
+    
+    void advance(size_t idx) {
+        if (step(idx)) {
+            heads.emplace(streams[idx].view.timestamps[streams[idx].pos], idx);
+        }
+    }
+    
+    bool next(std::vector<TimeSeriesPoint>& batch, size_t max_points) {
+        batch.clear();
+        while (batch.size() < max_points && !heads.empty()) {
+            auto [ts, idx] = heads.top();
+            heads.pop();
+            
+            // Repeats within one segment resolve to the last copy
+            auto& stream = streams[idx];
+            double value = stream.view.values[stream.pos];
+            bool more;
+            while ((more = step(idx)) && stream.view.timestamps[stream.pos] == ts) {
+                value = stream.view.values[stream.pos];
+            }
+            if (more) {
+                heads.emplace(stream.view.timestamps[stream.pos], idx);
+            }
+            batch.push_back(TimeSeriesPoint{
+                .timestamp = from_ticks(ts),
+                .value = value,
+                .symbol = symbol
+            });
+            
+            // Older segments holding the same timestamp are shadowed
+            while (!heads.empty() && heads.top().first == ts) {
+                auto other = heads.top().second;
+                heads.pop();
+                advance(other);
+            }
+        }
+        return !batch.empty();
+    }
+};
+
+void DiskLayer::Impl::run_compaction(const CompactionJob& job) {
+    metrics::ScopedTimer timer(compaction_latency);
+    std::vector<std::pair<size_t, SegmentInfo>> outputs;
+    std::optional<SegmentWriter> writer;
+    size_t writer_id = 0;
+    
+    // Drops partial output and releases the symbol
+    auto abandon = [&] {
+        std::error_code ec;
+        if (writer) {
+            std::filesystem::remove(writer->file_path(), ec);
+        }
+        for (const auto& [segment_id, info] : outputs) {
+            std::filesystem::remove(info.file_path, ec);
+        }
+        {
+            auto lock = metrics::lock_unique(mutex, lock_wait);
+            state_locked(job.symbol).compacting = false;
         }
+        segments_changed.notify_all();
+    };
+    
+    try {
+        Cursor::Impl cursor;
+        cursor.layer = this;
+        cursor.symbol = job.symbol;
+        cursor.start = std::numeric_limits<int64_t>::min();
+        cursor.end = std::numeric_limits<int64_t>::max();
+        cursor.use_cache = false;
+        for (const auto& [segment_id, info] : job.inputs) {
+            cursor.add_stream(segment_id, info);
+        }
+        cursor.prime();
         
-        // Sort points
-        std::sort(all_points.begin(), all_points.end(),
-                 [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                     return a.timestamp < b.timestamp;
-                 });
+        const size_t max_points = max_segment_points();
+        std::vector<TimeSeriesPoint> batch;
+        while (cursor.next(batch, std::max<size_t>(config.points_per_block, 1))) {
+            if (stopping) {
+                abandon();
+                return;
+            }
+            for (size_t offset = 0; offset < batch.size();) {
+                if (!writer) {
+                    writer_id = job.first_output_id + outputs.size();
+                    writer.emplace(*this, segment_path(job.symbol, writer_id).string());
+                }
+                size_t take = std::min(batch.size() - offset, max_points - writer->num_points());
+                writer->append(batch.data() + offset, take);
+                offset += take;
+                if (writer->num_points() == max_points) {
+                    outputs.emplace_back(writer_id, writer->finish());
+                    writer.reset();
+                }
+            }
+        }
+        if (writer) {
+            outputs.emplace_back(writer_id, writer->finish());
+            writer.reset();
+        }
         
-        // Clear existing segments
-        symbol_it->second.clear();
+        // Swap the segment sets in one manifest append
+        std::vector<uint8_t> records;
+        for (const auto& [segment_id, info] : outputs) {
+            encode_add(records, job.symbol, segment_id, info);
+        }
+        for (const auto& [segment_id, _] : job.inputs) {
+            encode_remove(records, job.symbol, segment_id);
+        }
         
-        // Write new optimized segments
-        const size_t points_per_segment = 10000;
-        size_t current_segment = 0;
+        // Publish, then make it durable. The merged data is the same either
+        // way, so readers that pin the new version before it is durable see
+        // nothing they shouldn't.
+        auto lock = metrics::lock_unique(mutex, lock_wait);
+        auto& state = state_locked(job.symbol);
+        const auto previous = state.pin();
+        update_segments_locked(state, [&](SegmentIndex& segments) {
+            for (const auto& [segment_id, _] : job.inputs) {
+                segments.erase(segment_id);
+            }
+            for (const auto& [segment_id, info] : outputs) {
+                segments.insert(segment_id, info);
+            }
+        });
+        try {
+            append_manifest_locked(records, outputs.size() + job.inputs.size());
+        } catch (...) {
+            // Readers may hold the outputs by now; let them go with the
+            // last of those instead of deleting them here
+            publish_locked(state, previous);
+            for (const auto& [segment_id, info] : outputs) {
+                info.retire();
+            }
+            outputs.clear();
+            throw;
+        }
         
-        for (size_t i = 0; i < all_points.size(); i += points_per_segment) {
-            size_t end_idx = std::min(i + points_per_segment, all_points.size());
-            std::vector<TimeSeriesPoint> segment_points(
-                all_points.begin() + i,
-                all_points.begin() + end_idx
-            );
-            
-            write_segment(symbol, segment_points, current_segment++);
+        // The inputs' files go once no version or reader holds them
+        for (const auto& [segment_id, info] : job.inputs) {
+            info->retire();
         }
+        state.compacting = false;
+        checkpoint_if_due_locked();
+    } catch (...) {
+        abandon();
+        throw;
     }
-};
+    segments_changed.notify_all();
+}
+
+DiskLayer::Cursor::Cursor(std::unique_ptr<Impl> impl) : pimpl_(std::move(impl)) {}
+DiskLayer::Cursor::Cursor(Cursor&&) noexcept = default;
+DiskLayer::Cursor& DiskLayer::Cursor::operator=(Cursor&&) noexcept = default;
+DiskLayer::Cursor::~Cursor() = default;
 
-DiskLayer::DiskLayer(const std::filesystem::path& data_directory, const DiskConfig& config)
-    : pimpl_(std::make_unique<Impl>(data_directory, config)) {}
+bool DiskLayer::Cursor::next(std::vector<TimeSeriesPoint>& batch, size_t max_points) {
+    return pimpl_->next(batch, std::max<size_t>(max_points, 1));
+}
+
+DiskLayer::DiskLayer(const std::filesystem::path& data_directory,
+                     const DiskConfig& config,
+                     std::shared_ptr<SymbolCatalog> catalog)
+    : pimpl_(std::make_unique<Impl>(data_directory, config, std::move(catalog))) {}
 
 DiskLayer::~DiskLayer() = default;
 
+const std::shared_ptr<SymbolCatalog>& DiskLayer::catalog() const {
+    return pimpl_->catalog;
+}
+
 bool DiskLayer::write_batch(const std::vector<TimeSeriesPoint>& points) {
     if (points.empty()) return true;
 
-    // Group points by symbol
-    std::unordered_map<std::string, std::vector<TimeSeriesPoint>> grouped_points;
+    // Order by (symbol id, timestamp), resolving ids once per run of equal
+    // symbols. Stable, so repeats keep their order and the later one wins.
+    std::vector<std::pair<SymbolId, const TimeSeriesPoint*>> order;
+    order.reserve(points.size());
+    const std::string* last_symbol = nullptr;
+    SymbolId last_id = 0;
     for (const auto& point : points) {
-        grouped_points[point.symbol].push_back(point);
+        if (last_symbol == nullptr || point.symbol != *last_symbol) {
+            last_id = pimpl_->catalog->intern(point.symbol);
+            last_symbol = &point.symbol;
+        }
+        order.emplace_back(last_id, &point);
     }
+    std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first || (a.first == b.first && a.second->timestamp < b.second->timestamp);
+    });
 
-    // Write each group to its own segment
-    for (const auto& [symbol, symbol_points] : grouped_points) {
-        std::vector<TimeSeriesPoint> sorted_points = symbol_points;
-        std::sort(sorted_points.begin(), sorted_points.end(),
-                 [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                     return a.timestamp < b.timestamp;
-                 });
-
-        // Get next segment ID
-        std::shared_lock read_lock(pimpl_->mutex);
-        size_t next_segment_id = 0;
-        auto it = pimpl_->metadata.find(symbol);
-        if (it != pimpl_->metadata.end() && !it->second.empty()) {
-            next_segment_id = std::max_element(it->second.begin(), it->second.end(),
-                [](const auto& a, const auto& b) { return a.first < b.first; })->first + 1;
+    // Write each symbol's run to its own segment
+    std::vector<TimeSeriesPoint> sorted_points;
+    for (size_t first = 0; first < order.size();) {
+        size_t last = first;
+        sorted_points.clear();
+        for (; last < order.size() && order[last].first == order[first].first; ++last) {
+            sorted_points.push_back(*order[last].second);
         }
-        read_lock.unlock();
-
-        // Write the segment
-        pimpl_->write_segment(symbol, sorted_points, next_segment_id);
+        pimpl_->write_segment(pimpl_->catalog->name(order[first].first), sorted_points);
+        first = last;
     }
 
     return true;
@@ -353,83 +1945,212 @@ bool DiskLayer::commit_segment(const std::string& symbol) {
     return true;
 }
 
+DiskLayer::Cursor DiskLayer::open_cursor(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end) const {
+    
+    if (auto id = pimpl_->catalog->find(symbol)) {
+        return open_cursor(*id, start, end);
+    }
+    auto cursor = std::make_unique<Cursor::Impl>();
+    cursor->layer = pimpl_.get();
+    cursor->symbol = symbol;
+    return Cursor(std::move(cursor));
+}
+
+DiskLayer::Cursor DiskLayer::open_cursor(
+    SymbolId id,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end) const {
+    
+    auto cursor = std::make_unique<Cursor::Impl>();
+    cursor->layer = pimpl_.get();
+    cursor->symbol = pimpl_->catalog->name(id);
+    cursor->start = to_ticks(start);
+    cursor->end = to_ticks(end);
+    
+    // The streams hold their segments, so the version can go once they exist
+    auto segments = pimpl_->pin(id);
+    auto segment_ids = segments->overlapping(to_ticks(start), to_ticks(end));
+    cursor->streams.reserve(segment_ids.size());
+    for (size_t segment_id : segment_ids) {
+        cursor->add_stream(segment_id, segments->share(segment_id));
+    }
+    
+    cursor->prime();
+    return Cursor(std::move(cursor));
+}
+
 std::vector<TimeSeriesPoint> DiskLayer::read_range(
     const std::string& symbol,
     const std::chrono::system_clock::time_point& start,
     const std::chrono::system_clock::time_point& end) {
     
-    return pimpl_->range_query(symbol, start, end);
+    std::vector<TimeSeriesPoint> results;
+    std::vector<TimeSeriesPoint> batch;
+    auto cursor = open_cursor(symbol, start, end);
+    while (cursor.next(batch)) {
+        results.insert(results.end(),
+                       std::make_move_iterator(batch.begin()),
+                       std::make_move_iterator(batch.end()));
+    }
+    return results;
 }
 
-void DiskLayer::compact_segments(const std::string& symbol) {
-    pimpl_->optimize_segments(symbol);
+std::optional<TimeSeriesPoint> DiskLayer::get_latest(const std::string& symbol) const {
+    auto segments = pimpl_->pin(symbol);
+    if (segments->empty()) {
+        return std::nullopt;
+    }
+    const auto latest = from_ticks(segments->max_end());
+    
+    // Only the final block of the segments ending at `latest` is decoded
+    std::vector<TimeSeriesPoint> batch;
+    auto cursor = open_cursor(symbol, latest, latest);
+    if (!cursor.next(batch, 1)) {
+        return std::nullopt;
+    }
+    return batch.back();
 }
 
-void DiskLayer::optimize_index() {
-    // Get symbols with a quick shared lock
+std::optional<std::chrono::system_clock::time_point> DiskLayer::get_end_time(const std::string& symbol) const {
+    auto segments = pimpl_->pin(symbol);
+    if (segments->empty()) {
+        return std::nullopt;
+    }
+    return from_ticks(segments->max_end());
+}
+
+std::vector<std::string> DiskLayer::get_symbols() const {
     std::vector<std::string> symbols;
-    {
-        std::shared_lock lock(pimpl_->mutex);
-        for (const auto& [symbol, _] : pimpl_->metadata) {
-            symbols.push_back(symbol);
-        }
-    } // Release shared lock
+    pimpl_->for_each_symbol([&](const std::string& symbol, const Impl::SymbolState&, const Impl::SegmentIndex&) {
+        symbols.push_back(symbol);
+    });
+    return symbols;
+}
 
-    // Process each symbol independently
-    for (const auto& symbol : symbols) {
-        try {
-            std::unique_lock lock(pimpl_->mutex);
-            
-            auto symbol_it = pimpl_->metadata.find(symbol);
-            if (symbol_it == pimpl_->metadata.end()) {
-                continue;
-            }
+void DiskLayer::scan_range(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end,
+    const ColumnVisitor& visitor) const {
+    
+    // Decoding runs against the pinned version, so flushes and compactions
+    // proceed meanwhile
+    auto segments = pimpl_->pin(symbol);
+    for (size_t segment_id : segments->overlapping(to_ticks(start), to_ticks(end))) {
+        pimpl_->scan_segment(symbol, segment_id, segments->at(segment_id),
+                             to_ticks(start), to_ticks(end), visitor);
+    }
+}
 
-            // Collect all points with existing lock
-            std::vector<TimeSeriesPoint> all_points;
-            for (const auto& [segment_id, segment_info] : symbol_it->second) {
-                auto points = pimpl_->read_segment(symbol, segment_id);
-                all_points.insert(all_points.end(), points.begin(), points.end());
+RangeStats DiskLayer::aggregate(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end,
+    std::span<const int64_t> shadowed) const {
+    
+    const int64_t lo = to_ticks(start);
+    const int64_t hi = to_ticks(end);
+    
+    // Pin the overlapping segments, oldest first; the version keeps them
+    // alive through the decodes below
+    const auto version = pimpl_->pin(symbol);
+    std::vector<std::pair<size_t, const Impl::SegmentInfo*>> segments;
+    for (size_t segment_id : version->overlapping(lo, hi)) {
+        segments.emplace_back(segment_id, &version->at(segment_id));
+    }
+    
+    auto overlaps_other = [&](size_t self, int64_t from, int64_t to) {
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const auto& info = *segments[i].second;
+            if (i != self && to_ticks(info.start_time) <= to && to_ticks(info.end_time) >= from) {
+                return true;
             }
-
-            if (all_points.empty()) {
-                continue;
+        }
+        return false;
+    };
+    auto is_shadowed = [&](int64_t from, int64_t to) {
+        auto it = std::lower_bound(shadowed.begin(), shadowed.end(), from);
+        return it != shadowed.end() && *it <= to;
+    };
+    
+    // Answer what the statistics can; collect the ranges that need decoding
+    RangeStats stats;
+    std::vector<std::pair<int64_t, int64_t>> decode_ranges;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const auto& info = *segments[i].second;
+        const int64_t seg_lo = to_ticks(info.start_time);
+        const int64_t seg_hi = to_ticks(info.end_time);
+        const bool isolated = !overlaps_other(i, seg_lo, seg_hi);
+        if (isolated && info.stats_complete && seg_lo >= lo && seg_hi <= hi && !is_shadowed(seg_lo, seg_hi)) {
+            stats.merge(info.stats);
+            continue;
+        }
+        
+        auto block_it = std::lower_bound(info.blocks.begin(), info.blocks.end(), lo,
+            [](const BlockIndexEntry& block, int64_t ts) { return block.max_ticks < ts; });
+        for (; block_it != info.blocks.end() && block_it->min_ticks <= hi; ++block_it) {
+            const auto& block = *block_it;
+            if ((block.flags & BLOCK_DISTINCT) && block.min_ticks >= lo && block.max_ticks <= hi &&
+                !is_shadowed(block.min_ticks, block.max_ticks) &&
+                (isolated || !overlaps_other(i, block.min_ticks, block.max_ticks))) {
+                stats.merge(Impl::block_stats(block));
+            } else {
+                decode_ranges.emplace_back(std::max(block.min_ticks, lo), std::min(block.max_ticks, hi));
             }
-
-            // Sort points
-            std::sort(all_points.begin(), all_points.end(),
-                     [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                         return a.timestamp < b.timestamp;
-                     });
-
-            // Remove duplicates
-            auto it = std::unique(all_points.begin(), all_points.end(),
-                             [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                                 return a.timestamp == b.timestamp;
-                             });
-            all_points.erase(it, all_points.end());
-
-            // Remove old segment files
-            for (const auto& [segment_id, segment_info] : symbol_it->second) {
-                std::filesystem::remove(segment_info.file_path);
+        }
+    }
+    
+    // Decoded ranges never touch a block answered from its statistics, but
+    // may overlap each other across segments; merge them before reading
+    std::sort(decode_ranges.begin(), decode_ranges.end());
+    std::vector<std::pair<int64_t, int64_t>> merged;
+    for (const auto& range : decode_ranges) {
+        if (!merged.empty() && range.first <= merged.back().second) {
+            merged.back().second = std::max(merged.back().second, range.second);
+        } else {
+            merged.push_back(range);
+        }
+    }
+    
+    std::vector<TimeSeriesPoint> batch;
+    for (const auto& [from, to] : merged) {
+        Cursor::Impl cursor;
+        cursor.layer = pimpl_.get();
+        cursor.symbol = symbol;
+        cursor.start = from;
+        cursor.end = to;
+        for (const auto& [segment_id, info] : segments) {
+            if (to_ticks(info->start_time) <= to && to_ticks(info->end_time) >= from) {
+                cursor.add_stream(segment_id, version->share(segment_id));
+            }
+        }
+        cursor.prime();
+        while (cursor.next(batch, 4096)) {
+            for (const auto& point : batch) {
+                if (!std::binary_search(shadowed.begin(), shadowed.end(), to_ticks(point.timestamp))) {
+                    stats.add(point.value);
+                }
             }
+        }
+    }
+    return stats;
+}
 
-            // Clear existing segments
-            symbol_it->second.clear();
+void DiskLayer::compact_segments(const std::string& symbol) {
+    pimpl_->compact_symbol(symbol);
+}
 
-            // Write new optimized segments
-            const size_t points_per_segment = 10000;
-            size_t current_segment = 0;
+void DiskLayer::optimize_index() {
+    // Get symbols with a quick shared lock
+    std::vector<std::string> symbols = get_symbols();
 
-            for (size_t i = 0; i < all_points.size(); i += points_per_segment) {
-                size_t end_idx = std::min(i + points_per_segment, all_points.size());
-                std::vector<TimeSeriesPoint> segment_points(
-                    all_points.begin() + i,
-                    all_points.begin() + end_idx
-                );
-                
-                pimpl_->write_segment(symbol, segment_points, current_segment++);
-            }
+    // Process each symbol independently
+    for (const auto& symbol : symbols) {
+        try {
+            pimpl_->compact_symbol(symbol);
         } catch (const std::exception& e) {
             // Log error and continue with next symbol
             fprintf(stderr, "Error optimizing symbol %s: %s\n", symbol.c_str(), e.what());
@@ -438,16 +2159,32 @@ void DiskLayer::optimize_index() {
     }
 }
 
+size_t DiskLayer::get_cache_hits() const {
+    return pimpl_->block_cache.hits();
+}
+
+size_t DiskLayer::get_cache_misses() const {
+    return pimpl_->block_cache.misses();
+}
+
+DiskStats DiskLayer::get_stats() const {
+    return DiskStats{
+        .bytes_read = pimpl_->bytes_read.value(),
+        .bytes_written = pimpl_->bytes_written.value(),
+        .decode = pimpl_->decode_latency.summary(),
+        .compaction = pimpl_->compaction_latency.summary(),
+        .lock_wait = pimpl_->lock_wait.summary()
+    };
+}
+
 size_t DiskLayer::get_storage_size() const {
     size_t total_size = 0;
-    std::shared_lock lock(pimpl_->mutex);
-    
-    for (const auto& [symbol, data] : pimpl_->metadata) {
-        for (const auto& [segment_id, segment] : data) {
+    pimpl_->for_each_symbol([&](const std::string&, const Impl::SymbolState&, const Impl::SegmentIndex& segments) {
+        for (const auto& [segment_id, segment] : segments) {
             std::error_code ec;
-            total_size += std::filesystem::file_size(segment.file_path, ec);
+            total_size += std::filesystem::file_size(segment->file_path, ec);
         }
-    }
+    });
     
     return total_size;
 }
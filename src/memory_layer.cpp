@@ -1,215 +1,862 @@
 #include "findata_engine/memory_layer.hpp"
 #include "findata_engine/utils.hpp"
+#include "findata_engine/symbol_catalog.hpp"
 #include <unordered_map>
 #include <algorithm>
+#include <array>
 #include <mutex>
 #include <shared_mutex>
+#include <atomic>
+#include <utility>
 
 namespace findata_engine {
 
+namespace {
+
+int64_t to_ticks(std::chrono::system_clock::time_point tp) {
+    return tp.time_since_epoch().count();
+}
+
+std::chrono::system_clock::time_point from_ticks(int64_t ticks) {
+    return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(ticks));
+}
+
+// Active point counts are striped by symbol id so writers on different
+// symbols don't contend on a single counter
+constexpr size_t NUM_STRIPES = 64;
+
+// Late points are buffered per symbol and merged once this many accumulate
+constexpr size_t MAX_PENDING_POINTS = 1024;
+
+// Memtable columns grow in fixed-size chunks rather than by vector
+// reallocation, so growth never copies a column or briefly doubles it
+constexpr size_t CHUNK_POINTS = 512;
+
+struct Chunk {
+    int64_t timestamps[CHUNK_POINTS];
+    double values[CHUNK_POINTS];
+};
+
+// Recycles the chunks of flushed columns. Each stripe owns one, so writers
+// on different stripes never share a free list.
+class ChunkPool {
+public:
+    void set_max_idle(size_t max_idle) { max_idle_ = max_idle; }
+
+    std::unique_ptr<Chunk> acquire() {
+        {
+            std::lock_guard lock(mutex_);
+            if (!idle_.empty()) {
+                auto chunk = std::move(idle_.back());
+                idle_.pop_back();
+                return chunk;
+            }
+        }
+        return std::unique_ptr<Chunk>(new Chunk); // Left uninitialized
+    }
+
+    void release(std::unique_ptr<Chunk> chunk) {
+        std::lock_guard lock(mutex_);
+        if (idle_.size() < max_idle_) {
+            idle_.push_back(std::move(chunk));
+        }
+    }
+
+    size_t idle_bytes() const {
+        std::lock_guard lock(mutex_);
+        return idle_.size() * sizeof(Chunk);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Chunk>> idle_;
+    size_t max_idle_ = 0;
+};
+
+// Parallel timestamp/value arrays sorted by timestamp, stored as a list of
+// pool chunks. All chunks but the last are full.
+class Columns {
+public:
+    explicit Columns(ChunkPool& pool) : pool_(&pool) {}
+    Columns(Columns&& other) noexcept
+        : pool_(other.pool_), chunks_(std::move(other.chunks_)), size_(std::exchange(other.size_, 0)) {
+        other.chunks_.clear();
+    }
+    Columns& operator=(Columns&& other) noexcept {
+        if (this != &other) {
+            reset();
+            pool_ = other.pool_;
+            chunks_ = std::move(other.chunks_);
+            other.chunks_.clear();
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+    ~Columns() { reset(); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t bytes() const {
+        return chunks_.size() * sizeof(Chunk) + chunks_.capacity() * sizeof(chunks_[0]);
+    }
+
+    int64_t timestamp(size_t i) const { return chunks_[i / CHUNK_POINTS]->timestamps[i % CHUNK_POINTS]; }
+    double value(size_t i) const { return chunks_[i / CHUNK_POINTS]->values[i % CHUNK_POINTS]; }
+    int64_t back_timestamp() const { return timestamp(size_ - 1); }
+
+    void push_back(int64_t ts, double value) {
+        if (size_ == chunks_.size() * CHUNK_POINTS) {
+            chunks_.push_back(pool_->acquire());
+        }
+        Chunk& chunk = *chunks_.back();
+        chunk.timestamps[size_ % CHUNK_POINTS] = ts;
+        chunk.values[size_ % CHUNK_POINTS] = value;
+        ++size_;
+    }
+
+    // Drops points from index n on, handing emptied chunks back to the pool
+    void truncate(size_t n) {
+        if (n >= size_) return;
+        size_ = n;
+        const size_t keep = (n + CHUNK_POINTS - 1) / CHUNK_POINTS;
+        while (chunks_.size() > keep) {
+            pool_->release(std::move(chunks_.back()));
+            chunks_.pop_back();
+        }
+    }
+
+    // Returns every chunk to the pool
+    void reset() {
+        truncate(0);
+        chunks_.shrink_to_fit();
+    }
+
+    bool contains(int64_t ts) const {
+        if (empty() || ts > back_timestamp()) return false;
+        const size_t i = lower_bound(ts);
+        return i < size_ && timestamp(i) == ts;
+    }
+
+    // First index whose timestamp is >= ts (lower) or > ts (upper)
+    size_t lower_bound(int64_t ts) const {
+        return search(ts, [](int64_t a, int64_t b) { return a < b; });
+    }
+    size_t upper_bound(int64_t ts) const {
+        return search(ts, [](int64_t a, int64_t b) { return a <= b; });
+    }
+
+    // Index range [first, last) of timestamps within [start, end]
+    std::pair<size_t, size_t> find_range(int64_t start, int64_t end) const {
+        const size_t first = lower_bound(start);
+        return {first, std::max(first, upper_bound(end))};
+    }
+
+    // Calls fn(timestamps, values) once per chunk-contiguous piece of [first, last)
+    template<typename Fn>
+    void for_each_run(size_t first, size_t last, Fn&& fn) const {
+        while (first < last) {
+            const Chunk& chunk = *chunks_[first / CHUNK_POINTS];
+            const size_t offset = first % CHUNK_POINTS;
+            const size_t count = std::min(CHUNK_POINTS - offset, last - first);
+            fn(std::span<const int64_t>(chunk.timestamps + offset, count),
+               std::span<const double>(chunk.values + offset, count));
+            first += count;
+        }
+    }
+
+private:
+    size_t chunk_size(size_t c) const {
+        return c + 1 < chunks_.size() ? CHUNK_POINTS : size_ - c * CHUNK_POINTS;
+    }
+
+    // Binary search over chunk tails, then within the chosen chunk
+    template<typename Before>
+    size_t search(int64_t ts, Before before) const {
+        size_t lo = 0;
+        size_t hi = chunks_.size();
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (before(chunks_[mid]->timestamps[chunk_size(mid) - 1], ts)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == chunks_.size()) return size_;
+        const int64_t* begin = chunks_[lo]->timestamps;
+        const int64_t* end = begin + chunk_size(lo);
+        const int64_t* it = std::partition_point(begin, end, [&](int64_t t) { return before(t, ts); });
+        return lo * CHUNK_POINTS + static_cast<size_t>(it - begin);
+    }
+
+    ChunkPool* pool_;
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+};
+
+} // namespace
+
 struct MemoryLayer::Impl {
+    // Column-oriented storage: the symbol is kept once. `active` takes new
+    // writes; `frozen` is an immutable snapshot being drained to disk by a
+    // flush and stays readable until the flush commits.
     struct SymbolData {
-        std::vector<TimeSeriesPoint> points;
+        SymbolId id;
+        std::string symbol;
+        Columns active;
+        Columns frozen;
+        // Bounded, sorted buffer of points older than the active tail
+        std::vector<std::pair<int64_t, double>> pending;
         std::shared_mutex mutex;
-        size_t total_points = 0;
-        
-        explicit SymbolData() = default;
+        size_t total_points = 0;   // active plus pending
+        size_t accounted_bytes = 0; // footprint() as last added to the stripe
+        // Epoch and time of the first write since the last freeze, the
+        // epoch the frozen snapshot was written in, and the one it was
+        // frozen in
+        uint64_t active_epoch = 0;
+        uint64_t frozen_epoch = 0;
+        uint64_t frozen_at = 0;
+        std::chrono::steady_clock::time_point active_since;
+
+        SymbolData(SymbolId symbol_id, std::string sym, ChunkPool& pool)
+            : id(symbol_id), symbol(std::move(sym)), active(pool), frozen(pool) {}
+
+        bool has_active() const { return !active.empty() || !pending.empty(); }
+
+        // Stamps the first write after a freeze. Caller holds the exclusive lock.
+        void note_write(uint64_t epoch) {
+            if (!has_active()) {
+                active_epoch = epoch;
+                active_since = std::chrono::steady_clock::now();
+            }
+        }
+
+        // Heap bytes held by the columns, plus the entry itself
+        size_t footprint() const {
+            return entry_bytes() + active.bytes() + frozen.bytes() + pending.capacity() * sizeof(pending[0]);
+        }
+
+        // The part of the footprint kept for as long as the symbol exists
+        size_t entry_bytes() const {
+            return sizeof(SymbolData) + symbol.capacity();
+        }
+
+        size_t active_bytes() const {
+            return active.bytes() + pending.capacity() * sizeof(pending[0]);
+        }
+
+        // Returns false if the timestamp is already present. Caller holds the
+        // exclusive lock.
+        bool append(int64_t ts, double value) {
+            if (frozen.contains(ts)) {
+                return false;
+            }
+
+            // Fast path: in-order points go straight onto the tail
+            if (active.empty() || ts > active.back_timestamp()) {
+                active.push_back(ts, value);
+                return true;
+            }
+
+            if (active.contains(ts)) {
+                return false;
+            }
+
+            auto it = std::lower_bound(pending.begin(), pending.end(), ts,
+                [](const auto& p, int64_t t) { return p.first < t; });
+            if (it != pending.end() && it->first == ts) {
+                return false;
+            }
+            pending.insert(it, {ts, value});
+
+            if (pending.size() >= MAX_PENDING_POINTS) {
+                merge_pending();
+            }
+            return true;
+        }
+
+        // Merges `count` sorted incoming points into the active columns.
+        // Only the suffix from the first incoming timestamp on is set aside
+        // and rewritten; existing points win ties, as does the first of
+        // several incoming copies, and incoming points rejected by keep(j)
+        // are dropped. added(j) is called for each incoming point stored.
+        // Returns the number of points added.
+        template<typename TsAt, typename ValueAt, typename Keep, typename Added>
+        size_t merge_sorted(size_t count, TsAt ts_at, ValueAt value_at, Keep keep, Added added) {
+            if (count == 0) return 0;
+
+            // Per-thread scratch for the overlapped suffix, reused across merges
+            thread_local std::vector<int64_t> tail_ts;
+            thread_local std::vector<double> tail_values;
+            const size_t old_size = active.size();
+            const size_t split = active.lower_bound(ts_at(0));
+            tail_ts.clear();
+            tail_values.clear();
+            for (size_t i = split; i < old_size; ++i) {
+                tail_ts.push_back(active.timestamp(i));
+                tail_values.push_back(active.value(i));
+            }
+            active.truncate(split);
+
+            auto push = [&](int64_t t, double v) {
+                if (!active.empty() && active.back_timestamp() == t) return false;
+                active.push_back(t, v);
+                return true;
+            };
+            auto push_new = [&](size_t j) {
+                if (keep(j) && push(ts_at(j), value_at(j))) added(j);
+            };
+
+            size_t i = 0, j = 0;
+            while (i < tail_ts.size() && j < count) {
+                if (ts_at(j) < tail_ts[i]) {
+                    push_new(j++);
+                } else {
+                    push(tail_ts[i], tail_values[i]);
+                    ++i;
+                }
+            }
+            for (; i < tail_ts.size(); ++i) push(tail_ts[i], tail_values[i]);
+            for (; j < count; ++j) push_new(j);
+            return active.size() - old_size;
+        }
+
+        // Folds the out-of-order buffer into the active columns. Caller
+        // holds the exclusive lock.
+        void merge_pending() {
+            if (pending.empty()) return;
+            merge_sorted(pending.size(),
+                         [&](size_t j) { return pending[j].first; },
+                         [&](size_t j) { return pending[j].second; },
+                         [](size_t) { return true; },
+                         [](size_t) {});
+            pending.clear();
+        }
+
+        // Adds a run sorted by timestamp. Existing points win on duplicate
+        // timestamps, as does the first of several in the run; points held by
+        // an in-flight flush are dropped. Only the active suffix the run
+        // overlaps is rewritten, so in-order runs cost O(run). added(j) is
+        // called for each point of the run stored. Returns the number of
+        // points added. Caller holds the exclusive lock.
+        template<typename Added>
+        size_t append_sorted(std::span<const int64_t> ts, std::span<const double> vals, Added added) {
+            merge_pending();
+            return merge_sorted(ts.size(),
+                                [&](size_t j) { return ts[j]; },
+                                [&](size_t j) { return vals[j]; },
+                                [&](size_t j) { return frozen.empty() || !frozen.contains(ts[j]); },
+                                added);
+        }
+
+        TimeSeriesPoint point_at(const Columns& columns, size_t i) const {
+            return TimeSeriesPoint{
+                .timestamp = from_ticks(columns.timestamp(i)),
+                .value = columns.value(i),
+                .symbol = symbol
+            };
+        }
     };
-    
-    std::unordered_map<std::string, std::unique_ptr<SymbolData>> symbol_data;
+
+    struct alignas(64) Stripe {
+        std::atomic<size_t> total_points{0};
+        std::atomic<size_t> bytes{0};
+        std::atomic<size_t> entry_bytes{0}; // Share of bytes no freeze releases
+        ChunkPool pool;
+    };
+
+    std::shared_ptr<SymbolCatalog> catalog;
+    // Stripes own the chunk pools, so they are declared before (and outlive)
+    // the symbol entries whose columns return chunks to them
+    std::array<Stripe, NUM_STRIPES> stripes;
+    SymbolTable<SymbolData> symbol_data; // indexed by SymbolId
+    std::atomic<size_t> frozen_points{0};
+    std::atomic<uint64_t> epoch{0};
     size_t cache_size_mb;
-    mutable std::shared_mutex global_mutex;
-    std::atomic<size_t> total_points_{0};
-    
-    explicit Impl(size_t cache_size_mb) : cache_size_mb(cache_size_mb) {}
-    
-    SymbolData* get_or_create_symbol_data(const std::string& symbol) {
-        std::shared_lock read_lock(global_mutex);
-        auto it = symbol_data.find(symbol);
-        if (it != symbol_data.end()) {
-            return it->second.get();
-        }
-        
-        read_lock.unlock();
-        std::unique_lock write_lock(global_mutex);
-        
-        // Check again in case another thread created it
-        it = symbol_data.find(symbol);
-        if (it != symbol_data.end()) {
-            return it->second.get();
-        }
-        
-        auto [new_it, _] = symbol_data.emplace(
-            symbol,
-            std::make_unique<SymbolData>());
-        return new_it->second.get();
+    mutable metrics::Histogram lock_wait;
+
+    Impl(size_t cache_size_mb, std::shared_ptr<SymbolCatalog> symbols)
+        : catalog(symbols ? std::move(symbols) : std::make_shared<SymbolCatalog>()),
+          cache_size_mb(cache_size_mb) {
+        // Idle chunks sit outside memory_usage(), so together they are
+        // capped at a quarter of the budget
+        const size_t idle_chunks = cache_size_mb * 1024 * 1024 / 4 / sizeof(Chunk) / NUM_STRIPES;
+        for (auto& stripe : stripes) {
+            stripe.pool.set_max_idle(std::max<size_t>(idle_chunks, 1));
+        }
+    }
+
+    // Shared lock on a symbol whose out-of-order buffer has been merged
+    std::shared_lock<std::shared_mutex> lock_merged(SymbolData& data) {
+        auto read_lock = metrics::lock_shared(data.mutex, lock_wait);
+        if (!data.pending.empty()) {
+            read_lock.unlock();
+            {
+                auto write_lock = metrics::lock_unique(data.mutex, lock_wait);
+                data.merge_pending();
+                account(data);
+            }
+            read_lock.lock();
+        }
+        return read_lock;
+    }
+
+    Stripe& stripe_for(SymbolId id) {
+        return stripes[id % NUM_STRIPES];
+    }
+
+    // Brings the stripe's byte count in line with a symbol's footprint after
+    // a change. Caller holds the symbol's exclusive lock.
+    void account(SymbolData& data) {
+        const size_t bytes = data.footprint();
+        auto& stripe = stripe_for(data.id);
+        if (bytes >= data.accounted_bytes) {
+            stripe.bytes.fetch_add(bytes - data.accounted_bytes, std::memory_order_relaxed);
+        } else {
+            stripe.bytes.fetch_sub(data.accounted_bytes - bytes, std::memory_order_relaxed);
+        }
+        if (data.accounted_bytes == 0) {
+            stripe.entry_bytes.fetch_add(data.entry_bytes(), std::memory_order_relaxed);
+        }
+        data.accounted_bytes = bytes;
+    }
+
+    // Moves a symbol's active points into its frozen snapshot. A symbol whose
+    // previous snapshot wasn't released keeps it; its new writes stay active
+    // until the next freeze. Returns the points frozen.
+    size_t freeze_symbol(SymbolData& data) {
+        auto symbol_lock = metrics::lock_unique(data.mutex, lock_wait);
+        if (!data.frozen.empty()) return 0;
+
+        data.merge_pending();
+        const size_t count = data.active.size();
+        if (count == 0) return 0;
+
+        data.frozen = std::move(data.active); // Leaves active empty
+        data.pending.shrink_to_fit();          // Merged above; only its capacity is left
+        data.frozen_epoch = data.active_epoch;
+        data.frozen_at = epoch.load(std::memory_order_acquire);
+        data.total_points -= count;
+        stripe_for(data.id).total_points.fetch_sub(count, std::memory_order_relaxed);
+        account(data);
+        return count;
+    }
+
+    // Symbol entries are never freed, so the returned pointer stays valid
+    SymbolData* find_symbol_data(const std::string& symbol) const {
+        auto id = catalog->find(symbol);
+        return id ? symbol_data.find(*id) : nullptr;
+    }
+
+    SymbolData& get_or_create_symbol_data(SymbolId id) {
+        return symbol_data.get_or_create(id, id, catalog->name(id), stripe_for(id).pool);
+    }
+
+    // Visits every symbol that has data, in id order
+    template<typename Fn>
+    void for_each_symbol(Fn&& fn) const {
+        const SymbolId count = catalog->size();
+        for (SymbolId id = 0; id < count; ++id) {
+            if (auto* data = symbol_data.find(id)) {
+                fn(id, *data);
+            }
+        }
+    }
+
+    // Points in the active memtable, i.e. not yet handed to a flush
+    size_t active_points() const {
+        size_t total = 0;
+        for (const auto& stripe : stripes) {
+            total += stripe.total_points.load(std::memory_order_relaxed);
+        }
+        return total;
     }
 };
 
-MemoryLayer::MemoryLayer(size_t cache_size_mb)
-    : pimpl_(std::make_unique<Impl>(cache_size_mb)) {}
+MemoryLayer::MemoryLayer(size_t cache_size_mb, std::shared_ptr<SymbolCatalog> catalog)
+    : pimpl_(std::make_unique<Impl>(cache_size_mb, std::move(catalog))) {}
 
 MemoryLayer::~MemoryLayer() = default;
 
 bool MemoryLayer::insert(const TimeSeriesPoint& point) {
-    auto* symbol_data = pimpl_->get_or_create_symbol_data(point.symbol);
-    
-    std::unique_lock lock(symbol_data->mutex);
-    
-    // Insert into sorted position
-    auto it = std::lower_bound(
-        symbol_data->points.begin(),
-        symbol_data->points.end(),
-        point,
-        [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-            return a.timestamp < b.timestamp;
-        });
-    
+    return insert(pimpl_->catalog->intern(point.symbol), point.timestamp, point.value);
+}
+
+bool MemoryLayer::insert(SymbolId id, std::chrono::system_clock::time_point timestamp, double value) {
+    auto& symbol_data = pimpl_->get_or_create_symbol_data(id);
+
+    auto lock = metrics::lock_unique(symbol_data.mutex, pimpl_->lock_wait);
+    symbol_data.note_write(pimpl_->epoch.load(std::memory_order_acquire));
+
     // Don't allow duplicates
-    if (it != symbol_data->points.end() && it->timestamp == point.timestamp) {
+    if (!symbol_data.append(to_ticks(timestamp), value)) {
         return false;
     }
-    
-    symbol_data->points.insert(it, point);
-    symbol_data->total_points++;
-    pimpl_->total_points_++;
+
+    symbol_data.total_points++;
+    pimpl_->stripe_for(id).total_points.fetch_add(1, std::memory_order_relaxed);
+    pimpl_->account(symbol_data);
     return true;
 }
 
-bool MemoryLayer::insert_batch(const std::vector<TimeSeriesPoint>& points) {
+bool MemoryLayer::insert_batch(const std::vector<TimeSeriesPoint>& points, std::vector<uint8_t>* accepted) {
+    if (accepted) accepted->assign(points.size(), 0);
     if (points.empty()) return true;
-    
-    // Group points by symbol
-    std::unordered_map<std::string, std::vector<TimeSeriesPoint>> grouped_points;
+
+    // Resolve ids once per run of equal symbols, then order rows by
+    // (id, timestamp); stable so the first of equal timestamps wins
+    struct Row {
+        SymbolId id;
+        int64_t ts;
+        double value;
+        size_t index; // position in `points`
+    };
+    std::vector<Row> rows;
+    rows.reserve(points.size());
+    const std::string* last_symbol = nullptr;
+    SymbolId last_id = 0;
     for (const auto& point : points) {
-        grouped_points[point.symbol].push_back(point);
-    }
-    
-    // Insert each group
-    bool success = true;
-    for (const auto& [symbol, symbol_points] : grouped_points) {
-        auto* symbol_data = pimpl_->get_or_create_symbol_data(symbol);
-        std::unique_lock lock(symbol_data->mutex);
-        
-        // Pre-allocate space
-        symbol_data->points.reserve(symbol_data->points.size() + symbol_points.size());
-        
-        // Sort new points
-        auto sorted_points = symbol_points;
-        std::sort(sorted_points.begin(), sorted_points.end(),
-                 [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                     return a.timestamp < b.timestamp;
-                 });
-        
-        // Merge with existing points
-        std::vector<TimeSeriesPoint> merged;
-        merged.reserve(symbol_data->points.size() + sorted_points.size());
-        
-        std::merge(
-            symbol_data->points.begin(), symbol_data->points.end(),
-            sorted_points.begin(), sorted_points.end(),
-            std::back_inserter(merged),
-            [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                return a.timestamp < b.timestamp;
-            });
-        
-        // Remove duplicates
-        auto unique_end = std::unique(
-            merged.begin(), merged.end(),
-            [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                return a.timestamp == b.timestamp;
+        if (last_symbol == nullptr || point.symbol != *last_symbol) {
+            last_id = pimpl_->catalog->intern(point.symbol);
+            last_symbol = &point.symbol;
+        }
+        rows.push_back(Row{last_id, to_ticks(point.timestamp), point.value, rows.size()});
+    }
+    auto row_order = [](const Row& a, const Row& b) {
+        return a.id < b.id || (a.id == b.id && a.ts < b.ts);
+    };
+    if (!std::is_sorted(rows.begin(), rows.end(), row_order)) {
+        std::stable_sort(rows.begin(), rows.end(), row_order);
+    }
+
+    // Insert each symbol's run
+    std::vector<int64_t> run_ts;
+    std::vector<double> run_values;
+    for (size_t first = 0; first < rows.size();) {
+        const SymbolId id = rows[first].id;
+        run_ts.clear();
+        run_values.clear();
+        size_t last = first;
+        for (; last < rows.size() && rows[last].id == id; ++last) {
+            run_ts.push_back(rows[last].ts);
+            run_values.push_back(rows[last].value);
+        }
+
+        auto& symbol_data = pimpl_->get_or_create_symbol_data(id);
+        size_t new_points;
+        {
+            auto lock = metrics::lock_unique(symbol_data.mutex, pimpl_->lock_wait);
+            symbol_data.note_write(pimpl_->epoch.load(std::memory_order_acquire));
+            new_points = symbol_data.append_sorted(run_ts, run_values, [&](size_t j) {
+                if (accepted) (*accepted)[rows[first + j].index] = 1;
             });
-        
-        merged.erase(unique_end, merged.end());
-        
-        // Update points
-        size_t new_points = merged.size() - symbol_data->points.size();
-        symbol_data->points = std::move(merged);
-        symbol_data->total_points += new_points;
-        pimpl_->total_points_ += new_points;
+            symbol_data.total_points += new_points;
+            pimpl_->account(symbol_data);
+        }
+        pimpl_->stripe_for(id).total_points.fetch_add(new_points, std::memory_order_relaxed);
+        first = last;
+    }
+
+    return true;
+}
+
+bool MemoryLayer::insert_columns(SymbolId id, std::span<const int64_t> timestamps, std::span<const double> values,
+                                 std::vector<uint8_t>* accepted) {
+    if (timestamps.size() != values.size()) return false;
+    if (accepted) accepted->assign(timestamps.size(), 0);
+    if (timestamps.empty()) return true;
+
+    // Unsorted input is ordered through a stable permutation so the first
+    // of equal timestamps still wins; sorted input is used in place
+    std::vector<int64_t> sorted_ts;
+    std::vector<double> sorted_values;
+    std::vector<uint32_t> order;
+    if (!std::is_sorted(timestamps.begin(), timestamps.end())) {
+        order.resize(timestamps.size());
+        for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&](uint32_t a, uint32_t b) { return timestamps[a] < timestamps[b]; });
+        sorted_ts.reserve(order.size());
+        sorted_values.reserve(order.size());
+        for (uint32_t i : order) {
+            sorted_ts.push_back(timestamps[i]);
+            sorted_values.push_back(values[i]);
+        }
+        timestamps = sorted_ts;
+        values = sorted_values;
+    }
+
+    auto& symbol_data = pimpl_->get_or_create_symbol_data(id);
+    size_t new_points;
+    {
+        auto lock = metrics::lock_unique(symbol_data.mutex, pimpl_->lock_wait);
+        symbol_data.note_write(pimpl_->epoch.load(std::memory_order_acquire));
+        new_points = symbol_data.append_sorted(timestamps, values, [&](size_t j) {
+            if (accepted) (*accepted)[order.empty() ? j : order[j]] = 1;
+        });
+        symbol_data.total_points += new_points;
+        pimpl_->account(symbol_data);
     }
-    
-    return success;
+    pimpl_->stripe_for(id).total_points.fetch_add(new_points, std::memory_order_relaxed);
+    return true;
 }
 
 std::optional<TimeSeriesPoint> MemoryLayer::get_latest(const std::string& symbol) const {
-    std::shared_lock global_lock(pimpl_->global_mutex);
-    auto it = pimpl_->symbol_data.find(symbol);
-    if (it == pimpl_->symbol_data.end()) {
+    auto id = pimpl_->catalog->find(symbol);
+    return id ? get_latest(*id) : std::nullopt;
+}
+
+std::optional<TimeSeriesPoint> MemoryLayer::get_latest(SymbolId id) const {
+    auto* symbol_data = pimpl_->symbol_data.find(id);
+    if (symbol_data == nullptr) {
         return std::nullopt;
     }
-    
-    std::shared_lock symbol_lock(it->second->mutex);
-    if (it->second->points.empty()) {
+
+    // Buffered late points are always older than the active tail, so no
+    // merge is needed
+    auto symbol_lock = metrics::lock_shared(symbol_data->mutex, pimpl_->lock_wait);
+    const auto& active = symbol_data->active;
+    const auto& frozen = symbol_data->frozen;
+    if (active.empty() && frozen.empty()) {
         return std::nullopt;
     }
-    
-    return it->second->points.back();
+    if (frozen.empty() ||
+        (!active.empty() && active.back_timestamp() > frozen.back_timestamp())) {
+        return symbol_data->point_at(active, active.size() - 1);
+    }
+    return symbol_data->point_at(frozen, frozen.size() - 1);
 }
 
 std::vector<TimeSeriesPoint> MemoryLayer::get_range(
     const std::string& symbol,
     std::chrono::system_clock::time_point start,
     std::chrono::system_clock::time_point end) const {
-    
-    std::shared_lock global_lock(pimpl_->global_mutex);
-    auto it = pimpl_->symbol_data.find(symbol);
-    if (it == pimpl_->symbol_data.end()) {
+
+    auto id = pimpl_->catalog->find(symbol);
+    return id ? get_range(*id, start, end) : std::vector<TimeSeriesPoint>{};
+}
+
+std::vector<TimeSeriesPoint> MemoryLayer::get_range(
+    SymbolId id,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end) const {
+
+    auto* symbol_data = pimpl_->symbol_data.find(id);
+    if (symbol_data == nullptr) {
         return {};
     }
-    
-    std::shared_lock symbol_lock(it->second->mutex);
-    const auto& points = it->second->points;
-    
-    // Find range using binary search
-    auto start_it = std::lower_bound(
-        points.begin(), points.end(),
-        TimeSeriesPoint{.symbol = symbol, .timestamp = start, .value = 0.0},
-        [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-            return a.timestamp < b.timestamp;
-        });
-        
-    auto end_it = std::upper_bound(
-        start_it, points.end(),
-        TimeSeriesPoint{.symbol = symbol, .timestamp = end, .value = 0.0},
-        [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-            return a.timestamp < b.timestamp;
-        });
-    
-    return {start_it, end_it};
+
+    auto symbol_lock = pimpl_->lock_merged(*symbol_data);
+    const auto& data = *symbol_data;
+
+    // Find range using binary search over both timestamp columns
+    auto [a_first, a_last] = data.active.find_range(to_ticks(start), to_ticks(end));
+    auto [f_first, f_last] = data.frozen.find_range(to_ticks(start), to_ticks(end));
+
+    std::vector<TimeSeriesPoint> result;
+    result.reserve((a_last - a_first) + (f_last - f_first));
+
+    // The two memtables never share a timestamp, so a plain merge suffices
+    while (a_first < a_last && f_first < f_last) {
+        if (data.active.timestamp(a_first) < data.frozen.timestamp(f_first)) {
+            result.push_back(data.point_at(data.active, a_first++));
+        } else {
+            result.push_back(data.point_at(data.frozen, f_first++));
+        }
+    }
+    for (; a_first < a_last; ++a_first) result.push_back(data.point_at(data.active, a_first));
+    for (; f_first < f_last; ++f_first) result.push_back(data.point_at(data.frozen, f_first));
+    return result;
 }
 
-void MemoryLayer::clear_cache() {
-    std::unique_lock lock(pimpl_->global_mutex);
-    for (auto& [_, symbol_data] : pimpl_->symbol_data) {
-        std::unique_lock symbol_lock(symbol_data->mutex);
-        symbol_data->points.clear();
-        symbol_data->total_points = 0;
+void MemoryLayer::scan_range(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end,
+    const ColumnVisitor& visitor) const {
+
+    auto* symbol_data = pimpl_->find_symbol_data(symbol);
+    if (symbol_data == nullptr) {
+        return;
     }
-    pimpl_->total_points_ = 0;
+
+    auto symbol_lock = pimpl_->lock_merged(*symbol_data);
+    for (const auto* columns : {&symbol_data->frozen, &symbol_data->active}) {
+        auto [first, last] = columns->find_range(to_ticks(start), to_ticks(end));
+        columns->for_each_run(first, last, visitor);
+    }
+}
+
+size_t MemoryLayer::freeze() {
+    size_t frozen = 0;
+    pimpl_->for_each_symbol([&](SymbolId, Impl::SymbolData& symbol_data) {
+        frozen += pimpl_->freeze_symbol(symbol_data);
+    });
+    pimpl_->frozen_points.fetch_add(frozen, std::memory_order_relaxed);
+    return frozen;
+}
+
+size_t MemoryLayer::freeze(std::span<const SymbolId> ids) {
+    size_t frozen = 0;
+    for (SymbolId id : ids) {
+        if (auto* symbol_data = pimpl_->symbol_data.find(id)) {
+            frozen += pimpl_->freeze_symbol(*symbol_data);
+        }
+    }
+    pimpl_->frozen_points.fetch_add(frozen, std::memory_order_relaxed);
+    return frozen;
+}
+
+std::vector<TimeSeriesPoint> MemoryLayer::get_frozen(const std::string& symbol) const {
+    auto* symbol_data = pimpl_->find_symbol_data(symbol);
+    if (symbol_data == nullptr) {
+        return {};
+    }
+
+    auto symbol_lock = metrics::lock_shared(symbol_data->mutex, pimpl_->lock_wait);
+    const auto& frozen = symbol_data->frozen;
+    std::vector<TimeSeriesPoint> result;
+    result.reserve(frozen.size());
+    for (size_t i = 0; i < frozen.size(); ++i) {
+        result.push_back(symbol_data->point_at(frozen, i));
+    }
+    return result;
+}
+
+void MemoryLayer::release_frozen(const std::string& symbol) {
+    auto* symbol_data = pimpl_->find_symbol_data(symbol);
+    if (symbol_data == nullptr) {
+        return;
+    }
+
+    auto symbol_lock = metrics::lock_unique(symbol_data->mutex, pimpl_->lock_wait);
+    pimpl_->frozen_points.fetch_sub(symbol_data->frozen.size(), std::memory_order_relaxed);
+    symbol_data->frozen.reset();
+    pimpl_->account(*symbol_data);
+}
+
+std::optional<uint64_t> MemoryLayer::frozen_at(const std::string& symbol) const {
+    auto* symbol_data = pimpl_->find_symbol_data(symbol);
+    if (symbol_data == nullptr) {
+        return std::nullopt;
+    }
+
+    auto symbol_lock = metrics::lock_shared(symbol_data->mutex, pimpl_->lock_wait);
+    if (symbol_data->frozen.empty()) {
+        return std::nullopt;
+    }
+    return symbol_data->frozen_at;
+}
+
+std::vector<std::string> MemoryLayer::get_frozen_symbols() const {
+    std::vector<std::string> symbols;
+    pimpl_->for_each_symbol([&](SymbolId, Impl::SymbolData& symbol_data) {
+        auto symbol_lock = metrics::lock_shared(symbol_data.mutex, pimpl_->lock_wait);
+        if (!symbol_data.frozen.empty()) {
+            symbols.push_back(symbol_data.symbol);
+        }
+    });
+    return symbols;
+}
+
+void MemoryLayer::clear_cache() {
+    pimpl_->for_each_symbol([&](SymbolId id, Impl::SymbolData& symbol_data) {
+        auto symbol_lock = metrics::lock_unique(symbol_data.mutex, pimpl_->lock_wait);
+        pimpl_->stripe_for(id).total_points.fetch_sub(symbol_data.total_points, std::memory_order_relaxed);
+        pimpl_->frozen_points.fetch_sub(symbol_data.frozen.size(), std::memory_order_relaxed);
+        symbol_data.active.reset();
+        symbol_data.frozen.reset();
+        symbol_data.pending = {};
+        symbol_data.total_points = 0;
+        pimpl_->account(symbol_data);
+    });
 }
 
 size_t MemoryLayer::cache_size() const {
-    return pimpl_->total_points_.load();
+    return pimpl_->active_points();
+}
+
+size_t MemoryLayer::memory_usage() const {
+    size_t total = 0;
+    for (const auto& stripe : pimpl_->stripes) {
+        total += stripe.bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t MemoryLayer::releasable_usage() const {
+    size_t total = 0;
+    for (const auto& stripe : pimpl_->stripes) {
+        // Read separately, so a symbol being added can briefly show up in
+        // entry_bytes only
+        const size_t bytes = stripe.bytes.load(std::memory_order_relaxed);
+        const size_t entries = stripe.entry_bytes.load(std::memory_order_relaxed);
+        total += bytes - std::min(bytes, entries);
+    }
+    return total;
+}
+
+size_t MemoryLayer::pooled_bytes() const {
+    size_t total = 0;
+    for (const auto& stripe : pimpl_->stripes) {
+        total += stripe.pool.idle_bytes();
+    }
+    return total;
+}
+
+size_t MemoryLayer::memory_budget() const {
+    return pimpl_->cache_size_mb * 1024 * 1024;
+}
+
+std::vector<MemoryLayer::SymbolUsage> MemoryLayer::active_usage() const {
+    std::vector<SymbolUsage> usage;
+    pimpl_->for_each_symbol([&](SymbolId id, Impl::SymbolData& symbol_data) {
+        auto symbol_lock = metrics::lock_shared(symbol_data.mutex, pimpl_->lock_wait);
+        if (!symbol_data.has_active()) return;
+        usage.push_back(SymbolUsage{
+            .id = id,
+            .bytes = symbol_data.active_bytes(),
+            .points = symbol_data.total_points,
+            .active_since = symbol_data.active_since
+        });
+    });
+    return usage;
+}
+
+void MemoryLayer::set_epoch(uint64_t epoch) {
+    pimpl_->epoch.store(epoch, std::memory_order_release);
+}
+
+std::optional<uint64_t> MemoryLayer::oldest_epoch() const {
+    std::optional<uint64_t> oldest;
+    auto consider = [&](uint64_t epoch) {
+        oldest = oldest ? std::min(*oldest, epoch) : epoch;
+    };
+    pimpl_->for_each_symbol([&](SymbolId, Impl::SymbolData& symbol_data) {
+        auto symbol_lock = metrics::lock_shared(symbol_data.mutex, pimpl_->lock_wait);
+        if (symbol_data.has_active()) consider(symbol_data.active_epoch);
+        if (!symbol_data.frozen.empty()) consider(symbol_data.frozen_epoch);
+    });
+    return oldest;
 }
 
 size_t MemoryLayer::get_total_points() const {
-    return pimpl_->total_points_.load();
+    return pimpl_->active_points() + pimpl_->frozen_points.load(std::memory_order_relaxed);
 }
 
 double MemoryLayer::get_cache_hit_ratio() const {
     return 1.0; // We don't use caching anymore
 }
 
+metrics::Summary MemoryLayer::lock_wait() const {
+    return pimpl_->lock_wait.summary();
+}
+
 std::unordered_set<std::string> MemoryLayer::get_symbols() const {
-    std::shared_lock lock(pimpl_->global_mutex);
     std::unordered_set<std::string> symbols;
-    symbols.reserve(pimpl_->symbol_data.size());
-    
-    for (const auto& [symbol, _] : pimpl_->symbol_data) {
-        symbols.insert(symbol);
-    }
-    
+    pimpl_->for_each_symbol([&](SymbolId, Impl::SymbolData& symbol_data) {
+        symbols.insert(symbol_data.symbol);
+    });
     return symbols;
 }
 
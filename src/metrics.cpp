@@ -0,0 +1,89 @@
+#include "findata_engine/metrics.hpp"
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace findata_engine {
+namespace metrics {
+
+namespace {
+
+// Threads take shards round-robin in the order they first record
+size_t shard_index() {
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % NUM_SHARDS;
+    return shard;
+}
+
+} // namespace
+
+size_t Histogram::bucket_of(uint64_t ns) {
+    if (ns < SUB_BUCKETS) return static_cast<size_t>(ns);
+    // The top SUB_BITS + 1 bits pick the bucket: the leading one gives the
+    // power of two, the rest the linear step within it
+    const unsigned shift = static_cast<unsigned>(std::bit_width(ns)) - 1 - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<size_t>((ns >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t Histogram::bucket_upper(size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    const unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS - 1);
+    const uint64_t lower = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void Histogram::record(uint64_t ns) {
+    auto& shard = shards_[shard_index()];
+    shard.counts[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    shard.total.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (ns > max && !shard.max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+Summary Histogram::summary() const {
+    std::array<uint64_t, NUM_BUCKETS> counts{};
+    Summary summary;
+    for (const auto& shard : shards_) {
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+        }
+        summary.total_ns += shard.total.load(std::memory_order_relaxed);
+        summary.max_ns = std::max(summary.max_ns, shard.max.load(std::memory_order_relaxed));
+    }
+    for (uint64_t count : counts) {
+        summary.count += count;
+    }
+    if (summary.count == 0) return summary;
+
+    // Nearest rank: the smallest bucket holding at least q of the samples
+    const std::array<std::pair<double, uint64_t*>, 4> quantiles = {{
+        {0.50, &summary.p50_ns}, {0.90, &summary.p90_ns},
+        {0.99, &summary.p99_ns}, {0.999, &summary.p999_ns},
+    }};
+    uint64_t seen = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < NUM_BUCKETS && next < quantiles.size(); ++i) {
+        seen += counts[i];
+        while (next < quantiles.size() &&
+               static_cast<double>(seen) >= quantiles[next].first * static_cast<double>(summary.count)) {
+            *quantiles[next].second = std::min(bucket_upper(i), summary.max_ns);
+            ++next;
+        }
+    }
+    return summary;
+}
+
+void Counter::add(uint64_t n) {
+    shards_[shard_index()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+} // namespace metrics
+} // namespace findata_engine
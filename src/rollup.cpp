@@ -0,0 +1,159 @@
+#include "findata_engine/rollup.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace findata_engine {
+namespace rollup {
+
+namespace {
+
+using Clock = std::chrono::system_clock;
+
+constexpr int64_t FIELD_COUNT = 6;
+
+Clock::time_point from_ticks(int64_t ticks) {
+    return Clock::time_point(Clock::duration(ticks));
+}
+
+int64_t interval_ticks(std::chrono::seconds interval) {
+    return std::max<int64_t>(std::chrono::duration_cast<Clock::duration>(interval).count(), FIELD_COUNT);
+}
+
+void combine(Bar& into, const Bar& later) {
+    into.high = std::max(into.high, later.high);
+    into.low = std::min(into.low, later.low);
+    into.close = later.close;
+    into.count += later.count;
+    into.sum += later.sum;
+}
+
+} // namespace
+
+std::string series_name(const std::string& symbol, std::chrono::seconds interval) {
+    return symbol + "#" + std::to_string(interval.count()) + "s";
+}
+
+bool is_series_name(std::string_view name) {
+    auto hash = name.rfind('#');
+    if (hash == std::string_view::npos || name.size() < hash + 3 || name.back() != 's') {
+        return false;
+    }
+    auto digits = name.substr(hash + 1, name.size() - hash - 2);
+    return std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+Clock::time_point bucket_start(Clock::time_point tp, std::chrono::seconds interval) {
+    const int64_t width = interval_ticks(interval);
+    const int64_t ticks = tp.time_since_epoch().count();
+    // Floor division so buckets stay aligned before the epoch too
+    int64_t bucket = ticks / width;
+    if (ticks % width < 0) {
+        --bucket;
+    }
+    return from_ticks(bucket * width);
+}
+
+Clock::time_point bucket_end(Clock::time_point tp, std::chrono::seconds interval) {
+    const int64_t width = interval_ticks(interval);
+    const int64_t start = bucket_start(tp, interval).time_since_epoch().count();
+    if (start > std::numeric_limits<int64_t>::max() - (width - 1)) {
+        return Clock::time_point::max();
+    }
+    return from_ticks(start + width - 1);
+}
+
+std::vector<Bar> build(std::span<const TimeSeriesPoint> points, std::chrono::seconds interval) {
+    std::vector<Bar> bars;
+    for (const auto& point : points) {
+        add(bars, point.timestamp, point.value, interval);
+    }
+    return bars;
+}
+
+void add(std::vector<Bar>& bars, Clock::time_point timestamp, double value, std::chrono::seconds interval) {
+    auto start = bucket_start(timestamp, interval);
+    if (bars.empty() || bars.back().start != start) {
+        bars.push_back(Bar{
+            .start = start,
+            .open = value,
+            .high = value,
+            .low = value,
+            .close = value,
+            .count = 1,
+            .sum = value
+        });
+        return;
+    }
+    auto& bar = bars.back();
+    bar.high = std::max(bar.high, value);
+    bar.low = std::min(bar.low, value);
+    bar.close = value;
+    bar.count += 1;
+    bar.sum += value;
+}
+
+std::vector<Bar> merge(const std::vector<Bar>& earlier, const std::vector<Bar>& later) {
+    std::vector<Bar> merged;
+    merged.reserve(earlier.size() + later.size());
+    size_t i = 0, j = 0;
+    while (i < earlier.size() || j < later.size()) {
+        if (j == later.size() || (i < earlier.size() && earlier[i].start < later[j].start)) {
+            merged.push_back(earlier[i++]);
+        } else if (i == earlier.size() || later[j].start < earlier[i].start) {
+            merged.push_back(later[j++]);
+        } else {
+            merged.push_back(earlier[i++]);
+            combine(merged.back(), later[j++]);
+        }
+    }
+    return merged;
+}
+
+std::vector<TimeSeriesPoint> to_points(const std::string& series, const std::vector<Bar>& bars) {
+    std::vector<TimeSeriesPoint> points;
+    points.reserve(bars.size() * FIELD_COUNT);
+    for (const auto& bar : bars) {
+        const double fields[FIELD_COUNT] = {
+            bar.open, bar.high, bar.low, bar.close, static_cast<double>(bar.count), bar.sum
+        };
+        for (int64_t k = 0; k < FIELD_COUNT; ++k) {
+            points.push_back(TimeSeriesPoint{
+                .timestamp = bar.start + Clock::duration(k),
+                .value = fields[k],
+                .symbol = series
+            });
+        }
+    }
+    return points;
+}
+
+std::vector<Bar> from_points(const std::vector<TimeSeriesPoint>& points) {
+    std::vector<Bar> bars;
+    bars.reserve(points.size() / FIELD_COUNT);
+    for (size_t i = 0; i + FIELD_COUNT <= points.size();) {
+        // Fields must be the six consecutive ticks of one bar
+        const auto start = points[i].timestamp;
+        bool complete = true;
+        for (int64_t k = 1; k < FIELD_COUNT; ++k) {
+            complete = complete && points[i + k].timestamp == start + Clock::duration(k);
+        }
+        if (!complete) {
+            ++i;
+            continue;
+        }
+        bars.push_back(Bar{
+            .start = start,
+            .open = points[i].value,
+            .high = points[i + 1].value,
+            .low = points[i + 2].value,
+            .close = points[i + 3].value,
+            .count = static_cast<uint64_t>(points[i + 4].value),
+            .sum = points[i + 5].value
+        });
+        i += FIELD_COUNT;
+    }
+    return bars;
+}
+
+} // namespace rollup
+} // namespace findata_engine
@@ -0,0 +1,55 @@
+#include "simd_kernels.hpp"
+#include <immintrin.h>
+#include <cstring>
+
+namespace findata_engine {
+namespace utils {
+namespace kernels {
+
+namespace {
+
+// Inclusive scan within one 4-lane vector by shift-and-combine
+template<typename Op>
+__m256i lane_scan(__m256i x, Op op) {
+    const __m256i zero = _mm256_setzero_si256();
+    x = op(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+    x = op(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+    return x;
+}
+
+// The running carry only depends on the previous carry, so the per-vector
+// scans pipeline freely
+template<typename T, typename Op>
+void vector_scan(T* data, size_t n, Op op) {
+    auto* ptr = reinterpret_cast<__m256i*>(data);
+    __m256i carry = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, ++ptr) {
+        __m256i x = lane_scan(_mm256_loadu_si256(ptr), op);
+        const __m256i total = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm256_storeu_si256(ptr, op(x, carry));
+        carry = op(carry, total);
+    }
+    
+    // Partial last vector: zero padding is neutral for both add and xor
+    if (i < n) {
+        __m256i tail = _mm256_setzero_si256();
+        std::memcpy(&tail, data + i, (n - i) * sizeof(T));
+        tail = op(lane_scan(tail, op), carry);
+        std::memcpy(data + i, &tail, (n - i) * sizeof(T));
+    }
+}
+
+} // namespace
+
+void prefix_sum_avx2(int64_t* data, size_t n) {
+    vector_scan(data, n, [](__m256i a, __m256i b) { return _mm256_add_epi64(a, b); });
+}
+
+void prefix_xor_avx2(uint64_t* data, size_t n) {
+    vector_scan(data, n, [](__m256i a, __m256i b) { return _mm256_xor_si256(a, b); });
+}
+
+} // namespace kernels
+} // namespace utils
+} // namespace findata_engine
@@ -0,0 +1,63 @@
+#include "simd_kernels.hpp"
+#include <immintrin.h>
+
+namespace findata_engine {
+namespace utils {
+namespace kernels {
+
+namespace {
+
+// The unmasked alignr and permutexvar forms pass an undefined vector as
+// their merge source, which GCC 12 reports as maybe-uninitialized. The
+// zero-masking forms with every lane selected compute the same result.
+constexpr __mmask8 ALL_LANES = 0xFF;
+
+// Lanes shifted up by `count`, zeros shifted in: valignq over (x, zero)
+template<int count>
+__m512i shift_lanes(__m512i x) {
+    return _mm512_maskz_alignr_epi64(ALL_LANES, x, _mm512_setzero_si512(), 8 - count);
+}
+
+// Inclusive scan within one 8-lane vector in three shift-and-combine steps
+template<typename Op>
+__m512i lane_scan(__m512i x, Op op) {
+    x = op(x, shift_lanes<1>(x));
+    x = op(x, shift_lanes<2>(x));
+    x = op(x, shift_lanes<4>(x));
+    return x;
+}
+
+// Same structure as the AVX2 scan; the tail uses masked loads and stores
+// instead of a bounce buffer
+template<typename T, typename Op>
+void vector_scan(T* data, size_t n, Op op) {
+    const __m512i last_lane = _mm512_set1_epi64(7);
+    __m512i carry = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i x = lane_scan(_mm512_loadu_si512(data + i), op);
+        const __m512i total = _mm512_maskz_permutexvar_epi64(ALL_LANES, last_lane, x);
+        _mm512_storeu_si512(data + i, op(x, carry));
+        carry = op(carry, total);
+    }
+    
+    if (i < n) {
+        const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+        __m512i tail = lane_scan(_mm512_maskz_loadu_epi64(mask, data + i), op);
+        _mm512_mask_storeu_epi64(data + i, mask, op(tail, carry));
+    }
+}
+
+} // namespace
+
+void prefix_sum_avx512(int64_t* data, size_t n) {
+    vector_scan(data, n, [](__m512i a, __m512i b) { return _mm512_add_epi64(a, b); });
+}
+
+void prefix_xor_avx512(uint64_t* data, size_t n) {
+    vector_scan(data, n, [](__m512i a, __m512i b) { return _mm512_xor_si512(a, b); });
+}
+
+} // namespace kernels
+} // namespace utils
+} // namespace findata_engine
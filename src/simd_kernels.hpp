@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ISA-specific variants of the utils kernels. Each set lives in its own
+// translation unit built with that ISA enabled, and must only be called
+// after utils.cpp has checked the host supports it. Those translation units
+// take raw pointers and use no inline library code: an inline function
+// they instantiated could be the copy the linker keeps for the whole
+// program, and would then fault on older hosts.
+
+namespace findata_engine {
+namespace utils {
+namespace kernels {
+
+#ifdef FINDATA_HAVE_AVX2
+void prefix_sum_avx2(int64_t* data, size_t n);
+void prefix_xor_avx2(uint64_t* data, size_t n);
+#endif
+
+#ifdef FINDATA_HAVE_AVX512
+void prefix_sum_avx512(int64_t* data, size_t n);
+void prefix_xor_avx512(uint64_t* data, size_t n);
+#endif
+
+} // namespace kernels
+} // namespace utils
+} // namespace findata_engine
@@ -1,44 +1,351 @@
 #include "findata_engine/storage_engine.hpp"
+#include "findata_engine/wal.hpp"
+#include "findata_engine/utils.hpp"
+#include "findata_engine/metrics.hpp"
 #include <filesystem>
 #include <stdexcept>
 #include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <exception>
+#include <cstdio>
+#include <array>
+#include <unordered_map>
+#include <string_view>
 
 namespace findata_engine {
 
+namespace {
+
+// Newest point per symbol, maintained on every write so get_latest never
+// has to consult the memtable or disk. Indexed by SymbolId, one lock each.
+class LatestCache {
+public:
+    std::optional<TimeSeriesPoint> get(SymbolId id) const {
+        const auto* slot = slots_.find(id);
+        if (slot == nullptr) {
+            return std::nullopt;
+        }
+        std::shared_lock lock(slot->mutex);
+        return slot->point;
+    }
+    
+    // A point at the cached timestamp replaces it: callers pass points in
+    // the order the layer that holds them would let them win
+    void update(SymbolId id, const TimeSeriesPoint& point) {
+        auto& slot = slots_.get_or_create(id);
+        std::unique_lock lock(slot.mutex);
+        if (!slot.point || point.timestamp >= slot.point->timestamp) {
+            slot.point = point;
+        }
+    }
+    
+private:
+    struct Slot {
+        mutable std::shared_mutex mutex;
+        std::optional<TimeSeriesPoint> point;
+    };
+    
+    SymbolTable<Slot> slots_;
+};
+
+std::vector<TimeSeriesPoint> collect(RangeCursor& cursor) {
+    std::vector<TimeSeriesPoint> result;
+    std::vector<TimeSeriesPoint> batch;
+    while (cursor.next(batch)) {
+        result.insert(result.end(),
+                      std::make_move_iterator(batch.begin()),
+                      std::make_move_iterator(batch.end()));
+    }
+    return result;
+}
+
+// Rollup series share the catalog with ticks, so their names are reserved
+void check_symbol_name(const std::string& symbol) {
+    if (rollup::is_series_name(symbol)) {
+        throw std::invalid_argument("Symbol name is reserved for rollup series: " + symbol);
+    }
+}
+
+// Calls fn(first, last) with the first and last tick of each run of
+// adjacent buckets among sorted, distinct bucket starts
+template<typename Fn>
+void for_each_bucket_run(const std::vector<std::chrono::system_clock::time_point>& starts,
+                         std::chrono::seconds interval, Fn&& fn) {
+    for (size_t i = 0; i < starts.size();) {
+        size_t j = i;
+        while (j + 1 < starts.size() && starts[j + 1] == rollup::bucket_end(starts[j], interval) +
+                                                          std::chrono::system_clock::duration(1)) {
+            ++j;
+        }
+        fn(starts[i], rollup::bucket_end(starts[j], interval));
+        i = j + 1;
+    }
+}
+
+} // namespace
+
+struct RangeCursor::Impl {
+    std::vector<TimeSeriesPoint> memory_points;
+    size_t memory_pos = 0;
+    DiskLayer::Cursor disk;
+    std::vector<TimeSeriesPoint> disk_batch;
+    size_t disk_pos = 0;
+    bool disk_done = false;
+    
+    Impl(std::vector<TimeSeriesPoint>&& memory, DiskLayer::Cursor&& disk_cursor)
+        : memory_points(std::move(memory)), disk(std::move(disk_cursor)) {}
+    
+    // Two-way merge of the memtable snapshot and the disk stream. A point
+    // seen in both a frozen memtable and its segment keeps the memory copy.
+    bool next(std::vector<TimeSeriesPoint>& batch, size_t max_points) {
+        batch.clear();
+        while (batch.size() < max_points) {
+            if (disk_pos == disk_batch.size() && !disk_done) {
+                disk_done = !disk.next(disk_batch, max_points);
+                disk_pos = 0;
+            }
+            
+            const bool has_memory = memory_pos < memory_points.size();
+            const bool has_disk = disk_pos < disk_batch.size();
+            if (!has_memory && !has_disk) break;
+            
+            if (has_disk && (!has_memory ||
+                             disk_batch[disk_pos].timestamp < memory_points[memory_pos].timestamp)) {
+                batch.push_back(std::move(disk_batch[disk_pos++]));
+                continue;
+            }
+            if (has_disk && disk_batch[disk_pos].timestamp == memory_points[memory_pos].timestamp) {
+                ++disk_pos;
+            }
+            batch.push_back(std::move(memory_points[memory_pos++]));
+        }
+        return !batch.empty();
+    }
+};
+
+RangeCursor::RangeCursor(std::unique_ptr<Impl> impl) : pimpl_(std::move(impl)) {}
+RangeCursor::RangeCursor(RangeCursor&&) noexcept = default;
+RangeCursor& RangeCursor::operator=(RangeCursor&&) noexcept = default;
+RangeCursor::~RangeCursor() = default;
+
+bool RangeCursor::next(std::vector<TimeSeriesPoint>& batch, size_t max_points) {
+    return pimpl_->next(batch, std::max<size_t>(max_points, 1));
+}
+
 struct StorageEngine::Impl {
     EngineConfig config;
-    std::unique_ptr<MemoryLayer> memory_layer;
     std::unique_ptr<DiskLayer> disk_layer;
-    mutable std::shared_mutex mutex;
+    std::shared_ptr<SymbolCatalog> catalog; // Persisted by the disk layer
+    std::unique_ptr<MemoryLayer> memory_layer;
+    std::unique_ptr<WriteAheadLog> wal;
     std::atomic<size_t> total_points{0};
-    std::atomic<size_t> cache_hits{0};
-    std::atomic<size_t> cache_misses{0};
     
-    explicit Impl(const EngineConfig& cfg) : config(cfg) {
+    // See EngineStats
+    metrics::Counter rejected_points;
+    metrics::Histogram write_latency;
+    metrics::Histogram read_latency;
+    metrics::Histogram flush_latency;
+    metrics::Histogram lock_wait;
+    
+    // Background flush: writers only signal, the flush thread freezes the
+    // active memtable and drains the frozen one to disk
+    std::mutex flush_mutex; // serializes flushes
+    std::mutex flush_signal_mutex;
+    std::condition_variable flush_cv;
+    bool flush_requested = false;
+    bool stopping = false;
+    std::thread flush_thread;
+    
+    // Fan-out for multi-symbol reads, started by the first one
+    std::once_flag scan_pool_once;
+    std::unique_ptr<utils::ThreadPool> scan_pool;
+    
+    utils::ThreadPool& scan_workers() {
+        std::call_once(scan_pool_once, [this] {
+            scan_pool = std::make_unique<utils::ThreadPool>(
+                config.scan_threads ? config.scan_threads : std::thread::hardware_concurrency());
+        });
+        return *scan_pool;
+    }
+    
+    // Held exclusively while a flush stores a symbol's bars and drops its
+    // frozen snapshot, so read_bars never counts a tick in both
+    std::shared_mutex rollup_mutex;
+    
+    // Flushed snapshots whose tick segment is on disk but whose bars failed
+    // to store, oldest first. The next flush retries only the bars, and
+    // read_bars recomputes their buckets meanwhile. wal_epoch keeps the WAL
+    // files that could rebuild them after a crash; frozen_at is withheld
+    // from the WAL's flush marker until the bars are stored. Guarded by
+    // rollup_mutex.
+    struct PendingRollup {
+        std::string symbol;
+        std::vector<TimeSeriesPoint> points;
+        uint64_t wal_epoch;
+        uint64_t frozen_at;
+    };
+    std::deque<PendingRollup> pending_rollups;
+    
+    // Refreshed from the memtable tail after each insert; flushes only move
+    // points, so they leave it alone except for the rollup series they write
+    LatestCache latest;
+    
+    SubscriptionHub subscriptions;
+    
+    explicit Impl(const EngineConfig& cfg)
+        : config(cfg) {
         if (!std::filesystem::exists(config.data_directory)) {
             std::filesystem::create_directories(config.data_directory);
         }
         
-        memory_layer = std::make_unique<MemoryLayer>(config.memory_cache_size_mb);
-        disk_layer = std::make_unique<DiskLayer>(config.data_directory);
+        DiskConfig disk_config;
+        disk_config.enable_compression = config.enable_compression;
+        disk_config.codec = config.compression_codec;
+        disk_config.block_cache_size_mb = config.disk_config.disk_cache_size_mb;
+        disk_config.max_segment_size_mb = config.disk_config.max_disk_segment_size_mb;
+        disk_config.points_per_block = config.disk_config.points_per_block;
+        disk_config.use_mmap = config.disk_config.use_mmap;
+        disk_config.read_ahead_blocks = config.disk_config.read_ahead_blocks;
+        disk_config.compaction_threads = config.disk_config.compaction_threads;
+        disk_layer = std::make_unique<DiskLayer>(config.data_directory, disk_config);
+        catalog = disk_layer->catalog();
+        memory_layer = std::make_unique<MemoryLayer>(config.memory_cache_size_mb, catalog);
+        for (const auto& symbol : disk_layer->get_symbols()) {
+            if (auto point = disk_layer->get_latest(symbol)) {
+                latest.update(catalog->intern(symbol), *point);
+            }
+        }
+        
+        if (config.enable_wal) {
+            wal = std::make_unique<WriteAheadLog>(
+                config.data_directory / "wal",
+                WalConfig{
+                    .group_commit_us = config.wal_group_commit_us,
+                    .group_commit_bytes = config.wal_group_commit_bytes,
+                    .sync_commit = config.wal_sync_commit
+                });
+            
+            // Recover points that were acknowledged but never flushed
+            wal->replay([this](std::vector<TimeSeriesPoint>&& points) {
+                memory_layer->insert_batch(points);
+                refresh_latest(points);
+            });
+        }
+        
+        flush_thread = std::thread([this] { flush_loop(); });
+    }
+    
+    ~Impl() {
+        {
+            std::lock_guard lock(flush_signal_mutex);
+            stopping = true;
+        }
+        flush_cv.notify_one();
+        flush_thread.join();
+    }
+    
+    void schedule_flush() {
+        {
+            std::lock_guard lock(flush_signal_mutex);
+            flush_requested = true;
+        }
+        flush_cv.notify_one();
     }
     
+    void flush_loop() {
+        std::unique_lock lock(flush_signal_mutex);
+        while (true) {
+            flush_cv.wait(lock, [this] { return flush_requested || stopping; });
+            if (stopping) break;
+            flush_requested = false;
+            
+            lock.unlock();
+            try {
+                flush_symbols(pick_spill());
+            } catch (const std::exception& e) {
+                // Frozen data stays readable and is retried on the next flush
+                fprintf(stderr, "Background flush failed: %s\n", e.what());
+            }
+            lock.lock();
+        }
+    }
+    
+    // The memtable drops a write whose timestamp it already holds, so the
+    // cache takes the memtable's newest point rather than the written one
+    void refresh_latest(SymbolId id) {
+        if (auto point = memory_layer->get_latest(id)) {
+            latest.update(id, *point);
+        }
+    }
+    
+    void refresh_latest(const std::string& symbol) {
+        if (auto id = catalog->find(symbol)) {
+            refresh_latest(*id);
+        }
+    }
+    
+    void refresh_latest(const std::vector<TimeSeriesPoint>& points) {
+        std::unordered_set<std::string_view> symbols;
+        for (const auto& point : points) {
+            if (symbols.insert(point.symbol).second) {
+                refresh_latest(point.symbol);
+            }
+        }
+    }
+    
+    // Symbol lookups are skipped while nobody is subscribed
+    void publish(const std::vector<TimeSeriesPoint>& points) {
+        if (!subscriptions.active()) return;
+        for (const auto& point : points) {
+            if (auto id = catalog->find(point.symbol)) {
+                subscriptions.publish(*id, point.timestamp.time_since_epoch().count(), point.value);
+            }
+        }
+    }
+    
+    // Writers take no engine-level lock; MemoryLayer shards its own locking
+    // by symbol so ingest on disjoint symbols runs in parallel.
     bool write_point(const TimeSeriesPoint& point) {
-        std::unique_lock lock(mutex);
-        
-        if (!memory_layer->insert(point)) {
+        metrics::ScopedTimer timer(write_latency);
+        check_symbol_name(point.symbol);
+        const SymbolId id = catalog->intern(point.symbol);
+        if (!memory_layer->insert(id, point.timestamp, point.value)) {
+            rejected_points.add();
+            return false;
+        }
+        return commit_point(id, point);
+    }
+    
+    bool write_point(SymbolId id, std::chrono::system_clock::time_point timestamp, double value) {
+        metrics::ScopedTimer timer(write_latency);
+        if (!memory_layer->insert(id, timestamp, value)) {
+            rejected_points.add();
             return false;
         }
+        return commit_point(id, TimeSeriesPoint{
+            .timestamp = timestamp, .value = value, .symbol = catalog->name(id)});
+    }
+    
+    // Logs and accounts for a point the memtable accepted
+    bool commit_point(SymbolId id, const TimeSeriesPoint& point) {
+        refresh_latest(id);
+        subscriptions.publish(id, point.timestamp.time_since_epoch().count(), point.value);
         
-        // If memory layer is getting full, schedule a flush
-        bool needs_flush = memory_layer->cache_size() >= config.max_memory_points;
-        total_points++;
+        // Logged after the memtable insert so a concurrent flush's WAL
+        // rotation can never strand an unflushed point in a truncated file
+        if (wal && !wal->append(point)) {
+            return false;
+        }
         
-        // Release lock before flushing
-        lock.unlock();
+        total_points.fetch_add(1, std::memory_order_relaxed);
         
-        if (needs_flush) {
-            return flush();
+        if (over_budget()) {
+            schedule_flush();
         }
         
         return true;
@@ -47,119 +354,326 @@ struct StorageEngine::Impl {
     bool write_batch(const std::vector<TimeSeriesPoint>& points) {
         if (points.empty()) return true;
         
-        std::unique_lock lock(mutex);
-        
-        if (!memory_layer->insert_batch(points)) {
+        metrics::ScopedTimer timer(write_latency);
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (i == 0 || points[i].symbol != points[i - 1].symbol) {
+                check_symbol_name(points[i].symbol);
+            }
+        }
+        std::vector<uint8_t> accepted;
+        if (!memory_layer->insert_batch(points, &accepted)) {
             return false;
         }
+        const size_t inserted = std::count(accepted.begin(), accepted.end(), 1);
+        rejected_points.add(points.size() - inserted);
+        refresh_latest(points);
         
-        // If memory layer is getting full, schedule a flush
-        bool needs_flush = memory_layer->cache_size() >= config.max_memory_points;
-        total_points += points.size();
+        // Only the points kept are published and logged: a copy dropped for
+        // clashing with a frozen one would otherwise be replayed over it
+        // after a restart
+        std::vector<TimeSeriesPoint> kept;
+        if (inserted < points.size()) {
+            kept.reserve(inserted);
+            for (size_t i = 0; i < points.size(); ++i) {
+                if (accepted[i]) kept.push_back(points[i]);
+            }
+        }
+        const auto& logged = inserted < points.size() ? kept : points;
+        publish(logged);
+        if (wal && !logged.empty() && !wal->append(logged)) {
+            return false;
+        }
         
-        // Release lock before flushing
-        lock.unlock();
+        total_points.fetch_add(inserted, std::memory_order_relaxed);
         
-        if (needs_flush) {
-            return flush();
+        if (over_budget()) {
+            schedule_flush();
         }
         
         return true;
     }
     
-    bool flush() {
-        // First get all data under a lock
-        std::vector<TimeSeriesPoint> points_to_flush;
-        {
-            std::unique_lock lock(mutex);
-            auto symbols = memory_layer->get_symbols();
-            
-            for (const auto& symbol : symbols) {
-                auto symbol_points = memory_layer->get_range(
-                    symbol,
-                    std::chrono::system_clock::time_point::min(),
-                    std::chrono::system_clock::time_point::max()
-                );
-                points_to_flush.insert(
-                    points_to_flush.end(),
-                    symbol_points.begin(),
-                    symbol_points.end()
-                );
+    bool write_columns(SymbolId id, std::span<const int64_t> timestamps, std::span<const double> values) {
+        metrics::ScopedTimer timer(write_latency);
+        std::vector<uint8_t> accepted;
+        if (!memory_layer->insert_columns(id, timestamps, values, &accepted)) {
+            return false;
+        }
+        const size_t inserted = std::count(accepted.begin(), accepted.end(), 1);
+        rejected_points.add(timestamps.size() - inserted);
+        refresh_latest(id);
+        
+        // As in write_batch, only the rows kept are published and logged
+        std::vector<int64_t> kept_ts;
+        std::vector<double> kept_values;
+        if (inserted < timestamps.size()) {
+            kept_ts.reserve(inserted);
+            kept_values.reserve(inserted);
+            for (size_t i = 0; i < timestamps.size(); ++i) {
+                if (!accepted[i]) continue;
+                kept_ts.push_back(timestamps[i]);
+                kept_values.push_back(values[i]);
             }
+            timestamps = kept_ts;
+            values = kept_values;
+        }
+        subscriptions.publish(id, timestamps, values);
+        if (wal && !timestamps.empty() && !wal->append(catalog->name(id), timestamps, values)) {
+            return false;
         }
         
-        if (points_to_flush.empty()) {
-            return true;
+        total_points.fetch_add(inserted, std::memory_order_relaxed);
+        if (over_budget()) {
+            schedule_flush();
+        }
+        return true;
+    }
+    
+    // Symbol entries are left out: no flush frees them, so counting them
+    // would keep scheduling flushes once enough symbols exist
+    bool over_budget() const {
+        const size_t budget = memory_layer->memory_budget();
+        return memory_layer->cache_size() >= config.max_memory_points ||
+               (budget > 0 && memory_layer->releasable_usage() >= budget);
+    }
+    
+    // Symbols to spill, in policy order, until what stays resident fits in
+    // half of each limit. Leaves headroom so one spill isn't followed by
+    // another a few writes later.
+    std::vector<SymbolId> pick_spill() const {
+        auto usage = memory_layer->active_usage();
+        if (config.flush_policy == FlushPolicy::Oldest) {
+            std::sort(usage.begin(), usage.end(), [](const auto& a, const auto& b) {
+                return a.active_since < b.active_since;
+            });
+        } else {
+            std::sort(usage.begin(), usage.end(), [](const auto& a, const auto& b) {
+                return a.bytes > b.bytes;
+            });
         }
         
-        // Write to disk without holding the lock
-        bool success = disk_layer->write_batch(points_to_flush);
+        const size_t byte_target = memory_layer->memory_budget() / 2;
+        const size_t point_target = config.max_memory_points / 2;
+        size_t bytes = memory_layer->releasable_usage();
+        size_t points = memory_layer->cache_size();
         
-        // If successful, clear memory under lock
-        if (success) {
-            std::unique_lock lock(mutex);
-            memory_layer->clear_cache();
+        std::vector<SymbolId> ids;
+        for (const auto& entry : usage) {
+            if ((byte_target == 0 || bytes <= byte_target) && points <= point_target) break;
+            ids.push_back(entry.id);
+            bytes -= std::min(bytes, entry.bytes);
+            points -= std::min(points, entry.points);
         }
-        
-        return success;
+        return ids;
     }
     
-    std::vector<TimeSeriesPoint> read_range(
-        const std::string& symbol,
-        std::chrono::system_clock::time_point start,
-        std::chrono::system_clock::time_point end) {
-        
-        // Get memory points under shared lock
-        std::vector<TimeSeriesPoint> memory_points;
-        {
-            std::shared_lock lock(mutex);
-            memory_points = memory_layer->get_range(symbol, start, end);
+    bool flush() {
+        return flush_symbols(std::nullopt);
+    }
+    
+    // Writes the given symbols' active points (all of them for nullopt) to
+    // disk, along with any snapshot a failed flush left behind
+    bool flush_symbols(const std::optional<std::vector<SymbolId>>& ids) {
+        auto guard = metrics::lock_unique(flush_mutex, lock_wait);
+        if (ids && ids->empty() && !has_leftovers()) {
+            return true; // Nothing to write; don't open a WAL file for it
         }
+        metrics::ScopedTimer timer(flush_latency);
         
-        // Get disk points without lock
-        auto disk_points = disk_layer->read_range(symbol, start, end);
+        // Everything logged so far ends up in WAL files before this id.
+        // Writes from here on are stamped with it, so oldest_epoch tells
+        // which files some unflushed point may still need.
+        const uint64_t wal_file = wal ? wal->rotate() : 0;
+        memory_layer->set_epoch(wal_file);
+        
+        // Swap in a fresh memtable; writers carry on while the frozen one is
+        // written. Snapshots left behind by a failed flush are retried here.
+        if (ids) {
+            memory_layer->freeze(*ids);
+        } else {
+            memory_layer->freeze();
+        }
         
-        // Merge results
-        std::vector<TimeSeriesPoint> result;
-        result.reserve(memory_points.size() + disk_points.size());
-        result.insert(result.end(), memory_points.begin(), memory_points.end());
-        result.insert(result.end(), disk_points.begin(), disk_points.end());
+        // Symbols fully persisted here, with the epoch their snapshot was
+        // frozen in; their records in older WAL files need no replay
+        std::vector<std::pair<std::string, uint64_t>> flushed;
+        bool success = retry_pending_rollups(flushed);
+        for (const auto& symbol : memory_layer->get_frozen_symbols()) {
+            auto points = memory_layer->get_frozen(symbol);
+            const uint64_t frozen_at = memory_layer->frozen_at(symbol).value_or(0);
+            // The stored bars cover the ticks on disk before this write
+            const auto stored_through = disk_layer->get_end_time(symbol).value_or(
+                std::chrono::system_clock::time_point::min());
+            if (!disk_layer->write_batch(points)) {
+                success = false;
+                continue;
+            }
+            
+            // Segment is visible on disk, so the snapshot goes whether or not
+            // its bars can be stored; a retry must not write the ticks again
+            auto lock = metrics::lock_unique(rollup_mutex, lock_wait);
+            bool stored = false;
+            std::string error;
+            try {
+                stored = !pending_rollup_for(symbol) && write_rollups(symbol, points, stored_through);
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+            if (!stored) {
+                if (!error.empty()) {
+                    fprintf(stderr, "Storing bars of %s failed, retrying next flush: %s\n", symbol.c_str(), error.c_str());
+                }
+                const uint64_t epoch = memory_layer->oldest_epoch().value_or(wal_file);
+                pending_rollups.push_back(PendingRollup{
+                    .symbol = symbol, .points = std::move(points), .wal_epoch = epoch, .frozen_at = frozen_at});
+                success = false;
+            } else {
+                flushed.emplace_back(symbol, frozen_at);
+            }
+            memory_layer->release_frozen(symbol);
+        }
         
-        // Sort by timestamp
-        std::sort(result.begin(), result.end(),
-                  [](const TimeSeriesPoint& a, const TimeSeriesPoint& b) {
-                      return a.timestamp < b.timestamp;
-                  });
+        // Older log files are only needed while some point logged in them
+        // is still in memory, frozen or not, or waits for its bars. A
+        // partial spill keeps files that also hold the symbols it wrote,
+        // so the marker stops a restart from flushing those again.
+        if (wal) {
+            if (!wal->mark_flushed(flushed)) {
+                success = false;
+            }
+            uint64_t keep = std::min(memory_layer->oldest_epoch().value_or(wal_file), wal_file);
+            auto lock = metrics::lock_shared(rollup_mutex, lock_wait);
+            for (const auto& pending : pending_rollups) {
+                keep = std::min(keep, pending.wal_epoch);
+            }
+            wal->truncate_before(keep);
+        }
         
-        return result;
+        return success;
     }
     
-    std::optional<TimeSeriesPoint> get_latest(const std::string& symbol) {
-        // First try memory layer
-        {
-            std::shared_lock lock(mutex);
-            if (auto point = memory_layer->get_latest(symbol)) {
-                return point;
+    // Whether a failed flush left a snapshot or bars for this one to retry
+    bool has_leftovers() {
+        if (!memory_layer->get_frozen_symbols().empty()) {
+            return true;
+        }
+        auto lock = metrics::lock_shared(rollup_mutex, lock_wait);
+        return !pending_rollups.empty();
+    }
+    
+    // Whether an earlier snapshot of the symbol still waits for its bars;
+    // later ones queue behind it, so the WAL marker of a later one never
+    // retires the records of an earlier one. Caller holds rollup_mutex.
+    bool pending_rollup_for(const std::string& symbol) const {
+        return std::any_of(pending_rollups.begin(), pending_rollups.end(),
+                           [&](const PendingRollup& pending) { return pending.symbol == symbol; });
+    }
+    
+    // Stores queued bars oldest first, stopping at the first failure so a
+    // symbol's snapshots are never folded out of order. Snapshots done are
+    // added to `flushed`.
+    bool retry_pending_rollups(std::vector<std::pair<std::string, uint64_t>>& flushed) {
+        auto lock = metrics::lock_unique(rollup_mutex, lock_wait);
+        while (!pending_rollups.empty()) {
+            auto& pending = pending_rollups.front();
+            try {
+                // Later ticks may be on disk by now, so every bucket is rebuilt
+                if (!write_rollups(pending.symbol, pending.points, std::chrono::system_clock::time_point::max())) {
+                    return false;
+                }
+            } catch (const std::exception& e) {
+                fprintf(stderr, "Storing bars of %s failed again: %s\n", pending.symbol.c_str(), e.what());
+                return false;
             }
+            flushed.emplace_back(pending.symbol, pending.frozen_at);
+            pending_rollups.pop_front();
         }
+        return true;
+    }
+    
+    bool has_rollup(std::chrono::seconds interval) const {
+        const auto& intervals = config.rollup_intervals;
+        return std::find(intervals.begin(), intervals.end(), interval) != intervals.end();
+    }
+    
+    // Folds a flushed snapshot into the symbol's stored bars, which cover
+    // every tick on disk up to stored_through. A bucket the snapshot only
+    // adds later ticks to is merged with its stored bar. One it reaches back
+    // into, where it may rewrite a tick, is rebuilt from the ticks on disk,
+    // which resolve a repeated timestamp to its newest copy; so a tick
+    // flushed twice, by a WAL replay or a rewrite, still counts once.
+    // Caller holds rollup_mutex exclusively.
+    bool write_rollups(const std::string& symbol, const std::vector<TimeSeriesPoint>& points,
+                       std::chrono::system_clock::time_point stored_through) {
+        if (points.empty()) return true;
         
-        // Then try disk layer
-        auto disk_points = disk_layer->read_range(
-            symbol,
-            std::chrono::system_clock::time_point::min(),
-            std::chrono::system_clock::time_point::max()
-        );
-        
-        if (!disk_points.empty()) {
-            return disk_points.back();
+        const auto later = std::upper_bound(points.begin(), points.end(), stored_through,
+            [](auto timestamp, const TimeSeriesPoint& point) { return timestamp < point.timestamp; });
+        std::vector<TimeSeriesPoint> rows;
+        for (auto interval : config.rollup_intervals) {
+            std::vector<std::chrono::system_clock::time_point> rebuilt;
+            for (auto it = points.begin(); it != later; ++it) {
+                auto start = rollup::bucket_start(it->timestamp, interval);
+                if (rebuilt.empty() || rebuilt.back() != start) {
+                    rebuilt.push_back(start);
+                }
+            }
+            std::vector<Bar> bars;
+            for_each_bucket_run(rebuilt, interval, [&](auto first, auto last) {
+                auto built = rollup::build(disk_layer->read_range(symbol, first, last), interval);
+                bars.insert(bars.end(), built.begin(), built.end());
+            });
+            
+            // Ticks sharing the last rebuilt bucket were counted with it
+            auto rest = later;
+            while (rest != points.end() && !rebuilt.empty() &&
+                   rollup::bucket_start(rest->timestamp, interval) == rebuilt.back()) {
+                ++rest;
+            }
+            const auto series = rollup::series_name(symbol, interval);
+            if (rest != points.end()) {
+                // Only the bucket holding stored_through can have a bar yet
+                auto fresh = rollup::build({rest, points.end()}, interval);
+                auto stored = rollup::from_points(disk_layer->read_range(
+                    series, fresh.front().start, rollup::bucket_end(fresh.front().start, interval)));
+                auto merged = rollup::merge(stored, fresh);
+                bars.insert(bars.end(), merged.begin(), merged.end());
+            }
+            auto encoded = rollup::to_points(series, bars);
+            rows.insert(rows.end(),
+                        std::make_move_iterator(encoded.begin()),
+                        std::make_move_iterator(encoded.end()));
+        }
+        if (!disk_layer->write_batch(rows)) {
+            return false;
         }
         
-        return std::nullopt;
+        // Each series' rows are sorted, so its last row is its newest
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (i + 1 == rows.size() || rows[i + 1].symbol != rows[i].symbol) {
+                latest.update(catalog->intern(rows[i].symbol), rows[i]);
+            }
+        }
+        return true;
+    }
+    
+    std::optional<TimeSeriesPoint> get_latest(const std::string& symbol) const {
+        auto id = catalog->find(symbol);
+        return id ? latest.get(*id) : std::nullopt;
     }
     
+    // Every symbol with data in either layer has a cached latest point
     std::unordered_set<std::string> get_symbols() const {
-        std::shared_lock lock(mutex);
-        return memory_layer->get_symbols();
+        std::unordered_set<std::string> symbols;
+        const SymbolId count = catalog->size();
+        for (SymbolId id = 0; id < count; ++id) {
+            if (!latest.get(id)) continue;
+            const auto& symbol = catalog->name(id);
+            if (!rollup::is_series_name(symbol)) {
+                symbols.insert(symbol);
+            }
+        }
+        return symbols;
     }
     
     void optimize() {
@@ -171,8 +685,8 @@ struct StorageEngine::Impl {
     }
     
     double get_cache_hit_ratio() const {
-        const auto total_hits = cache_hits.load();
-        const auto total_misses = cache_misses.load();
+        const auto total_hits = disk_layer->get_cache_hits();
+        const auto total_misses = disk_layer->get_cache_misses();
         const auto total_requests = total_hits + total_misses;
         
         return total_requests > 0 ? 
@@ -180,7 +694,7 @@ struct StorageEngine::Impl {
     }
     
     size_t get_total_points() const {
-        return total_points.load();
+        return total_points.load(std::memory_order_relaxed);
     }
     
     size_t get_storage_size() const {
@@ -197,25 +711,332 @@ bool StorageEngine::write_point(const TimeSeriesPoint& point) {
     return pimpl_->write_point(point);
 }
 
+bool StorageEngine::write_point(SymbolId id, std::chrono::system_clock::time_point timestamp, double value) {
+    return pimpl_->write_point(id, timestamp, value);
+}
+
 bool StorageEngine::write_batch(const std::vector<TimeSeriesPoint>& points) {
     return pimpl_->write_batch(points);
 }
 
+bool StorageEngine::write_columns(SymbolId id,
+                                  std::span<const int64_t> timestamps,
+                                  std::span<const double> values) {
+    return pimpl_->write_columns(id, timestamps, values);
+}
+
 bool StorageEngine::flush() {
     return pimpl_->flush();
 }
 
+RangeCursor StorageEngine::open_cursor(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end) {
+    
+    // Memory is read before disk: a flush releases its snapshot only after
+    // the segment is visible, so every point is seen at least once
+    auto memory_points = pimpl_->memory_layer->get_range(symbol, start, end);
+    auto disk_cursor = pimpl_->disk_layer->open_cursor(symbol, start, end);
+    return RangeCursor(std::make_unique<RangeCursor::Impl>(
+        std::move(memory_points), std::move(disk_cursor)));
+}
+
+RangeCursor StorageEngine::open_cursor(
+    SymbolId id,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end) {
+    
+    auto memory_points = pimpl_->memory_layer->get_range(id, start, end);
+    auto disk_cursor = pimpl_->disk_layer->open_cursor(id, start, end);
+    return RangeCursor(std::make_unique<RangeCursor::Impl>(
+        std::move(memory_points), std::move(disk_cursor)));
+}
+
+std::vector<TimeSeriesPoint> StorageEngine::read_range(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end) {
+    
+    metrics::ScopedTimer timer(pimpl_->read_latency);
+    auto cursor = open_cursor(symbol, start, end);
+    return collect(cursor);
+}
+
 std::vector<TimeSeriesPoint> StorageEngine::read_range(
+    SymbolId id,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end) {
+    
+    metrics::ScopedTimer timer(pimpl_->read_latency);
+    auto cursor = open_cursor(id, start, end);
+    return collect(cursor);
+}
+
+void StorageEngine::read_range_multi(
+    const std::vector<std::string>& symbols,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end,
+    const SymbolRangeCallback& callback) {
+    
+    // Symbols are claimed one at a time so slow ones don't hold up a
+    // statically assigned share; the caller drains alongside the pool
+    std::atomic<size_t> next_symbol{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto drain = [&] {
+        for (size_t i; (i = next_symbol.fetch_add(1)) < symbols.size();) {
+            try {
+                callback(symbols[i], read_range(symbols[i], start, end));
+            } catch (...) {
+                std::lock_guard lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next_symbol = symbols.size();
+            }
+        }
+    };
+    
+    if (symbols.size() > 1) {
+        // Only helpers that start before the caller finishes draining are
+        // waited for; later ones find the call closed and return untouched.
+        // A call from a pool worker therefore never waits on tasks queued
+        // behind itself.
+        struct Helpers {
+            std::mutex mutex;
+            std::condition_variable cv;
+            size_t running = 0;
+            bool closed = false;
+        };
+        auto state = std::make_shared<Helpers>();
+        auto& pool = pimpl_->scan_workers();
+        const size_t helpers = std::min(pool.size(), symbols.size() - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            pool.submit([state, &drain] {
+                {
+                    std::lock_guard lock(state->mutex);
+                    if (state->closed) return;
+                    ++state->running;
+                }
+                drain();
+                std::lock_guard lock(state->mutex);
+                --state->running;
+                state->cv.notify_all();
+            });
+        }
+        drain();
+        std::unique_lock lock(state->mutex);
+        state->closed = true;
+        state->cv.wait(lock, [&] { return state->running == 0; });
+    } else {
+        drain();
+    }
+    
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::vector<Bar> StorageEngine::read_bars(
     const std::string& symbol,
+    std::chrono::seconds interval,
     std::chrono::system_clock::time_point start,
     std::chrono::system_clock::time_point end) {
-    return pimpl_->read_range(symbol, start, end);
+    
+    const auto first = rollup::bucket_start(start, interval);
+    const auto last = rollup::bucket_end(end, interval);
+    if (!pimpl_->has_rollup(interval)) {
+        return rollup::build(read_range(symbol, first, last), interval);
+    }
+    
+    // Stored bars cover the ticks on disk, except snapshots whose bars
+    // failed to store. Memory ticks past the newest one on disk are folded
+    // in; buckets holding those snapshots, or memory ticks that reach back
+    // and may rewrite a stored one, are recomputed from the merged range.
+    auto lock = metrics::lock_shared(pimpl_->rollup_mutex, pimpl_->lock_wait);
+    const auto on_disk = pimpl_->disk_layer->get_end_time(symbol);
+    std::vector<std::chrono::system_clock::time_point> dirty;
+    for (const auto& pending : pimpl_->pending_rollups) {
+        if (pending.symbol != symbol) continue;
+        for (const auto& point : pending.points) {
+            if (point.timestamp >= first && point.timestamp <= last) {
+                dirty.push_back(rollup::bucket_start(point.timestamp, interval));
+            }
+        }
+    }
+    
+    // Frozen and active chunks may interleave, so restore time order
+    std::vector<std::pair<int64_t, double>> memory;
+    pimpl_->memory_layer->scan_range(symbol, first, last,
+        [&](std::span<const int64_t> timestamps, std::span<const double> values) {
+            for (size_t i = 0; i < timestamps.size(); ++i) {
+                memory.emplace_back(timestamps[i], values[i]);
+            }
+        });
+    if (!std::is_sorted(memory.begin(), memory.end())) {
+        std::sort(memory.begin(), memory.end());
+    }
+    std::vector<Bar> recent;
+    for (const auto& [ticks, value] : memory) {
+        const auto timestamp = std::chrono::system_clock::time_point(std::chrono::system_clock::duration(ticks));
+        if (on_disk && timestamp <= *on_disk) {
+            dirty.push_back(rollup::bucket_start(timestamp, interval));
+        } else {
+            rollup::add(recent, timestamp, value, interval);
+        }
+    }
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    auto in_dirty = [&](const Bar& bar) {
+        return std::binary_search(dirty.begin(), dirty.end(), bar.start);
+    };
+    
+    auto stored = rollup::from_points(pimpl_->disk_layer->read_range(
+        rollup::series_name(symbol, interval), first, last));
+    std::erase_if(stored, in_dirty);
+    std::erase_if(recent, in_dirty);
+    auto bars = rollup::merge(stored, recent);
+    
+    std::vector<Bar> recomputed;
+    for_each_bucket_run(dirty, interval, [&](auto bucket_first, auto bucket_last) {
+        auto built = rollup::build(read_range(symbol, bucket_first, bucket_last), interval);
+        recomputed.insert(recomputed.end(), built.begin(), built.end());
+    });
+    return rollup::merge(bars, recomputed);
+}
+
+std::optional<double> StorageEngine::aggregate(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end,
+    AggregateOp op) {
+    
+    metrics::ScopedTimer timer(pimpl_->read_latency);
+    
+    // Memory is read before disk, as in open_cursor. Its points override
+    // disk points with the same timestamp, so those are skipped on disk.
+    auto memory_points = pimpl_->memory_layer->get_range(symbol, start, end);
+    std::vector<int64_t> shadowed;
+    shadowed.reserve(memory_points.size());
+    for (const auto& point : memory_points) {
+        shadowed.push_back(point.timestamp.time_since_epoch().count());
+    }
+    
+    auto stats = pimpl_->disk_layer->aggregate(symbol, start, end, shadowed);
+    for (const auto& point : memory_points) {
+        stats.add(point.value);
+    }
+    
+    switch (op) {
+    case AggregateOp::Count:
+        return static_cast<double>(stats.count);
+    case AggregateOp::Sum:
+        return stats.sum;
+    case AggregateOp::Min:
+        return stats.count ? std::optional<double>(stats.min) : std::nullopt;
+    case AggregateOp::Max:
+        return stats.count ? std::optional<double>(stats.max) : std::nullopt;
+    case AggregateOp::Mean:
+        return stats.count ? std::optional<double>(stats.sum / stats.count) : std::nullopt;
+    }
+    return std::nullopt;
+}
+
+analytics::RollingResult StorageEngine::analyze(
+    const std::string& symbol,
+    std::chrono::system_clock::time_point start,
+    std::chrono::system_clock::time_point end,
+    const analytics::RollingSpec& spec) {
+    
+    const bool with_volume = !spec.volume_symbol.empty();
+    analytics::RollingAnalyzer analyzer(spec, with_volume);
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    std::vector<double> volumes;
+    
+    auto prices = open_cursor(symbol, start, end);
+    std::vector<TimeSeriesPoint> batch;
+    if (!with_volume) {
+        while (prices.next(batch)) {
+            timestamps.clear();
+            values.clear();
+            for (const auto& point : batch) {
+                timestamps.push_back(point.timestamp.time_since_epoch().count());
+                values.push_back(point.value);
+            }
+            analyzer.push(timestamps, values);
+        }
+        return analyzer.take_result();
+    }
+    
+    // Inner join of the two time-ordered streams
+    auto volume_cursor = open_cursor(spec.volume_symbol, start, end);
+    std::vector<TimeSeriesPoint> volume_batch;
+    size_t volume_pos = 0;
+    bool volume_done = false;
+    while (prices.next(batch)) {
+        timestamps.clear();
+        values.clear();
+        volumes.clear();
+        for (const auto& point : batch) {
+            while (!volume_done) {
+                if (volume_pos == volume_batch.size()) {
+                    volume_done = !volume_cursor.next(volume_batch);
+                    volume_pos = 0;
+                    continue;
+                }
+                if (volume_batch[volume_pos].timestamp >= point.timestamp) break;
+                ++volume_pos;
+            }
+            if (volume_done) break;
+            if (volume_batch[volume_pos].timestamp == point.timestamp) {
+                timestamps.push_back(point.timestamp.time_since_epoch().count());
+                values.push_back(point.value);
+                volumes.push_back(volume_batch[volume_pos].value);
+            }
+        }
+        analyzer.push(timestamps, values, volumes);
+        if (volume_done) break;
+    }
+    return analyzer.take_result();
 }
 
 std::optional<TimeSeriesPoint> StorageEngine::get_latest(const std::string& symbol) {
     return pimpl_->get_latest(symbol);
 }
 
+std::optional<TimeSeriesPoint> StorageEngine::get_latest(SymbolId id) {
+    return pimpl_->latest.get(id);
+}
+
+Subscription StorageEngine::subscribe(const std::vector<std::string>& symbols,
+                                      const SubscriptionOptions& options) {
+    std::vector<SymbolId> ids;
+    ids.reserve(symbols.size());
+    for (const auto& symbol : symbols) {
+        ids.push_back(pimpl_->catalog->intern(symbol));
+    }
+    return subscribe(ids, options);
+}
+
+Subscription StorageEngine::subscribe(std::span<const SymbolId> symbols, const SubscriptionOptions& options) {
+    return pimpl_->subscriptions.subscribe(symbols, options);
+}
+
+SymbolId StorageEngine::intern_symbol(const std::string& symbol) {
+    check_symbol_name(symbol);
+    return pimpl_->catalog->intern(symbol);
+}
+
+std::optional<SymbolId> StorageEngine::find_symbol(const std::string& symbol) const {
+    return pimpl_->catalog->find(symbol);
+}
+
+const std::string& StorageEngine::symbol_name(SymbolId id) const {
+    return pimpl_->catalog->name(id);
+}
+
 std::unordered_set<std::string> StorageEngine::get_symbols() const {
     return pimpl_->get_symbols();
 }
@@ -225,12 +1046,26 @@ void StorageEngine::optimize() {
 }
 
 EngineStats StorageEngine::get_stats() const {
+    const auto disk = pimpl_->disk_layer->get_stats();
     return EngineStats{
         .total_points = pimpl_->get_total_points(),
-        .cache_hits = pimpl_->cache_hits.load(),
-        .cache_misses = pimpl_->cache_misses.load(),
+        .cache_hits = pimpl_->disk_layer->get_cache_hits(),
+        .cache_misses = pimpl_->disk_layer->get_cache_misses(),
         .cache_hit_ratio = pimpl_->get_cache_hit_ratio(),
-        .storage_size_bytes = pimpl_->get_storage_size()
+        .storage_size_bytes = pimpl_->get_storage_size(),
+        .memory_bytes = pimpl_->memory_layer->memory_usage(),
+        .rejected_points = pimpl_->rejected_points.value(),
+        .bytes_read = disk.bytes_read,
+        .bytes_written = disk.bytes_written,
+        .write_latency = pimpl_->write_latency.summary(),
+        .read_latency = pimpl_->read_latency.summary(),
+        .flush_latency = pimpl_->flush_latency.summary(),
+        .compaction_latency = disk.compaction,
+        .decode_latency = disk.decode,
+        .engine_lock_wait = pimpl_->lock_wait.summary(),
+        .memory_lock_wait = pimpl_->memory_layer->lock_wait(),
+        .disk_lock_wait = disk.lock_wait,
+        .simd_level = utils::simd_level_name(utils::simd_level())
     };
 }
 
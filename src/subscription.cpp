@@ -0,0 +1,270 @@
+#include "findata_engine/subscription.hpp"
+#include "findata_engine/utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <shared_mutex>
+#include <mutex>
+#include <thread>
+
+namespace findata_engine {
+
+namespace {
+
+constexpr int64_t NO_TIMESTAMP = std::numeric_limits<int64_t>::min();
+
+// Test-and-test-and-set lock; held by one writer for the few pushes it
+// makes into a subscriber. Yields while waiting in case the holder was
+// preempted.
+class SpinGuard {
+public:
+    explicit SpinGuard(std::atomic_flag& flag) : flag_(flag) {
+        while (flag_.test_and_set(std::memory_order_acquire)) {
+            while (flag_.test(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    ~SpinGuard() { flag_.clear(std::memory_order_release); }
+
+    SpinGuard(const SpinGuard&) = delete;
+    SpinGuard& operator=(const SpinGuard&) = delete;
+
+private:
+    std::atomic_flag& flag_;
+};
+
+// Newest tick of one conflated symbol. Written by the producer holding the
+// subscriber's lock, read by the consumer as a seqlock.
+struct LatestSlot {
+    std::atomic<uint64_t> sequence{0}; // Odd while a write is in progress
+    std::atomic<int64_t> timestamp{NO_TIMESTAMP};
+    std::atomic<double> value{0.0};
+    std::atomic<double> vwap{0.0};
+    std::atomic<bool> changed{false};  // Queued in Subscriber::changed
+};
+
+struct Subscriber {
+    std::vector<SymbolId> symbols; // Sorted; a symbol's index is its slot
+    std::optional<VwapSpec> vwap;
+    std::atomic_flag producing;    // Serializes writers, never the consumer
+    std::atomic<size_t> dropped{0};
+
+    // Unconflated: every tick, in publish order
+    std::unique_ptr<utils::SpscRing<Tick>> ticks;
+
+    // Conflated: the newest tick per slot and the slots changed since the
+    // last poll. A slot is queued only when its flag goes up, so the queue
+    // holds each slot at most once and can never fill.
+    std::unique_ptr<LatestSlot[]> latest;
+    std::unique_ptr<utils::SpscRing<uint32_t>> changed;
+    std::vector<uint64_t> delivered; // Consumer only: sequence last polled per slot
+
+    // VWAP accumulators, producer only
+    int64_t price_ts = NO_TIMESTAMP;
+    int64_t volume_ts = NO_TIMESTAMP;
+    int64_t paired_ts = NO_TIMESTAMP;
+    double price = 0.0;
+    double volume = 0.0;
+    double notional = 0.0;
+    double total_volume = 0.0;
+
+    Subscriber(std::span<const SymbolId> ids, const SubscriptionOptions& options)
+        : symbols(ids.begin(), ids.end()), vwap(options.vwap) {
+        if (vwap) {
+            symbols.push_back(vwap->price);
+            symbols.push_back(vwap->volume);
+        }
+        std::sort(symbols.begin(), symbols.end());
+        symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+
+        if (options.conflate) {
+            latest = std::make_unique<LatestSlot[]>(symbols.size());
+            changed = std::make_unique<utils::SpscRing<uint32_t>>(symbols.size());
+            delivered.assign(symbols.size(), 0);
+        } else {
+            ticks = std::make_unique<utils::SpscRing<Tick>>(options.capacity);
+        }
+    }
+
+    // A price and a volume at the same timestamp count once, whichever lands
+    // second; pairs older than the last one counted are ignored
+    double apply_vwap(SymbolId id, int64_t timestamp, double value) {
+        if (!vwap) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        if (id == vwap->price) {
+            price_ts = timestamp;
+            price = value;
+        }
+        if (id == vwap->volume) {
+            volume_ts = timestamp;
+            volume = value;
+        }
+        if (price_ts == volume_ts && price_ts > paired_ts) {
+            notional += price * volume;
+            total_volume += volume;
+            paired_ts = price_ts;
+        }
+        return total_volume > 0.0 ? notional / total_volume : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Caller holds producing
+    void deliver(uint32_t slot, SymbolId id, int64_t timestamp, double value) {
+        const double running = apply_vwap(id, timestamp, value);
+        if (ticks) {
+            if (!ticks->push(Tick{.symbol = id, .timestamp = timestamp, .value = value, .vwap = running})) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        // As with get_latest, an older write never replaces a newer one
+        auto& entry = latest[slot];
+        if (timestamp < entry.timestamp.load(std::memory_order_relaxed)) return;
+        const uint64_t sequence = entry.sequence.load(std::memory_order_relaxed);
+        entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.timestamp.store(timestamp, std::memory_order_relaxed);
+        entry.value.store(value, std::memory_order_relaxed);
+        entry.vwap.store(running, std::memory_order_relaxed);
+        entry.sequence.store(sequence + 2, std::memory_order_release);
+        if (!entry.changed.exchange(true, std::memory_order_acq_rel)) {
+            changed->push(slot);
+        }
+    }
+
+    size_t poll(std::span<Tick> out) {
+        if (ticks) {
+            return ticks->pop(out);
+        }
+
+        size_t count = 0;
+        uint32_t slot = 0;
+        while (count < out.size() && changed->pop(slot)) {
+            // Lowered before reading, so a write racing with this poll
+            // queues the slot again rather than going unseen
+            auto& entry = latest[slot];
+            entry.changed.exchange(false, std::memory_order_acq_rel);
+
+            Tick tick{.symbol = symbols[slot]};
+            uint64_t sequence = 0;
+            while (true) {
+                sequence = entry.sequence.load(std::memory_order_acquire);
+                if (sequence & 1) continue;
+                tick.timestamp = entry.timestamp.load(std::memory_order_relaxed);
+                tick.value = entry.value.load(std::memory_order_relaxed);
+                tick.vwap = entry.vwap.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (entry.sequence.load(std::memory_order_relaxed) == sequence) break;
+            }
+
+            // The racing write may already have been read on the last pass
+            if (sequence == delivered[slot]) continue;
+            delivered[slot] = sequence;
+            out[count++] = tick;
+        }
+        return count;
+    }
+};
+
+} // namespace
+
+struct SubscriptionHub::State {
+    struct Listener {
+        std::shared_ptr<Subscriber> subscriber;
+        uint32_t slot;
+    };
+
+    // Writers of a symbol share its lock; only (un)subscribing takes it
+    // exclusively. count lets a publish skip the lock when nobody listens.
+    struct Listeners {
+        std::shared_mutex mutex;
+        std::atomic<size_t> count{0};
+        std::vector<Listener> entries;
+    };
+
+    SymbolTable<Listeners> listeners;
+    std::atomic<size_t> subscriptions{0};
+
+    void add(const std::shared_ptr<Subscriber>& subscriber) {
+        for (uint32_t slot = 0; slot < subscriber->symbols.size(); ++slot) {
+            auto& symbol = listeners.get_or_create(subscriber->symbols[slot]);
+            std::unique_lock lock(symbol.mutex);
+            symbol.entries.push_back(Listener{subscriber, slot});
+            symbol.count.store(symbol.entries.size(), std::memory_order_release);
+        }
+        subscriptions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void remove(const Subscriber& subscriber) {
+        for (SymbolId id : subscriber.symbols) {
+            auto* symbol = listeners.find(id);
+            if (symbol == nullptr) continue;
+            std::unique_lock lock(symbol->mutex);
+            std::erase_if(symbol->entries, [&](const Listener& listener) {
+                return listener.subscriber.get() == &subscriber;
+            });
+            symbol->count.store(symbol->entries.size(), std::memory_order_release);
+        }
+        subscriptions.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+struct Subscription::Impl {
+    std::shared_ptr<Subscriber> subscriber;
+    std::weak_ptr<SubscriptionHub::State> hub;
+
+    ~Impl() {
+        if (auto state = hub.lock()) {
+            state->remove(*subscriber);
+        }
+    }
+};
+
+Subscription::Subscription(std::unique_ptr<Impl> impl) : pimpl_(std::move(impl)) {}
+Subscription::Subscription(Subscription&&) noexcept = default;
+Subscription& Subscription::operator=(Subscription&&) noexcept = default;
+Subscription::~Subscription() = default;
+
+size_t Subscription::poll(std::span<Tick> out) {
+    return pimpl_->subscriber->poll(out);
+}
+
+size_t Subscription::dropped() const {
+    return pimpl_->subscriber->dropped.load(std::memory_order_relaxed);
+}
+
+SubscriptionHub::SubscriptionHub() : state_(std::make_shared<State>()) {}
+SubscriptionHub::~SubscriptionHub() = default;
+
+Subscription SubscriptionHub::subscribe(std::span<const SymbolId> symbols, const SubscriptionOptions& options) {
+    auto subscriber = std::make_shared<Subscriber>(symbols, options);
+    state_->add(subscriber);
+    return Subscription(std::unique_ptr<Subscription::Impl>(
+        new Subscription::Impl{.subscriber = std::move(subscriber), .hub = state_}));
+}
+
+bool SubscriptionHub::active() const {
+    return state_->subscriptions.load(std::memory_order_relaxed) > 0;
+}
+
+void SubscriptionHub::publish(SymbolId id, int64_t timestamp, double value) {
+    publish(id, std::span<const int64_t>(&timestamp, 1), std::span<const double>(&value, 1));
+}
+
+void SubscriptionHub::publish(SymbolId id, std::span<const int64_t> timestamps, std::span<const double> values) {
+    auto* symbol = state_->listeners.find(id);
+    if (symbol == nullptr || symbol->count.load(std::memory_order_acquire) == 0) return;
+
+    std::shared_lock lock(symbol->mutex);
+    const size_t count = std::min(timestamps.size(), values.size());
+    for (const auto& listener : symbol->entries) {
+        SpinGuard guard(listener.subscriber->producing);
+        for (size_t i = 0; i < count; ++i) {
+            listener.subscriber->deliver(listener.slot, id, timestamps[i], values[i]);
+        }
+    }
+}
+
+} // namespace findata_engine
@@ -0,0 +1,201 @@
+#include "findata_engine/symbol_catalog.hpp"
+#include "findata_engine/utils.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace findata_engine {
+
+namespace {
+
+// Record layout: [uint32 id][uint16 name_len][name bytes][uint32 crc32 of the preceding fields]
+constexpr size_t RECORD_FIXED_SIZE = sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t);
+
+// Name lookups hash the string once; shards keep interning of new symbols
+// from blocking lookups of unrelated ones
+constexpr size_t NUM_SHARDS = 64;
+
+struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+};
+
+std::vector<uint8_t> encode_record(SymbolId id, std::string_view name) {
+    std::vector<uint8_t> record(RECORD_FIXED_SIZE + name.size());
+    const auto name_len = static_cast<uint16_t>(name.size());
+    uint8_t* ptr = record.data();
+    std::memcpy(ptr, &id, sizeof(id));
+    std::memcpy(ptr + sizeof(id), &name_len, sizeof(name_len));
+    std::memcpy(ptr + sizeof(id) + sizeof(name_len), name.data(), name.size());
+    const size_t body = record.size() - sizeof(uint32_t);
+    const uint32_t crc = utils::crc32(record.data(), body);
+    std::memcpy(record.data() + body, &crc, sizeof(crc));
+    return record;
+}
+
+} // namespace
+
+struct SymbolCatalog::Impl {
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, SymbolId, NameHash, std::equal_to<>> ids;
+    };
+
+    std::array<Shard, NUM_SHARDS> shards;
+    SymbolTable<std::string> names;
+    std::atomic<SymbolId> next_id{0};
+
+    std::mutex file_mutex;
+    int fd = -1; // -1 for an in-memory catalog
+
+    Impl() = default;
+
+    explicit Impl(const std::filesystem::path& file) {
+        const size_t valid = load(file);
+
+        // Drop a torn tail so later appends stay readable
+        std::error_code ec;
+        if (std::filesystem::exists(file, ec) && std::filesystem::file_size(file, ec) != valid) {
+            std::filesystem::resize_file(file, valid);
+        }
+        fd = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+            throw std::runtime_error("Failed to open symbol catalog: " + file.string());
+        }
+    }
+
+    ~Impl() {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
+    // Returns the length of the intact prefix
+    size_t load(const std::filesystem::path& file) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) return 0;
+
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+        const uint8_t* ptr = data.data();
+        const uint8_t* end = data.data() + data.size();
+        while (static_cast<size_t>(end - ptr) >= RECORD_FIXED_SIZE) {
+            SymbolId id;
+            uint16_t name_len;
+            std::memcpy(&id, ptr, sizeof(id));
+            std::memcpy(&name_len, ptr + sizeof(id), sizeof(name_len));
+            if (static_cast<size_t>(end - ptr) < RECORD_FIXED_SIZE + name_len) break;
+
+            const size_t body = RECORD_FIXED_SIZE - sizeof(uint32_t) + name_len;
+            uint32_t crc;
+            std::memcpy(&crc, ptr + body, sizeof(crc));
+            if (utils::crc32(ptr, body) != crc || id >= SymbolTable<std::string>::CAPACITY) break;
+
+            std::string name(reinterpret_cast<const char*>(ptr + sizeof(id) + sizeof(name_len)), name_len);
+            auto& shard = shard_for(name);
+            if (shard.ids.emplace(name, id).second) {
+                names.get_or_create(id, std::move(name));
+            }
+            next_id = std::max<SymbolId>(next_id, id + 1);
+            ptr += body + sizeof(crc);
+        }
+        return static_cast<size_t>(ptr - data.data());
+    }
+
+    Shard& shard_for(std::string_view name) {
+        return shards[NameHash{}(name) % NUM_SHARDS];
+    }
+
+    const Shard& shard_for(std::string_view name) const {
+        return shards[NameHash{}(name) % NUM_SHARDS];
+    }
+
+    void persist(SymbolId id, std::string_view name) {
+        if (fd == -1) return;
+
+        auto record = encode_record(id, name);
+        std::lock_guard lock(file_mutex);
+        size_t written = 0;
+        while (written < record.size()) {
+            ssize_t n = ::write(fd, record.data() + written, record.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Failed to append to symbol catalog");
+            }
+            written += static_cast<size_t>(n);
+        }
+        if (fdatasync(fd) != 0) {
+            throw std::runtime_error("Failed to sync symbol catalog");
+        }
+    }
+};
+
+SymbolCatalog::SymbolCatalog() : pimpl_(std::make_unique<Impl>()) {}
+
+SymbolCatalog::SymbolCatalog(const std::filesystem::path& file)
+    : pimpl_(std::make_unique<Impl>(file)) {}
+
+SymbolCatalog::~SymbolCatalog() = default;
+
+SymbolId SymbolCatalog::intern(std::string_view name) {
+    auto& shard = pimpl_->shard_for(name);
+    {
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.ids.find(name);
+        if (it != shard.ids.end()) {
+            return it->second;
+        }
+    }
+
+    if (name.size() > std::numeric_limits<uint16_t>::max()) {
+        throw std::runtime_error("Symbol name too long");
+    }
+
+    std::unique_lock lock(shard.mutex);
+    auto it = shard.ids.find(name);
+    if (it != shard.ids.end()) {
+        return it->second;
+    }
+
+    // A failed append leaves the id unused rather than handing it out twice
+    const SymbolId id = pimpl_->next_id.fetch_add(1);
+    if (id >= SymbolTable<std::string>::CAPACITY) {
+        throw std::runtime_error("Symbol catalog is full");
+    }
+    pimpl_->persist(id, name);
+    pimpl_->names.get_or_create(id, name);
+    shard.ids.emplace(std::string(name), id);
+    return id;
+}
+
+std::optional<SymbolId> SymbolCatalog::find(std::string_view name) const {
+    const auto& shard = pimpl_->shard_for(name);
+    std::shared_lock lock(shard.mutex);
+    auto it = shard.ids.find(name);
+    if (it == shard.ids.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+const std::string& SymbolCatalog::name(SymbolId id) const {
+    const std::string* name = pimpl_->names.find(id);
+    if (name == nullptr) {
+        throw std::out_of_range("Unknown symbol id " + std::to_string(id));
+    }
+    return *name;
+}
+
+SymbolId SymbolCatalog::size() const {
+    return pimpl_->next_id.load(std::memory_order_acquire);
+}
+
+} // namespace findata_engine
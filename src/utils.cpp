@@ -1,91 +1,452 @@
 #include "findata_engine/utils.hpp"
+#include "simd_kernels.hpp"
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <immintrin.h>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <stdexcept>
+#include <array>
 
 namespace findata_engine {
 namespace utils {
 
-// SIMD-optimized compression for numerical data
-std::vector<uint8_t> compress_doubles(std::span<const double> data) {
-    if (data.empty()) return {};
+namespace {
+
+// MSB-first bit stream used by the Gorilla codecs
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
     
-    const size_t num_doubles = data.size();
-    std::vector<uint8_t> compressed;
-    compressed.reserve(num_doubles * sizeof(double));
-
-    // Write size first
-    compressed.insert(compressed.end(), 
-        reinterpret_cast<const uint8_t*>(&num_doubles),
-        reinterpret_cast<const uint8_t*>(&num_doubles) + sizeof(num_doubles));
-
-    // Use delta encoding with SIMD operations
-    alignas(32) double prev_values[4] = {0.0, 0.0, 0.0, 0.0};
-    const size_t vec_size = 4;
-    const size_t num_vectors = num_doubles / vec_size;
-    
-    for (size_t i = 0; i < num_vectors; ++i) {
-        __m256d curr = _mm256_loadu_pd(data.data() + i * vec_size);
-        __m256d prev = _mm256_load_pd(prev_values);
-        __m256d delta = _mm256_sub_pd(curr, prev);
-        
-        // Store deltas
-        alignas(32) double deltas[4];
-        _mm256_store_pd(deltas, delta);
-        
-        // Store raw bytes of deltas
-        for (size_t j = 0; j < vec_size; ++j) {
-            compressed.insert(compressed.end(),
-                reinterpret_cast<const uint8_t*>(&deltas[j]),
-                reinterpret_cast<const uint8_t*>(&deltas[j]) + sizeof(double));
+    // Appends the low `count` bits of value, count <= 64
+    void write(uint64_t value, int count) {
+        if (count > 32) {
+            write(value >> 32, count - 32);
+            count = 32;
+        }
+        acc_ = (acc_ << count) | (value & low_mask(count));
+        bits_ += count;
+        while (bits_ >= 8) {
+            bits_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> bits_));
         }
-        
-        _mm256_store_pd(prev_values, curr);
     }
     
-    // Handle remaining elements
-    for (size_t i = num_vectors * vec_size; i < num_doubles; ++i) {
-        double delta = data[i] - prev_values[0];
-        prev_values[0] = data[i];
-        
-        compressed.insert(compressed.end(),
-            reinterpret_cast<const uint8_t*>(&delta),
-            reinterpret_cast<const uint8_t*>(&delta) + sizeof(double));
+    void flush() {
+        if (bits_ > 0) {
+            out_.push_back(static_cast<uint8_t>(acc_ << (8 - bits_)));
+            bits_ = 0;
+        }
+    }
+    
+    static uint64_t low_mask(int count) {
+        return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+    }
+    
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_ = 0;
+    int bits_ = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, const uint8_t* end) : ptr_(data), end_(end) {}
+    
+    uint64_t read(int count) {
+        if (count > 32) {
+            uint64_t high = read(count - 32);
+            return (high << 32) | read(32);
+        }
+        while (bits_ < count) {
+            if (ptr_ == end_) {
+                throw std::runtime_error("Truncated compressed stream");
+            }
+            acc_ = (acc_ << 8) | *ptr_++;
+            bits_ += 8;
+        }
+        bits_ -= count;
+        return (acc_ >> bits_) & BitWriter::low_mask(count);
     }
     
+    bool read_bit() { return read(1) != 0; }
+    
+private:
+    const uint8_t* ptr_;
+    const uint8_t* end_;
+    uint64_t acc_ = 0;
+    int bits_ = 0;
+};
+
+void write_count(std::vector<uint8_t>& out, uint64_t count) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&count);
+    out.insert(out.end(), bytes, bytes + sizeof(count));
+}
+
+uint64_t read_count(std::span<const uint8_t> data) {
+    uint64_t count;
+    if (data.size() < sizeof(count)) {
+        throw std::runtime_error("Truncated compressed stream");
+    }
+    std::memcpy(&count, data.data(), sizeof(count));
+    return count;
+}
+
+// Reads a stream's count header and checks it against the bits that follow:
+// the first value takes 64 bits and every later one at least one, so a
+// corrupt header can't ask for more output than the stream could describe
+uint64_t read_checked_count(std::span<const uint8_t> data) {
+    const uint64_t count = read_count(data);
+    const uint64_t bits = (data.size() - sizeof(count)) * 8;
+    if (count > 0 && (bits < 64 || count - 1 > bits - 64)) {
+        throw std::runtime_error("Truncated compressed stream");
+    }
+    return count;
+}
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+// Delta-of-delta buckets: control prefix, then a zigzag payload of `bits`
+struct DodBucket {
+    uint64_t prefix;
+    int prefix_bits;
+    int bits;
+};
+constexpr DodBucket DOD_BUCKETS[] = {
+    {0b10, 2, 7},
+    {0b110, 3, 9},
+    {0b1110, 4, 12},
+    {0b11110, 5, 32},
+    {0b11111, 5, 64},
+};
+
+} // namespace
+
+void prefix_sum_scalar(std::span<int64_t> data) {
+    uint64_t acc = 0;
+    for (auto& v : data) {
+        acc += static_cast<uint64_t>(v);
+        v = static_cast<int64_t>(acc);
+    }
+}
+
+void prefix_xor_scalar(std::span<uint64_t> data) {
+    uint64_t acc = 0;
+    for (auto& v : data) {
+        acc ^= v;
+        v = acc;
+    }
+}
+
+namespace {
+
+struct KernelSet {
+    SimdLevel level;
+    void (*prefix_sum)(std::span<int64_t>);
+    void (*prefix_xor)(std::span<uint64_t>);
+};
+
+// Adapts a pointer-and-count kernel to the span signature
+template<typename T, void (*kernel)(T*, size_t)>
+void on_span(std::span<T> data) {
+    kernel(data.data(), data.size());
+}
+
+constexpr KernelSet SCALAR_KERNELS{SimdLevel::Scalar, prefix_sum_scalar, prefix_xor_scalar};
+#ifdef FINDATA_HAVE_AVX2
+constexpr KernelSet AVX2_KERNELS{SimdLevel::Avx2,
+    on_span<int64_t, kernels::prefix_sum_avx2>, on_span<uint64_t, kernels::prefix_xor_avx2>};
+#endif
+#ifdef FINDATA_HAVE_AVX512
+constexpr KernelSet AVX512_KERNELS{SimdLevel::Avx512,
+    on_span<int64_t, kernels::prefix_sum_avx512>, on_span<uint64_t, kernels::prefix_xor_avx512>};
+#endif
+
+const KernelSet* kernel_set(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar:
+        return &SCALAR_KERNELS;
+    case SimdLevel::Avx2:
+#ifdef FINDATA_HAVE_AVX2
+        return &AVX2_KERNELS;
+#else
+        return nullptr;
+#endif
+    case SimdLevel::Avx512:
+#ifdef FINDATA_HAVE_AVX512
+        return &AVX512_KERNELS;
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+// CPUID, plus the OS saving the wider registers, which libgcc's checks
+// include
+bool host_supports(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    switch (level) {
+    case SimdLevel::Scalar:
+        return true;
+    case SimdLevel::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case SimdLevel::Avx512:
+        return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return level == SimdLevel::Scalar;
+#endif
+}
+
+// Best supported level, capped by FINDATA_SIMD=scalar|avx2|avx512 so an
+// operator can rule out a variant without a rebuild
+const KernelSet* select_kernels() {
+    SimdLevel cap = SimdLevel::Avx512;
+    if (const char* env = std::getenv("FINDATA_SIMD")) {
+        const std::string_view name(env);
+        if (name == "scalar") {
+            cap = SimdLevel::Scalar;
+        } else if (name == "avx2") {
+            cap = SimdLevel::Avx2;
+        } else if (name != "avx512") {
+            fprintf(stderr, "Ignoring unknown FINDATA_SIMD=%s\n", env);
+        }
+    }
+    for (auto level : {SimdLevel::Avx512, SimdLevel::Avx2}) {
+        if (level <= cap && simd_supported(level)) {
+            return kernel_set(level);
+        }
+    }
+    return &SCALAR_KERNELS;
+}
+
+std::atomic<const KernelSet*>& active_kernels() {
+    static std::atomic<const KernelSet*> active{select_kernels()};
+    return active;
+}
+
+const KernelSet& kernels_for_call() {
+    return *active_kernels().load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+bool simd_supported(SimdLevel level) {
+    return kernel_set(level) != nullptr && host_supports(level);
+}
+
+SimdLevel simd_level() {
+    return kernels_for_call().level;
+}
+
+void set_simd_level(SimdLevel level) {
+    if (!simd_supported(level)) {
+        throw std::runtime_error(std::string("SIMD level not supported on this host: ") + simd_level_name(level));
+    }
+    active_kernels().store(kernel_set(level), std::memory_order_relaxed);
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::Avx2:
+        return "avx2";
+    case SimdLevel::Avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+void prefix_sum(std::span<int64_t> data) {
+    kernels_for_call().prefix_sum(data);
+}
+
+void prefix_xor(std::span<uint64_t> data) {
+    kernels_for_call().prefix_xor(data);
+}
+
+// Gorilla XOR encoding: each value is XORed with its predecessor and only
+// the meaningful bits are stored, reusing the previous bit window if it fits
+std::vector<uint8_t> compress_doubles(std::span<const double> data) {
+    std::vector<uint8_t> compressed;
+    compress_doubles(data, compressed);
     return compressed;
 }
 
-std::vector<double> decompress_doubles(const std::vector<uint8_t>& compressed_data) {
-    if (compressed_data.empty()) return {};
+void compress_doubles(std::span<const double> data, std::vector<uint8_t>& compressed) {
+    if (data.empty()) return;
     
-    // Read size
-    size_t num_doubles;
-    std::memcpy(&num_doubles, compressed_data.data(), sizeof(num_doubles));
+    compressed.reserve(compressed.size() + sizeof(uint64_t) + data.size() * 2);
+    write_count(compressed, data.size());
     
+    BitWriter writer(compressed);
+    uint64_t prev;
+    std::memcpy(&prev, &data[0], sizeof(prev));
+    writer.write(prev, 64);
+    
+    int prev_leading = -1;
+    int prev_trailing = 0;
+    for (size_t i = 1; i < data.size(); ++i) {
+        uint64_t curr;
+        std::memcpy(&curr, &data[i], sizeof(curr));
+        uint64_t x = curr ^ prev;
+        prev = curr;
+        
+        if (x == 0) {
+            writer.write(0, 1);
+            continue;
+        }
+        
+        int leading = std::min(__builtin_clzll(x), 31);
+        int trailing = __builtin_ctzll(x);
+        if (prev_leading >= 0 && leading >= prev_leading && trailing >= prev_trailing) {
+            // Fits inside the previous window
+            writer.write(0b10, 2);
+            writer.write(x >> prev_trailing, 64 - prev_leading - prev_trailing);
+        } else {
+            int meaningful = 64 - leading - trailing;
+            writer.write(0b11, 2);
+            writer.write(leading, 5);
+            writer.write(meaningful & 63, 6); // 64 is stored as 0
+            writer.write(x >> trailing, meaningful);
+            prev_leading = leading;
+            prev_trailing = trailing;
+        }
+    }
+    writer.flush();
+}
+
+std::vector<double> decompress_doubles(std::span<const uint8_t> compressed_data) {
     std::vector<double> decompressed;
-    decompressed.reserve(num_doubles);
+    decompress_doubles(compressed_data, decompressed);
+    return decompressed;
+}
+
+void decompress_doubles(std::span<const uint8_t> compressed_data, std::vector<double>& decompressed) {
+    decompressed.clear();
+    if (compressed_data.empty()) return;
+    
+    const uint64_t num_doubles = read_checked_count(compressed_data);
+    decompressed.resize(num_doubles);
+    if (num_doubles == 0) return;
+    
+    // XOR each residual back in as it is read. Unpacking into scratch for a
+    // vectorized prefix-XOR measured slower: the bit reader dominates and
+    // the extra pass over memory costs more than the XOR it saves.
+    BitReader reader(compressed_data.data() + sizeof(uint64_t),
+                     compressed_data.data() + compressed_data.size());
+    uint64_t prev = reader.read(64);
+    std::memcpy(&decompressed[0], &prev, sizeof(prev));
+    
+    int leading = 0;
+    int trailing = 0;
+    for (size_t i = 1; i < num_doubles; ++i) {
+        if (reader.read_bit()) {
+            if (reader.read_bit()) {
+                leading = static_cast<int>(reader.read(5));
+                int meaningful = static_cast<int>(reader.read(6));
+                if (meaningful == 0) meaningful = 64;
+                trailing = 64 - leading - meaningful;
+            }
+            prev ^= reader.read(64 - leading - trailing) << trailing;
+        }
+        std::memcpy(&decompressed[i], &prev, sizeof(prev));
+    }
+}
+
+// Gorilla delta-of-delta encoding: regular sampling costs one bit per point
+std::vector<uint8_t> compress_timestamps(std::span<const int64_t> timestamps) {
+    std::vector<uint8_t> compressed;
+    compress_timestamps(timestamps, compressed);
+    return compressed;
+}
+
+void compress_timestamps(std::span<const int64_t> timestamps, std::vector<uint8_t>& compressed) {
+    if (timestamps.empty()) return;
     
-    const uint8_t* ptr = compressed_data.data() + sizeof(num_doubles);
-    double prev_value = 0.0;
+    compressed.reserve(compressed.size() + sizeof(uint64_t) + timestamps.size());
+    write_count(compressed, timestamps.size());
     
-    for (size_t i = 0; i < num_doubles; ++i) {
-        double delta;
-        std::memcpy(&delta, ptr, sizeof(delta));
-        ptr += sizeof(delta);
+    BitWriter writer(compressed);
+    writer.write(static_cast<uint64_t>(timestamps[0]), 64);
+    
+    int64_t prev_delta = 0;
+    for (size_t i = 1; i < timestamps.size(); ++i) {
+        const int64_t delta = static_cast<int64_t>(
+            static_cast<uint64_t>(timestamps[i]) - static_cast<uint64_t>(timestamps[i - 1]));
+        const int64_t dod = static_cast<int64_t>(
+            static_cast<uint64_t>(delta) - static_cast<uint64_t>(prev_delta));
+        prev_delta = delta;
+        
+        if (dod == 0) {
+            writer.write(0, 1);
+            continue;
+        }
         
-        double value = prev_value + delta;
-        decompressed.push_back(value);
-        prev_value = value;
+        const uint64_t encoded = zigzag(dod);
+        for (const auto& bucket : DOD_BUCKETS) {
+            if (bucket.bits == 64 || encoded < (1ULL << bucket.bits)) {
+                writer.write(bucket.prefix, bucket.prefix_bits);
+                writer.write(encoded, bucket.bits);
+                break;
+            }
+        }
     }
+    writer.flush();
+}
+
+std::vector<int64_t> decompress_timestamps(std::span<const uint8_t> compressed) {
+    std::vector<int64_t> timestamps;
+    decompress_timestamps(compressed, timestamps);
+    return timestamps;
+}
+
+void decompress_timestamps(std::span<const uint8_t> compressed, std::vector<int64_t>& timestamps) {
+    timestamps.clear();
+    if (compressed.empty()) return;
     
-    return decompressed;
+    const uint64_t count = read_checked_count(compressed);
+    timestamps.resize(count);
+    if (count == 0) return;
+    
+    // Unpack delta-of-deltas into the output column after the base
+    // timestamp, then rebuild deltas and timestamps with two prefix sums
+    BitReader reader(compressed.data() + sizeof(uint64_t),
+                     compressed.data() + compressed.size());
+    timestamps[0] = static_cast<int64_t>(reader.read(64));
+    
+    for (size_t i = 1; i < count; ++i) {
+        // Count leading one bits of the control prefix (at most 4)
+        int ones = 0;
+        while (ones < 4 && reader.read_bit()) {
+            ++ones;
+        }
+        int64_t dod = 0;
+        if (ones > 0) {
+            int bits = DOD_BUCKETS[ones - 1].bits;
+            if (ones == 4) {
+                bits = reader.read_bit() ? DOD_BUCKETS[4].bits : DOD_BUCKETS[3].bits;
+            }
+            dod = unzigzag(reader.read(bits));
+        }
+        timestamps[i] = dod;
+    }
+    prefix_sum(std::span<int64_t>(timestamps).subspan(1));
+    prefix_sum(timestamps);
 }
 
-// Memory-mapped file implementation
 MemoryMappedFile::MemoryMappedFile(const std::string& path, size_t size)
     : size_(size), data_(nullptr), fd_(-1) {
     fd_ = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
@@ -107,6 +468,32 @@ MemoryMappedFile::MemoryMappedFile(const std::string& path, size_t size)
     }
 }
 
+MemoryMappedFile::MemoryMappedFile(const std::string& path)
+    : data_(nullptr), size_(0), fd_(-1), read_only_(true) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw std::runtime_error("Failed to stat file: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    
+    // The mapping keeps the pages alive, so the descriptor is not needed
+    if (size_ > 0) {
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            close(fd);
+            throw std::runtime_error("Failed to map file into memory: " + path);
+        }
+    }
+    close(fd);
+}
+
 MemoryMappedFile::~MemoryMappedFile() {
     if (data_ != nullptr) {
         munmap(data_, size_);
@@ -117,13 +504,16 @@ MemoryMappedFile::~MemoryMappedFile() {
 }
 
 void MemoryMappedFile::flush() {
-    if (data_ != nullptr) {
+    if (data_ != nullptr && !read_only_) {
         msync(data_, size_, MS_SYNC);
     }
 }
 
 void MemoryMappedFile::resize(size_t new_size) {
     if (new_size == size_) return;
+    if (read_only_) {
+        throw std::runtime_error("Cannot resize a read-only mapping");
+    }
     
     // Unmap current memory
     if (data_ != nullptr) {
@@ -149,19 +539,17 @@ std::vector<uint8_t> compress_time_series(const std::vector<TimeSeriesPoint>& po
     if (points.empty()) return {};
 
     // Extract timestamps and values
-    std::vector<int64_t> timestamp_deltas;
+    std::vector<int64_t> timestamps;
     std::vector<double> values;
     std::string prev_symbol;
     std::vector<size_t> symbol_indices;
     std::vector<std::string> unique_symbols;
 
-    timestamp_deltas.reserve(points.size());
+    timestamps.reserve(points.size());
     values.reserve(points.size());
     symbol_indices.reserve(points.size());
 
-    // Compute deltas for timestamps
-    auto prev_time = points[0].timestamp;
-    timestamp_deltas.push_back(prev_time.time_since_epoch().count());
+    timestamps.push_back(points[0].timestamp.time_since_epoch().count());
     values.push_back(points[0].value);
 
     // Handle first symbol
@@ -170,10 +558,8 @@ std::vector<uint8_t> compress_time_series(const std::vector<TimeSeriesPoint>& po
     prev_symbol = points[0].symbol;
 
     for (size_t i = 1; i < points.size(); ++i) {
-        auto delta = points[i].timestamp - prev_time;
-        timestamp_deltas.push_back(delta.count());
+        timestamps.push_back(points[i].timestamp.time_since_epoch().count());
         values.push_back(points[i].value);
-        prev_time = points[i].timestamp;
 
         // Handle symbols
         if (points[i].symbol != prev_symbol) {
@@ -191,9 +577,7 @@ std::vector<uint8_t> compress_time_series(const std::vector<TimeSeriesPoint>& po
     }
 
     // Compress components
-    auto compressed_timestamps = compress_doubles(std::span<const double>(
-        reinterpret_cast<const double*>(timestamp_deltas.data()),
-        timestamp_deltas.size()));
+    auto compressed_timestamps = compress_timestamps(timestamps);
     
     auto compressed_values = compress_doubles(std::span<const double>(values.data(), values.size()));
 
@@ -263,43 +647,21 @@ std::vector<TimeSeriesPoint> decompress_time_series(const std::vector<uint8_t>&
     std::memcpy(symbol_indices.data(), ptr, num_points * sizeof(size_t));
     ptr += num_points * sizeof(size_t);
 
-    // Read compressed data
-    std::vector<uint8_t> compressed_timestamps(ptr, ptr + timestamps_size);
+    // Decompress timestamps and values
+    auto timestamps = decompress_timestamps(std::span<const uint8_t>(ptr, timestamps_size));
     ptr += timestamps_size;
     
-    std::vector<uint8_t> compressed_values(ptr, ptr + values_size);
+    auto values = decompress_doubles(std::span<const uint8_t>(ptr, values_size));
     ptr += values_size;
 
-    // Decompress timestamps
-    auto timestamp_deltas_double = decompress_doubles(compressed_timestamps);
-    std::vector<int64_t> timestamp_deltas(timestamp_deltas_double.size());
-    for (size_t i = 0; i < timestamp_deltas_double.size(); ++i) {
-        timestamp_deltas[i] = static_cast<int64_t>(timestamp_deltas_double[i]);
-    }
-
-    // Reconstruct timestamps
-    std::vector<std::chrono::system_clock::time_point> timestamps;
-    timestamps.reserve(num_points);
-    
-    auto base_time = std::chrono::system_clock::time_point(
-        std::chrono::system_clock::duration(timestamp_deltas[0]));
-    timestamps.push_back(base_time);
-    
-    for (size_t i = 1; i < timestamp_deltas.size(); ++i) {
-        base_time += std::chrono::system_clock::duration(timestamp_deltas[i]);
-        timestamps.push_back(base_time);
-    }
-
-    // Decompress values
-    auto values = decompress_doubles(compressed_values);
-
     // Reconstruct points
     std::vector<TimeSeriesPoint> points;
     points.reserve(num_points);
     
     for (size_t i = 0; i < num_points; ++i) {
         points.push_back(TimeSeriesPoint{
-            .timestamp = timestamps[i],
+            .timestamp = std::chrono::system_clock::time_point(
+                std::chrono::system_clock::duration(timestamps[i])),
             .value = values[i],
             .symbol = symbols[symbol_indices[i]]
         });
@@ -308,5 +670,75 @@ std::vector<TimeSeriesPoint> decompress_time_series(const std::vector<uint8_t>&
     return points;
 }
 
+// CRC-32 (IEEE 802.3), table-driven
+namespace {
+
+const std::array<uint32_t, 256>& crc_table() {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+} // namespace
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    const auto& table = crc_table();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    num_threads = std::max<size_t>(num_threads, 1);
+    workers_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void ThreadPool::worker_loop() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return !tasks_.empty() || stopping_; });
+        if (tasks_.empty()) break;
+        
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
 } // namespace utils
 } // namespace findata_engine
@@ -0,0 +1,410 @@
+#include "findata_engine/wal.hpp"
+#include "findata_engine/utils.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace findata_engine {
+
+namespace {
+
+// Record layout: [uint32 payload_size][uint32 crc32(payload)][payload]
+// Payload: [uint32 count] then per point
+//          [uint16 symbol_len][symbol bytes][int64 ticks][double value]
+// A flush marker has FLUSHED_TAG in place of the count, then
+//          [uint32 count] and per symbol [uint16 symbol_len][symbol bytes][uint64 file_id]
+constexpr size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr uint32_t FLUSHED_TAG = 0xFFFFFFFF;
+
+template<typename T>
+void put(std::vector<uint8_t>& out, T value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool get(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) return false;
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+// Fills in the header of a record whose payload follows it
+void finish_record(std::vector<uint8_t>& record) {
+    const uint32_t payload_size = static_cast<uint32_t>(record.size() - RECORD_HEADER_SIZE);
+    const uint32_t crc = utils::crc32(record.data() + RECORD_HEADER_SIZE, payload_size);
+    std::memcpy(record.data(), &payload_size, sizeof(payload_size));
+    std::memcpy(record.data() + sizeof(payload_size), &crc, sizeof(crc));
+}
+
+void put_point(std::vector<uint8_t>& record, std::string_view symbol, int64_t ticks, double value) {
+    put<uint16_t>(record, static_cast<uint16_t>(symbol.size()));
+    record.insert(record.end(), symbol.begin(), symbol.end());
+    put<int64_t>(record, ticks);
+    put<double>(record, value);
+}
+
+template<typename It>
+std::vector<uint8_t> encode_record(It first, It last) {
+    std::vector<uint8_t> record(RECORD_HEADER_SIZE);
+    put<uint32_t>(record, static_cast<uint32_t>(std::distance(first, last)));
+    for (auto it = first; it != last; ++it) {
+        const TimeSeriesPoint& point = *it;
+        put_point(record, point.symbol, point.timestamp.time_since_epoch().count(), point.value);
+    }
+    finish_record(record);
+    return record;
+}
+
+std::vector<uint8_t> encode_columns(std::string_view symbol,
+                                    std::span<const int64_t> timestamps,
+                                    std::span<const double> values) {
+    std::vector<uint8_t> record(RECORD_HEADER_SIZE);
+    record.reserve(RECORD_HEADER_SIZE + sizeof(uint32_t) +
+                   timestamps.size() * (sizeof(uint16_t) + symbol.size() + sizeof(int64_t) + sizeof(double)));
+    put<uint32_t>(record, static_cast<uint32_t>(timestamps.size()));
+    for (size_t i = 0; i < timestamps.size(); ++i) {
+        put_point(record, symbol, timestamps[i], values[i]);
+    }
+    finish_record(record);
+    return record;
+}
+
+std::vector<uint8_t> encode_flushed(const std::vector<std::pair<std::string, uint64_t>>& symbols) {
+    std::vector<uint8_t> record(RECORD_HEADER_SIZE);
+    put<uint32_t>(record, FLUSHED_TAG);
+    put<uint32_t>(record, static_cast<uint32_t>(symbols.size()));
+    for (const auto& [symbol, file_id] : symbols) {
+        put<uint16_t>(record, static_cast<uint16_t>(symbol.size()));
+        record.insert(record.end(), symbol.begin(), symbol.end());
+        put<uint64_t>(record, file_id);
+    }
+    finish_record(record);
+    return record;
+}
+
+bool is_flushed_marker(const uint8_t* ptr, const uint8_t* end) {
+    uint32_t tag;
+    return get(ptr, end, tag) && tag == FLUSHED_TAG;
+}
+
+// Keeps the largest file id seen for each symbol
+bool decode_flushed(const uint8_t* ptr, const uint8_t* end,
+                    std::unordered_map<std::string, uint64_t>& flushed) {
+    uint32_t tag, count;
+    if (!get(ptr, end, tag) || !get(ptr, end, count)) return false;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint16_t symbol_len;
+        if (!get(ptr, end, symbol_len) || static_cast<size_t>(end - ptr) < symbol_len) return false;
+        std::string symbol(reinterpret_cast<const char*>(ptr), symbol_len);
+        ptr += symbol_len;
+
+        uint64_t file_id;
+        if (!get(ptr, end, file_id)) return false;
+        auto& before = flushed[std::move(symbol)];
+        before = std::max(before, file_id);
+    }
+    return ptr == end;
+}
+
+bool decode_payload(const uint8_t* ptr, const uint8_t* end, std::vector<TimeSeriesPoint>& points) {
+    uint32_t count;
+    if (!get(ptr, end, count)) return false;
+    points.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint16_t symbol_len;
+        if (!get(ptr, end, symbol_len) || static_cast<size_t>(end - ptr) < symbol_len) return false;
+        std::string symbol(reinterpret_cast<const char*>(ptr), symbol_len);
+        ptr += symbol_len;
+
+        int64_t ticks;
+        double value;
+        if (!get(ptr, end, ticks) || !get(ptr, end, value)) return false;
+        points.push_back(TimeSeriesPoint{
+            .timestamp = std::chrono::system_clock::time_point(std::chrono::system_clock::duration(ticks)),
+            .value = value,
+            .symbol = std::move(symbol)
+        });
+    }
+    return ptr == end;
+}
+
+} // namespace
+
+struct WriteAheadLog::Impl {
+    std::filesystem::path dir;
+    WalConfig config;
+
+    // Lock order: io_mutex before mutex
+    std::mutex io_mutex; // owns fd and the file contents
+    int fd = -1;
+    uint64_t current_file_id = 0;
+
+    std::mutex mutex; // guards the buffer and LSNs
+    std::condition_variable commit_cv;
+    std::condition_variable durable_cv;
+    std::vector<uint8_t> buffer;
+    std::chrono::steady_clock::time_point first_buffered;
+    uint64_t appended_lsn = 0;
+    uint64_t durable_lsn = 0;
+    bool failed = false;
+    bool stopping = false;
+    std::thread committer;
+
+    Impl(const std::filesystem::path& directory, const WalConfig& cfg)
+        : dir(directory), config(cfg) {
+        std::filesystem::create_directories(dir);
+        auto ids = list_files();
+        current_file_id = ids.empty() ? 0 : ids.back() + 1;
+        fd = open_file(current_file_id);
+        committer = std::thread([this] { commit_loop(); });
+    }
+
+    ~Impl() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        commit_cv.notify_one();
+        committer.join();
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
+    std::filesystem::path file_path(uint64_t id) const {
+        return dir / ("wal_" + std::to_string(id) + ".log");
+    }
+
+    int open_file(uint64_t id) const {
+        int new_fd = open(file_path(id).c_str(), O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+        if (new_fd == -1) {
+            throw std::runtime_error("Failed to open WAL file: " + file_path(id).string());
+        }
+        return new_fd;
+    }
+
+    std::vector<uint64_t> list_files() const {
+        std::vector<uint64_t> ids;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".log") continue;
+
+            // Anything else, such as an editor backup, is left alone
+            auto stem = entry.path().stem().string();
+            if (stem.size() <= 4 || stem.rfind("wal_", 0) != 0) continue;
+            uint64_t id = 0;
+            auto digits = std::string_view(stem).substr(4);
+            auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), id);
+            if (error != std::errc() || end != digits.data() + digits.size()) continue;
+            ids.push_back(id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    // Writes and syncs a batch to the current file. Caller holds io_mutex.
+    bool write_out(const std::vector<uint8_t>& batch) {
+        size_t written = 0;
+        while (written < batch.size()) {
+            ssize_t n = ::write(fd, batch.data() + written, batch.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return fdatasync(fd) == 0;
+    }
+
+    bool append_record(std::vector<uint8_t>&& record) {
+        std::unique_lock lock(mutex);
+        if (failed) return false;
+
+        if (buffer.empty()) {
+            first_buffered = std::chrono::steady_clock::now();
+            buffer = std::move(record);
+            commit_cv.notify_one();
+        } else {
+            buffer.insert(buffer.end(), record.begin(), record.end());
+            if (buffer.size() >= config.group_commit_bytes) {
+                commit_cv.notify_one();
+            }
+        }
+        const uint64_t lsn = ++appended_lsn;
+
+        if (config.sync_commit) {
+            durable_cv.wait(lock, [&] { return durable_lsn >= lsn || failed; });
+        }
+        return !failed;
+    }
+
+    void commit_loop() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            commit_cv.wait(lock, [this] { return !buffer.empty() || stopping; });
+            if (buffer.empty()) break;
+
+            // Hold the group open so concurrent appenders share one fsync
+            auto deadline = first_buffered + std::chrono::microseconds(config.group_commit_us);
+            commit_cv.wait_until(lock, deadline, [this] {
+                return buffer.size() >= config.group_commit_bytes || stopping;
+            });
+
+            lock.unlock();
+            std::lock_guard io_lock(io_mutex);
+            lock.lock();
+
+            std::vector<uint8_t> batch;
+            batch.swap(buffer);
+            const uint64_t batch_lsn = appended_lsn;
+            lock.unlock();
+
+            bool ok = batch.empty() || write_out(batch);
+
+            lock.lock();
+            if (!ok) {
+                failed = true;
+            }
+            durable_lsn = std::max(durable_lsn, batch_lsn);
+            durable_cv.notify_all();
+        }
+    }
+};
+
+WriteAheadLog::WriteAheadLog(const std::filesystem::path& directory, const WalConfig& config)
+    : pimpl_(std::make_unique<Impl>(directory, config)) {}
+
+WriteAheadLog::~WriteAheadLog() = default;
+
+bool WriteAheadLog::append(const TimeSeriesPoint& point) {
+    return pimpl_->append_record(encode_record(&point, &point + 1));
+}
+
+bool WriteAheadLog::append(const std::vector<TimeSeriesPoint>& points) {
+    if (points.empty()) return true;
+    return pimpl_->append_record(encode_record(points.begin(), points.end()));
+}
+
+bool WriteAheadLog::append(std::string_view symbol,
+                           std::span<const int64_t> timestamps,
+                           std::span<const double> values) {
+    if (timestamps.empty()) return true;
+    return pimpl_->append_record(encode_columns(symbol, timestamps, values));
+}
+
+uint64_t WriteAheadLog::rotate() {
+    std::lock_guard io_lock(pimpl_->io_mutex);
+
+    // Records buffered so far belong to the old file
+    std::vector<uint8_t> batch;
+    uint64_t batch_lsn;
+    {
+        std::lock_guard lock(pimpl_->mutex);
+        batch.swap(pimpl_->buffer);
+        batch_lsn = pimpl_->appended_lsn;
+    }
+    bool ok = batch.empty() || pimpl_->write_out(batch);
+
+    close(pimpl_->fd);
+    pimpl_->current_file_id++;
+    pimpl_->fd = pimpl_->open_file(pimpl_->current_file_id);
+
+    {
+        std::lock_guard lock(pimpl_->mutex);
+        if (!ok) {
+            pimpl_->failed = true;
+        }
+        pimpl_->durable_lsn = std::max(pimpl_->durable_lsn, batch_lsn);
+    }
+    pimpl_->durable_cv.notify_all();
+    return pimpl_->current_file_id;
+}
+
+bool WriteAheadLog::mark_flushed(const std::vector<std::pair<std::string, uint64_t>>& symbols) {
+    if (symbols.empty()) return true;
+    return pimpl_->append_record(encode_flushed(symbols));
+}
+
+void WriteAheadLog::truncate_before(uint64_t file_id) {
+    for (uint64_t id : pimpl_->list_files()) {
+        if (id >= file_id) break;
+        std::error_code ec;
+        std::filesystem::remove(pimpl_->file_path(id), ec);
+    }
+}
+
+size_t WriteAheadLog::replay(const std::function<void(std::vector<TimeSeriesPoint>&&)>& consumer) {
+    // Intact records of every file, up to the first torn or corrupt one
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> files;
+    for (uint64_t id : pimpl_->list_files()) {
+        if (id >= pimpl_->current_file_id) break;
+
+        std::ifstream in(pimpl_->file_path(id), std::ios::binary);
+        files.emplace_back(id, std::vector<uint8_t>((std::istreambuf_iterator<char>(in)),
+                                                    std::istreambuf_iterator<char>()));
+    }
+    auto for_each_record = [](const std::vector<uint8_t>& data, auto&& fn) {
+        const uint8_t* ptr = data.data();
+        const uint8_t* end = data.data() + data.size();
+        while (static_cast<size_t>(end - ptr) >= RECORD_HEADER_SIZE) {
+            uint32_t payload_size, crc;
+            std::memcpy(&payload_size, ptr, sizeof(payload_size));
+            std::memcpy(&crc, ptr + sizeof(payload_size), sizeof(crc));
+            const uint8_t* payload = ptr + RECORD_HEADER_SIZE;
+            if (static_cast<size_t>(end - payload) < payload_size ||
+                utils::crc32(payload, payload_size) != crc) {
+                break; // Torn tail from a crash mid-write
+            }
+            if (!fn(payload, payload + payload_size)) {
+                break;
+            }
+            ptr = payload + payload_size;
+        }
+    };
+
+    // Markers can sit in any later file than the records they cover, so
+    // they are all collected before a point is fed
+    std::unordered_map<std::string, uint64_t> flushed;
+    for (const auto& [id, data] : files) {
+        for_each_record(data, [&](const uint8_t* payload, const uint8_t* end) {
+            return !is_flushed_marker(payload, end) || decode_flushed(payload, end, flushed);
+        });
+    }
+
+    size_t replayed = 0;
+    for (const auto& [id, data] : files) {
+        for_each_record(data, [&](const uint8_t* payload, const uint8_t* end) {
+            if (is_flushed_marker(payload, end)) return true;
+
+            std::vector<TimeSeriesPoint> points;
+            if (!decode_payload(payload, end, points)) return false;
+            if (!flushed.empty()) {
+                std::erase_if(points, [&, file_id = id](const TimeSeriesPoint& point) {
+                    auto it = flushed.find(point.symbol);
+                    return it != flushed.end() && file_id < it->second;
+                });
+            }
+            if (!points.empty()) {
+                replayed += points.size();
+                consumer(std::move(points));
+            }
+            return true;
+        });
+    }
+    return replayed;
+}
+
+} // namespace findata_engine
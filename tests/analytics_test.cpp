@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "findata_engine/analytics.hpp"
+#include "findata_engine/rust_bindings.hpp"
+#include <cmath>
+#include <random>
+
+using namespace findata_engine;
+using namespace findata_engine::analytics;
+
+class AnalyticsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 gen(42);
+        std::normal_distribution<double> price_step(0.0, 0.5);
+        std::uniform_real_distribution<double> volume(1.0, 100.0);
+        double price = 100.0;
+        for (size_t i = 0; i < 2000; ++i) {
+            price += price_step(gen);
+            timestamps_.push_back(static_cast<int64_t>(i) * 1000);
+            values_.push_back(price);
+            volumes_.push_back(volume(gen));
+        }
+    }
+    
+    std::vector<int64_t> timestamps_;
+    std::vector<double> values_;
+    std::vector<double> volumes_;
+};
+
+TEST_F(AnalyticsTest, MatchesBruteForceAcrossChunks) {
+    RollingSpec spec{.windows = {1, 7, 50, 500}, .ema_alphas = {0.1, 1.0}, .volume_symbol = {}};
+    RollingAnalyzer analyzer(spec, true);
+    
+    // Uneven chunks, some shorter than the windows, exercise the ring
+    const std::span<const int64_t> ts(timestamps_);
+    const std::span<const double> vs(values_), vols(volumes_);
+    for (size_t offset = 0, chunk = 3; offset < vs.size(); chunk = chunk * 2 + 1) {
+        size_t take = std::min(chunk, vs.size() - offset);
+        analyzer.push(ts.subspan(offset, take), vs.subspan(offset, take), vols.subspan(offset, take));
+        offset += take;
+    }
+    auto result = analyzer.take_result();
+    ASSERT_EQ(result.timestamps, timestamps_);
+    
+    for (const auto& out : result.windows) {
+        const size_t w = out.window;
+        ASSERT_EQ(out.mean.size(), values_.size());
+        for (size_t i = 0; i < values_.size(); ++i) {
+            if (i + 1 < w) {
+                EXPECT_TRUE(std::isnan(out.mean[i]));
+                continue;
+            }
+            double sum = 0, pv = 0, vol = 0;
+            for (size_t k = i + 1 - w; k <= i; ++k) {
+                sum += values_[k];
+                pv += values_[k] * volumes_[k];
+                vol += volumes_[k];
+            }
+            const double mean = sum / w;
+            double var = 0;
+            for (size_t k = i + 1 - w; k <= i; ++k) {
+                var += (values_[k] - mean) * (values_[k] - mean);
+            }
+            const double stddev = std::sqrt(var / w);
+            EXPECT_NEAR(out.mean[i], mean, 1e-9) << w << " @ " << i;
+            EXPECT_NEAR(out.stddev[i], stddev, 1e-7) << w << " @ " << i;
+            EXPECT_NEAR(out.vwap[i], pv / vol, 1e-9) << w << " @ " << i;
+            if (stddev > 1e-9) {
+                EXPECT_NEAR(out.zscore[i], (values_[i] - mean) / stddev, 1e-5) << w << " @ " << i;
+            }
+        }
+    }
+    
+    double ema = values_[0];
+    for (size_t i = 0; i < values_.size(); ++i) {
+        ema = i == 0 ? values_[0] : 0.1 * values_[i] + 0.9 * ema;
+        EXPECT_NEAR(result.emas[0][i], ema, 1e-9);
+        EXPECT_DOUBLE_EQ(result.emas[1][i], values_[i]);
+    }
+    
+    EXPECT_THROW(RollingAnalyzer(RollingSpec{.windows = {0}, .ema_alphas = {}, .volume_symbol = {}}, false),
+                 std::runtime_error);
+}
+
+TEST_F(AnalyticsTest, RustKernelsAgreeWithAnalyzer) {
+    const size_t window = 20;
+    RollingSpec spec{.windows = {window}, .ema_alphas = {0.2}, .volume_symbol = {}};
+    RollingAnalyzer analyzer(spec, false);
+    analyzer.push(timestamps_, values_);
+    auto result = analyzer.take_result();
+    
+    std::vector<double> ma(values_.size()), ema(values_.size()), sd(values_.size());
+    ASSERT_EQ(compute_moving_average_simd(values_.data(), values_.size(), window, ma.data()), 0);
+    ASSERT_EQ(compute_exponential_moving_average_simd(values_.data(), values_.size(), 0.2, ema.data()), 0);
+    ASSERT_EQ(compute_standard_deviation_simd(values_.data(), values_.size(), window, sd.data()), 0);
+    
+    for (size_t i = 0; i < values_.size(); ++i) {
+        EXPECT_NEAR(ema[i], result.emas[0][i], 1e-9) << i;
+        if (i + 1 >= window) {
+            EXPECT_NEAR(ma[i], result.windows[0].mean[i], 1e-9) << i;
+            EXPECT_NEAR(sd[i], result.windows[0].stddev[i], 1e-7) << i;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include "findata_engine/async_io.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace findata_engine;
+namespace fs = std::filesystem;
+
+class AsyncReaderTest : public ::testing::TestWithParam<AsyncReader::Backend> {
+protected:
+    void SetUp() override {
+        path_ = fs::temp_directory_path() / "findata_async_io_test.bin";
+        contents_.resize(1 << 20);
+        for (size_t i = 0; i < contents_.size(); ++i) {
+            contents_[i] = static_cast<uint8_t>(i * 31 + (i >> 12));
+        }
+        std::ofstream out(path_, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(contents_.data()), contents_.size());
+        out.close();
+        fd_ = open(path_.c_str(), O_RDONLY);
+        ASSERT_NE(fd_, -1);
+    }
+    
+    void TearDown() override {
+        close(fd_);
+        fs::remove(path_);
+    }
+    
+    fs::path path_;
+    std::vector<uint8_t> contents_;
+    int fd_ = -1;
+};
+
+TEST_P(AsyncReaderTest, ManyReadsInFlight) {
+    AsyncReader reader(GetParam(), 16);
+    EXPECT_EQ(reader.uses_io_uring(), GetParam() != AsyncReader::Backend::Threads);
+    
+    // More reads than the queue depth, waited for in reverse order
+    const size_t num_reads = 100;
+    const size_t read_size = 5000;
+    std::vector<std::vector<uint8_t>> buffers(num_reads, std::vector<uint8_t>(read_size));
+    std::vector<AsyncReader::Pending> reads;
+    for (size_t i = 0; i < num_reads; ++i) {
+        reads.push_back(reader.read(fd_, i * 7919, buffers[i]));
+    }
+    for (size_t i = num_reads; i-- > 0;) {
+        reads[i].wait();
+        ASSERT_TRUE(std::equal(buffers[i].begin(), buffers[i].end(), contents_.begin() + i * 7919)) << i;
+    }
+}
+
+TEST_P(AsyncReaderTest, ReadPastEndThrows) {
+    AsyncReader reader(GetParam(), 4);
+    std::vector<uint8_t> buffer(4096);
+    auto read = reader.read(fd_, contents_.size() - 100, buffer);
+    EXPECT_THROW(read.wait(), std::runtime_error);
+    
+    // Dropped without waiting; the handle still waits for the read to land
+    auto unwaited = reader.read(fd_, 0, buffer);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, AsyncReaderTest,
+                         ::testing::Values(AsyncReader::Backend::IoUring, AsyncReader::Backend::Threads));
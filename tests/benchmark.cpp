@@ -1,5 +1,6 @@
 #include "findata_engine/storage_engine.hpp"
 #include "findata_engine/rust_bindings.hpp"
+#include "findata_engine/utils.hpp"
 #include <gtest/gtest.h>
 #include <random>
 #include <chrono>
@@ -7,6 +8,7 @@
 #include <iomanip>
 #include <vector>
 #include <cmath>
+#include <filesystem>
 
 using namespace findata_engine;
 using Clock = std::chrono::high_resolution_clock;
@@ -29,9 +31,9 @@ protected:
         
         for (size_t i = 0; i < n; ++i) {
             points.push_back(TimeSeriesPoint{
-                .symbol = symbol,
                 .timestamp = timestamp + std::chrono::seconds(i),
-                .value = price_dist(gen)
+                .value = price_dist(gen),
+                .symbol = symbol
             });
         }
         
@@ -234,3 +236,67 @@ TEST_F(BenchmarkTest, StorageEngineBenchmark) {
     // Clean up
     std::filesystem::remove_all(temp_dir);
 }
+
+TEST_F(BenchmarkTest, DecodeKernelBenchmark) {
+    std::cout << "\nDecode Kernel Benchmark\n" << std::string(80, '=') << std::endl;
+    print_benchmark_header();
+    
+    const size_t n = 1000003; // Not a multiple of the vector width
+    std::vector<int64_t> deltas(n);
+    std::vector<uint64_t> residuals(n);
+    for (size_t i = 0; i < n; ++i) {
+        deltas[i] = static_cast<int64_t>(gen() % 1000);
+        residuals[i] = (static_cast<uint64_t>(gen()) << 32) | gen();
+    }
+    
+    auto time_kernel = [&](const std::string& name, auto& input, auto kernel) {
+        auto data = input;
+        auto start = Clock::now();
+        kernel(std::span(data));
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start);
+        print_benchmark_result(name, duration, n * sizeof(data[0]), n);
+        return data;
+    };
+    
+    // Prefix kernels, each variant this host runs against the scalar reference
+    auto sum_scalar = time_kernel("Prefix Sum (reference)", deltas, utils::prefix_sum_scalar);
+    auto xor_scalar = time_kernel("Prefix XOR (reference)", residuals, utils::prefix_xor_scalar);
+    const auto selected = utils::simd_level();
+    for (auto level : {utils::SimdLevel::Scalar, utils::SimdLevel::Avx2, utils::SimdLevel::Avx512}) {
+        if (!utils::simd_supported(level)) continue;
+        utils::set_simd_level(level);
+        const std::string name = utils::simd_level_name(level);
+        EXPECT_EQ(time_kernel("Prefix Sum (" + name + ")", deltas, utils::prefix_sum), sum_scalar);
+        EXPECT_EQ(time_kernel("Prefix XOR (" + name + ")", residuals, utils::prefix_xor), xor_scalar);
+    }
+    utils::set_simd_level(selected);
+    
+    // End-to-end column decode
+    auto points = generate_random_data(n, "AAPL");
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    for (const auto& p : points) {
+        timestamps.push_back(p.timestamp.time_since_epoch().count());
+        values.push_back(p.value);
+    }
+    auto ts_stream = utils::compress_timestamps(timestamps);
+    auto value_stream = utils::compress_doubles(values);
+    
+    {
+        auto start = Clock::now();
+        auto decoded = utils::decompress_timestamps(ts_stream);
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start);
+        print_benchmark_result("Decode Timestamps", duration, ts_stream.size(), n);
+        EXPECT_EQ(decoded, timestamps);
+    }
+    {
+        auto start = Clock::now();
+        auto decoded = utils::decompress_doubles(value_stream);
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start);
+        print_benchmark_result("Decode Values", duration, value_stream.size(), n);
+        EXPECT_EQ(decoded, values);
+    }
+}
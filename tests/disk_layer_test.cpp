@@ -1,10 +1,15 @@
 #include <gtest/gtest.h>
 #include "findata_engine/disk_layer.hpp"
+#include "findata_engine/rust_bindings.hpp"
+#include "findata_engine/utils.hpp"
 #include <filesystem>
 #include <chrono>
 #include <thread>
 #include <future>
 #include <random>
+#include <map>
+#include <fstream>
+#include <cstring>
 
 using namespace findata_engine;
 using namespace std::chrono;
@@ -194,3 +199,614 @@ TEST_F(DiskLayerTest, Persistence) {
         EXPECT_EQ(results[i].symbol, "FB");
     }
 }
+
+TEST_F(DiskLayerTest, NarrowRangeAcrossBlocks) {
+    DiskConfig config;
+    config.points_per_block = 64;
+    auto block_dir = test_dir_ / "blocks";
+    DiskLayer layer(block_dir, config);
+    
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("MSFT", 1000, start_time, microseconds(1000));
+    EXPECT_TRUE(layer.write_batch(points));
+    
+    // Range straddles a block boundary in the middle of the segment
+    auto results = layer.read_range(
+        "MSFT",
+        start_time + microseconds(60 * 1000),
+        start_time + microseconds(70 * 1000));
+    
+    ASSERT_EQ(results.size(), 11);
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i].timestamp, points[60 + i].timestamp);
+        EXPECT_DOUBLE_EQ(results[i].value, points[60 + i].value);
+    }
+    
+    // Range that falls between two points
+    auto empty = layer.read_range(
+        "MSFT",
+        start_time + microseconds(100 * 1000 + 1),
+        start_time + microseconds(100 * 1000 + 999));
+    EXPECT_TRUE(empty.empty());
+}
+
+TEST_F(DiskLayerTest, ManifestTracksCompaction) {
+    auto start_time = system_clock::now();
+    for (int i = 0; i < 3; ++i) {
+        auto points = generate_test_data("NFLX", 100, start_time + seconds(i), microseconds(1000));
+        EXPECT_TRUE(disk_layer_->write_batch(points));
+    }
+    disk_layer_->compact_segments("NFLX");
+    auto expected = disk_layer_->read_range("NFLX", start_time, start_time + seconds(10));
+    ASSERT_EQ(expected.size(), 300);
+    disk_layer_.reset();
+    
+    // Reopen from the manifest: only the compacted segment set is visible
+    DiskLayer reopened(test_dir_);
+    auto results = reopened.read_range("NFLX", start_time, start_time + seconds(10));
+    ASSERT_EQ(results.size(), expected.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i].timestamp, expected[i].timestamp);
+        EXPECT_DOUBLE_EQ(results[i].value, expected[i].value);
+    }
+}
+
+TEST_F(DiskLayerTest, RebuildsMissingManifest) {
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("BRK_B", 100, start_time, microseconds(1000));
+    EXPECT_TRUE(disk_layer_->write_batch(points));
+    disk_layer_.reset();
+    
+    fs::remove(test_dir_ / "MANIFEST");
+    
+    // Segments are recovered from their footers, symbol underscores intact
+    DiskLayer reopened(test_dir_);
+    auto results = reopened.read_range("BRK_B", start_time, start_time + seconds(1));
+    ASSERT_EQ(results.size(), points.size());
+    EXPECT_EQ(results.front().symbol, "BRK_B");
+    EXPECT_TRUE(fs::exists(test_dir_ / "MANIFEST"));
+}
+
+TEST_F(DiskLayerTest, SweepsOrphansOnlyAfterUncleanClose) {
+    auto start_time = system_clock::now();
+    EXPECT_TRUE(disk_layer_->write_batch(generate_test_data("AMD", 100, start_time, microseconds(1000))));
+    disk_layer_.reset();
+    EXPECT_TRUE(fs::exists(test_dir_ / "CLEAN"));
+    
+    // A segment file the manifest never recorded, as a crashed flush leaves
+    const auto orphan = test_dir_ / "AMD_99.seg";
+    std::ofstream(orphan) << "partial";
+    
+    // After a clean close the directory isn't listed
+    {
+        DiskLayer reopened(test_dir_);
+        EXPECT_FALSE(fs::exists(test_dir_ / "CLEAN"));
+        EXPECT_TRUE(fs::exists(orphan));
+    }
+    
+    // Without the marker the last run may have crashed, so the file goes
+    fs::remove(test_dir_ / "CLEAN");
+    DiskLayer reopened(test_dir_);
+    EXPECT_FALSE(fs::exists(orphan));
+    EXPECT_EQ(reopened.read_range("AMD", start_time, start_time + seconds(1)).size(), 100u);
+}
+
+TEST_F(DiskLayerTest, MappedColumnarScan) {
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("TSLA", 500, start_time, microseconds(1000));
+    
+    for (bool use_mmap : {true, false}) {
+        DiskConfig config;
+        config.enable_compression = false;
+        config.points_per_block = 128;
+        config.use_mmap = use_mmap;
+        auto dir = test_dir_ / (use_mmap ? "mmap" : "stream");
+        DiskLayer layer(dir, config);
+        EXPECT_TRUE(layer.write_batch(points));
+        
+        std::vector<int64_t> timestamps;
+        std::vector<double> values;
+        layer.scan_range("TSLA", start_time + microseconds(100000), start_time + microseconds(299000),
+            [&](std::span<const int64_t> ts, std::span<const double> vs) {
+                timestamps.insert(timestamps.end(), ts.begin(), ts.end());
+                values.insert(values.end(), vs.begin(), vs.end());
+            });
+        
+        ASSERT_EQ(timestamps.size(), 200);
+        for (size_t i = 0; i < timestamps.size(); ++i) {
+            EXPECT_EQ(timestamps[i], points[100 + i].timestamp.time_since_epoch().count());
+            EXPECT_DOUBLE_EQ(values[i], points[100 + i].value);
+        }
+    }
+}
+
+TEST_F(DiskLayerTest, ReadAheadCursorMergesSegments) {
+    DiskConfig config;
+    config.points_per_block = 64;
+    config.use_mmap = false;
+    config.read_ahead_blocks = 4;
+    config.background_compaction = false;
+    DiskLayer layer(test_dir_ / "read_ahead", config);
+    
+    // Three interleaved segments, so every cursor step crosses streams
+    auto start_time = time_point_cast<microseconds>(system_clock::now());
+    std::map<int64_t, double> expected;
+    for (int segment = 0; segment < 3; ++segment) {
+        std::vector<TimeSeriesPoint> points;
+        for (int i = 0; i < 1000; ++i) {
+            system_clock::time_point ts = start_time + microseconds(i * 3 + segment);
+            points.push_back(TimeSeriesPoint{.timestamp = ts, .value = i * 1.5 + segment, .symbol = "QQQ"});
+            expected[ts.time_since_epoch().count()] = i * 1.5 + segment;
+        }
+        ASSERT_TRUE(layer.write_batch(points));
+    }
+    
+    // The second pass hits the block cache, which skips planned reads
+    for (int pass = 0; pass < 2; ++pass) {
+        auto cursor = layer.open_cursor("QQQ", system_clock::time_point::min(), system_clock::time_point::max());
+        std::vector<TimeSeriesPoint> batch;
+        auto it = expected.begin();
+        while (cursor.next(batch, 100)) {
+            for (const auto& point : batch) {
+                ASSERT_NE(it, expected.end());
+                EXPECT_EQ(point.timestamp.time_since_epoch().count(), it->first);
+                EXPECT_DOUBLE_EQ(point.value, it->second);
+                ++it;
+            }
+        }
+        EXPECT_EQ(it, expected.end());
+    }
+    EXPECT_GT(layer.get_cache_hits(), 0);
+    
+    auto narrow = layer.read_range("QQQ", start_time + microseconds(1500), start_time + microseconds(1599));
+    EXPECT_EQ(narrow.size(), 100);
+}
+
+TEST_F(DiskLayerTest, RangeQueriesFindOverlappingSegments) {
+    DiskConfig config;
+    config.points_per_block = 16;
+    config.background_compaction = false;
+    auto index_dir = test_dir_ / "segment_index";
+    
+    // Forty disjoint segments, then a sparse one spanning all of them and a
+    // short one in the middle; later writes win on shared timestamps
+    system_clock::time_point start_time = time_point_cast<microseconds>(system_clock::now());
+    std::map<int64_t, double> expected;
+    auto write = [&](DiskLayer& layer, int first, int count, int step, double base) {
+        std::vector<TimeSeriesPoint> points;
+        for (int i = first; i < first + count * step; i += step) {
+            system_clock::time_point ts = start_time + microseconds(i);
+            points.push_back(TimeSeriesPoint{.timestamp = ts, .value = base + i, .symbol = "IDX"});
+            expected[ts.time_since_epoch().count()] = base + i;
+        }
+        ASSERT_TRUE(layer.write_batch(points));
+    };
+    {
+        DiskLayer layer(index_dir, config);
+        for (int segment = 0; segment < 40; ++segment) {
+            write(layer, segment * 100, 50, 2, 0.0);
+        }
+        write(layer, 0, 400, 10, 10000.0);
+        write(layer, 1990, 20, 1, 20000.0);
+    }
+    
+    // Reopening rebuilds the index from the manifest
+    DiskLayer layer(index_dir, config);
+    auto check = [&](int lo, int hi) {
+        auto points = layer.read_range("IDX", start_time + microseconds(lo), start_time + microseconds(hi));
+        auto it = expected.lower_bound((start_time + microseconds(lo)).time_since_epoch().count());
+        auto end = expected.upper_bound((start_time + microseconds(hi)).time_since_epoch().count());
+        ASSERT_EQ(points.size(), static_cast<size_t>(std::distance(it, end))) << lo << ".." << hi;
+        for (const auto& point : points) {
+            EXPECT_EQ(point.timestamp.time_since_epoch().count(), it->first);
+            EXPECT_DOUBLE_EQ(point.value, it->second);
+            ++it;
+        }
+    };
+    check(0, 3999);
+    check(150, 160);     // Gap between disjoint segments, inside the wide one
+    check(1995, 2005);   // All three layers
+    check(3990, 5000);   // Past the last segment
+    check(-100, -1);     // Before the first
+    
+    auto latest = layer.get_latest("IDX");
+    ASSERT_TRUE(latest.has_value());
+    EXPECT_EQ(latest->timestamp.time_since_epoch().count(), expected.rbegin()->first);
+}
+
+TEST_F(DiskLayerTest, BlockCacheServesRepeatedReads) {
+    DiskConfig config;
+    config.points_per_block = 100;
+    auto cache_dir = test_dir_ / "cache";
+    DiskLayer layer(cache_dir, config);
+    
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("ORCL", 1000, start_time, microseconds(1000));
+    EXPECT_TRUE(layer.write_batch(points));
+    
+    auto end_time = start_time + microseconds(249000);
+    auto first = layer.read_range("ORCL", start_time, end_time);
+    EXPECT_EQ(layer.get_cache_hits(), 0);
+    EXPECT_EQ(layer.get_cache_misses(), 3);
+    
+    auto second = layer.read_range("ORCL", start_time, end_time);
+    EXPECT_EQ(layer.get_cache_hits(), 3);
+    EXPECT_EQ(layer.get_cache_misses(), 3);
+    
+    ASSERT_EQ(second.size(), 250);
+    for (size_t i = 0; i < second.size(); ++i) {
+        EXPECT_EQ(second[i].timestamp, first[i].timestamp);
+        EXPECT_DOUBLE_EQ(second[i].value, first[i].value);
+    }
+}
+
+TEST_F(DiskLayerTest, CursorPrefersNewestSegment) {
+    auto start_time = system_clock::now();
+    auto older = generate_test_data("IBM", 300, start_time, microseconds(1000));
+    auto newer = generate_test_data("IBM", 100, start_time + microseconds(100000), microseconds(1000));
+    EXPECT_TRUE(disk_layer_->write_batch(older));
+    EXPECT_TRUE(disk_layer_->write_batch(newer));
+    
+    auto cursor = disk_layer_->open_cursor("IBM", start_time, start_time + seconds(1));
+    std::vector<TimeSeriesPoint> batch;
+    std::vector<TimeSeriesPoint> all;
+    while (cursor.next(batch, 50)) {
+        all.insert(all.end(), batch.begin(), batch.end());
+    }
+    
+    ASSERT_EQ(all.size(), 300);
+    for (size_t i = 0; i < all.size(); ++i) {
+        EXPECT_EQ(all[i].timestamp, older[i].timestamp);
+        double expected = (i >= 100 && i < 200) ? newer[i - 100].value : older[i].value;
+        EXPECT_DOUBLE_EQ(all[i].value, expected);
+    }
+}
+
+TEST_F(DiskLayerTest, CodecsRoundTrip) {
+    // Irregular spacing and a random walk exercise every codec bucket
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int64_t> gap(1, 5000000);
+    std::normal_distribution<double> step(0.0, 0.05);
+    
+    std::vector<TimeSeriesPoint> points;
+    auto ts = system_clock::now();
+    double price = 100.0;
+    for (int i = 0; i < 5000; ++i) {
+        ts += system_clock::duration(i % 10 == 0 ? gap(gen) : 1000);
+        price += step(gen);
+        points.push_back(TimeSeriesPoint{.timestamp = ts, .value = price, .symbol = "SPY"});
+    }
+    
+    std::map<BlockCodec, size_t> sizes;
+    for (auto codec : {BlockCodec::None, BlockCodec::Zstd, BlockCodec::Gorilla, BlockCodec::GorillaZstd}) {
+        DiskConfig config;
+        config.codec = codec;
+        config.enable_compression = codec != BlockCodec::None;
+        auto dir = test_dir_ / ("codec_" + std::to_string(static_cast<int>(codec)));
+        {
+            DiskLayer layer(dir, config);
+            EXPECT_TRUE(layer.write_batch(points));
+            sizes[codec] = layer.get_storage_size();
+        }
+        
+        // Reopen so the codec is taken from the segment header
+        DiskLayer reopened(dir);
+        auto results = reopened.read_range("SPY", points.front().timestamp, points.back().timestamp);
+        ASSERT_EQ(results.size(), points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            ASSERT_EQ(results[i].timestamp, points[i].timestamp);
+            ASSERT_EQ(results[i].value, points[i].value);
+        }
+    }
+    
+    EXPECT_LT(sizes[BlockCodec::Gorilla], sizes[BlockCodec::Zstd]);
+    EXPECT_LT(sizes[BlockCodec::Zstd], sizes[BlockCodec::None]);
+}
+
+TEST_F(DiskLayerTest, ColumnCodecReadsPointCodecFrames) {
+    std::vector<TimePoint> rust_points;
+    for (int64_t i = 0; i < 1000; ++i) {
+        rust_points.push_back(TimePoint{.timestamp = 1000000 + i * 37, .value = 0.5 * i});
+    }
+    size_t compressed_size;
+    uint8_t* compressed = compress_time_series(rust_points.data(), rust_points.size(), &compressed_size);
+    
+    // Frames from the point-oriented API decode into caller-owned columns
+    std::vector<int64_t> timestamps(rust_points.size());
+    std::vector<double> values(rust_points.size());
+    size_t decoded = 0;
+    ASSERT_EQ(decompress_columns(compressed, compressed_size, timestamps.data(), values.data(),
+                                 timestamps.size(), &decoded), 0);
+    ASSERT_EQ(decoded, rust_points.size());
+    for (size_t i = 0; i < decoded; ++i) {
+        EXPECT_EQ(timestamps[i], rust_points[i].timestamp);
+        EXPECT_EQ(values[i], rust_points[i].value);
+    }
+    
+    // Undersized output is reported rather than overrun
+    EXPECT_EQ(decompress_columns(compressed, compressed_size, timestamps.data(), values.data(),
+                                 10, &decoded), 1);
+    free_compressed_data(compressed, compressed_size);
+    
+    std::vector<uint8_t> out(compress_columns_bound(timestamps.size()));
+    ASSERT_EQ(compress_columns(timestamps.data(), values.data(), timestamps.size(), 3,
+                               out.data(), out.size(), &compressed_size), 0);
+    EXPECT_EQ(compress_columns(timestamps.data(), values.data(), timestamps.size(), 3,
+                               out.data(), 8, &compressed_size), 1);
+}
+
+namespace {
+
+int64_t to_ticks_for_test(system_clock::time_point tp) {
+    return tp.time_since_epoch().count();
+}
+
+size_t count_segment_files(const fs::path& dir) {
+    size_t count = 0;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        count += entry.path().extension() == ".seg";
+    }
+    return count;
+}
+
+bool wait_for_segment_count(const fs::path& dir, size_t expected) {
+    auto deadline = steady_clock::now() + seconds(10);
+    while (count_segment_files(dir) != expected) {
+        if (steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_F(DiskLayerTest, BackgroundCompactionMergesSmallSegments) {
+    DiskConfig config;
+    config.points_per_block = 16;
+    config.compaction_fanin = 4;
+    auto dir = test_dir_ / "tiered";
+    auto start_time = system_clock::now();
+    std::vector<TimeSeriesPoint> all;
+    {
+        DiskLayer layer(dir, config);
+        for (int i = 0; i < 4; ++i) {
+            auto points = generate_test_data("AAPL", 32, start_time + milliseconds(i * 32), microseconds(1000));
+            all.insert(all.end(), points.begin(), points.end());
+            EXPECT_TRUE(layer.write_batch(points));
+        }
+        
+        // Four tier-0 segments fold into one and stay readable
+        ASSERT_TRUE(wait_for_segment_count(dir, 1));
+        auto results = layer.read_range("AAPL", start_time, start_time + seconds(1));
+        ASSERT_EQ(results.size(), all.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            EXPECT_EQ(results[i].timestamp, all[i].timestamp);
+            EXPECT_DOUBLE_EQ(results[i].value, all[i].value);
+        }
+    }
+    
+    // The manifest records the merged segment
+    config.background_compaction = false;
+    DiskLayer reopened(dir, config);
+    EXPECT_EQ(reopened.read_range("AAPL", start_time, start_time + seconds(1)).size(), all.size());
+    EXPECT_EQ(count_segment_files(dir), 1);
+}
+
+TEST_F(DiskLayerTest, BackgroundCompactionKeepsNewestWrites) {
+    DiskConfig config;
+    config.points_per_block = 16;
+    config.compaction_fanin = 2;
+    auto dir = test_dir_ / "overwrites";
+    DiskLayer layer(dir, config);
+    
+    // Each batch rewrites the same timestamps; a later non-overlapping
+    // segment must not be merged out of order with them
+    auto start_time = system_clock::now();
+    std::vector<TimeSeriesPoint> latest;
+    for (int i = 0; i < 3; ++i) {
+        latest = generate_test_data("INTC", 40, start_time, microseconds(1000));
+        EXPECT_TRUE(layer.write_batch(latest));
+    }
+    auto tail = generate_test_data("INTC", 40, start_time + seconds(1), microseconds(1000));
+    EXPECT_TRUE(layer.write_batch(tail));
+    
+    ASSERT_TRUE(wait_for_segment_count(dir, 1));
+    auto results = layer.read_range("INTC", start_time, start_time + seconds(2));
+    ASSERT_EQ(results.size(), latest.size() + tail.size());
+    for (size_t i = 0; i < latest.size(); ++i) {
+        EXPECT_DOUBLE_EQ(results[i].value, latest[i].value);
+    }
+    EXPECT_DOUBLE_EQ(results.back().value, tail.back().value);
+}
+
+TEST_F(DiskLayerTest, AggregateDecodesOnlyBoundaryBlocks) {
+    DiskConfig config;
+    config.points_per_block = 100;
+    config.background_compaction = false;
+    auto dir = test_dir_ / "aggregate";
+    DiskLayer layer(dir, config);
+    
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("CSCO", 1000, start_time, microseconds(1000));
+    EXPECT_TRUE(layer.write_batch(points));
+    
+    auto reduce = [&](system_clock::time_point from, system_clock::time_point to) {
+        RangeStats expected;
+        for (const auto& point : layer.read_range("CSCO", from, to)) {
+            expected.add(point.value);
+        }
+        return expected;
+    };
+    auto from = start_time + microseconds(150000);
+    auto to = start_time + microseconds(849000);
+    
+    // Blocks 2-7 come from the index; 1 and 8 are decoded
+    auto stats = layer.aggregate("CSCO", from, to);
+    EXPECT_EQ(layer.get_cache_misses(), 2);
+    auto expected = reduce(from, to);
+    EXPECT_EQ(stats.count, 700);
+    EXPECT_EQ(stats.count, expected.count);
+    EXPECT_NEAR(stats.sum, expected.sum, 1e-6);
+    EXPECT_DOUBLE_EQ(stats.min, expected.min);
+    EXPECT_DOUBLE_EQ(stats.max, expected.max);
+    
+    // A newer overlapping segment forces a merge where it overlaps, and
+    // shadowed timestamps are left out
+    auto newer = generate_test_data("CSCO", 50, start_time + microseconds(400000), microseconds(1000));
+    EXPECT_TRUE(layer.write_batch(newer));
+    std::vector<int64_t> shadowed = {
+        to_ticks_for_test(start_time + microseconds(200000)),
+        to_ticks_for_test(start_time + microseconds(420000))
+    };
+    stats = layer.aggregate("CSCO", from, to, shadowed);
+    expected = RangeStats{};
+    for (const auto& point : layer.read_range("CSCO", from, to)) {
+        auto ticks = to_ticks_for_test(point.timestamp);
+        if (ticks != shadowed[0] && ticks != shadowed[1]) {
+            expected.add(point.value);
+        }
+    }
+    EXPECT_EQ(stats.count, 698);
+    EXPECT_EQ(stats.count, expected.count);
+    EXPECT_NEAR(stats.sum, expected.sum, 1e-6);
+    EXPECT_DOUBLE_EQ(stats.min, expected.min);
+    EXPECT_DOUBLE_EQ(stats.max, expected.max);
+}
+
+TEST(ObjectPoolTest, RecyclesBuffers) {
+    auto pool = std::make_unique<utils::ObjectPool<std::vector<uint8_t>>>(1);
+    const uint8_t* first_data;
+    {
+        auto buffer = pool->acquire();
+        buffer->resize(4096);
+        first_data = buffer->data();
+        
+        auto extra = pool->acquire();
+        buffer.reset();
+        extra.reset(); // Beyond max_idle, so freed
+    }
+    EXPECT_EQ(pool->idle(), 1);
+    
+    // Handed back with its capacity, ready to be overwritten in place
+    auto reused = pool->acquire();
+    EXPECT_EQ(pool->idle(), 0);
+    EXPECT_GE(reused->capacity(), 4096);
+    EXPECT_EQ(reused->data(), first_data);
+    
+    // Releasing after the pool is gone just frees the buffer
+    pool.reset();
+    reused.reset();
+}
+
+TEST(SimdKernelTest, EveryLevelMatchesScalar) {
+    const auto selected = utils::simd_level();
+    EXPECT_TRUE(utils::simd_supported(selected));
+    EXPECT_TRUE(utils::simd_supported(utils::SimdLevel::Scalar));
+    
+    std::mt19937_64 gen(7);
+    std::vector<int64_t> timestamps(1000);
+    int64_t ts = 1'700'000'000'000'000'000;
+    for (auto& t : timestamps) {
+        t = ts += static_cast<int64_t>(gen() % 5000);
+    }
+    std::vector<double> values(1000);
+    for (auto& v : values) {
+        v = static_cast<double>(gen() % 100000) / 100.0;
+    }
+    
+    for (auto level : {utils::SimdLevel::Scalar, utils::SimdLevel::Avx2, utils::SimdLevel::Avx512}) {
+        if (!utils::simd_supported(level)) {
+            EXPECT_THROW(utils::set_simd_level(level), std::runtime_error);
+            continue;
+        }
+        SCOPED_TRACE(utils::simd_level_name(level));
+        utils::set_simd_level(level);
+        EXPECT_EQ(utils::simd_level(), level);
+        
+        // Every length up to two 8-lane vectors exercises the tail paths
+        for (size_t n = 0; n <= 17; ++n) {
+            std::vector<int64_t> deltas(n);
+            std::vector<uint64_t> residuals(n);
+            for (size_t i = 0; i < n; ++i) {
+                deltas[i] = static_cast<int64_t>(gen()) >> 8;
+                residuals[i] = gen();
+            }
+            auto sum_expected = deltas;
+            auto xor_expected = residuals;
+            utils::prefix_sum_scalar(sum_expected);
+            utils::prefix_xor_scalar(xor_expected);
+            utils::prefix_sum(deltas);
+            utils::prefix_xor(residuals);
+            EXPECT_EQ(deltas, sum_expected);
+            EXPECT_EQ(residuals, xor_expected);
+        }
+        EXPECT_EQ(utils::decompress_timestamps(utils::compress_timestamps(timestamps)), timestamps);
+        EXPECT_EQ(utils::decompress_doubles(utils::compress_doubles(values)), values);
+    }
+    utils::set_simd_level(selected);
+}
+
+TEST(GorillaCodecTest, RejectsCountLargerThanStream) {
+    auto value_stream = utils::compress_doubles(std::vector<double>{1.5, 2.5, 3.5});
+    auto ts_stream = utils::compress_timestamps(std::vector<int64_t>{10, 20, 30});
+    
+    // A corrupt count header must fail before the output is sized from it
+    const uint64_t huge = uint64_t{1} << 60;
+    std::memcpy(value_stream.data(), &huge, sizeof(huge));
+    std::memcpy(ts_stream.data(), &huge, sizeof(huge));
+    EXPECT_THROW(utils::decompress_doubles(value_stream), std::runtime_error);
+    EXPECT_THROW(utils::decompress_timestamps(ts_stream), std::runtime_error);
+}
+
+TEST_F(DiskLayerTest, ReadersPinSegmentsAcrossCompaction) {
+    DiskConfig config;
+    config.points_per_block = 16;
+    config.background_compaction = false;
+    auto dir = test_dir_ / "pinned";
+    DiskLayer layer(dir, config);
+    
+    auto start_time = system_clock::now();
+    std::vector<TimeSeriesPoint> all;
+    for (int i = 0; i < 4; ++i) {
+        auto batch = generate_test_data("TSLA", 50, start_time + milliseconds(100 * i), microseconds(1000));
+        ASSERT_TRUE(layer.write_batch(batch));
+        all.insert(all.end(), batch.begin(), batch.end());
+    }
+    
+    // A cursor opened before the compaction reads the old segments, which
+    // outlive the compaction until the cursor is gone
+    auto cursor = layer.open_cursor("TSLA", start_time, start_time + seconds(1));
+    layer.compact_segments("TSLA");
+    EXPECT_EQ(count_segment_files(dir), 5);
+    
+    std::vector<TimeSeriesPoint> batch;
+    size_t read = 0;
+    while (cursor.next(batch, 37)) {
+        for (const auto& point : batch) {
+            ASSERT_LT(read, all.size());
+            EXPECT_EQ(point.timestamp, all[read].timestamp);
+            EXPECT_DOUBLE_EQ(point.value, all[read].value);
+            ++read;
+        }
+    }
+    EXPECT_EQ(read, all.size());
+    { auto done = std::move(cursor); }
+    EXPECT_EQ(count_segment_files(dir), 1);
+    
+    // A scan holds no lock while visiting, so maintenance can run inside it
+    auto extra = generate_test_data("TSLA", 50, start_time + seconds(2), microseconds(1000));
+    size_t scanned = 0;
+    bool wrote = false;
+    layer.scan_range("TSLA", start_time, start_time + seconds(3),
+        [&](std::span<const int64_t> timestamps, std::span<const double>) {
+            scanned += timestamps.size();
+            if (!wrote) {
+                wrote = true;
+                ASSERT_TRUE(layer.write_batch(extra));
+                layer.compact_segments("TSLA");
+            }
+        });
+    EXPECT_EQ(scanned, all.size());
+    EXPECT_EQ(layer.read_range("TSLA", start_time, start_time + seconds(3)).size(), all.size() + extra.size());
+    EXPECT_EQ(count_segment_files(dir), 1);
+}
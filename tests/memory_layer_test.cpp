@@ -4,6 +4,8 @@
 #include <thread>
 #include <future>
 #include <random>
+#include <algorithm>
+#include <cmath>
 
 using namespace findata_engine;
 using namespace std::chrono;
@@ -144,3 +146,195 @@ TEST_F(MemoryLayerTest, CacheManagement) {
             return a.timestamp < b.timestamp;
         }));
 }
+
+TEST_F(MemoryLayerTest, ColumnarScan) {
+    auto start_time = system_clock::now();
+    std::vector<TimeSeriesPoint> points;
+    for (int i = 0; i < 100; ++i) {
+        points.push_back(TimeSeriesPoint{
+            .timestamp = start_time + microseconds(i * 1000),
+            .value = static_cast<double>(i),
+            .symbol = "NVDA"
+        });
+    }
+    EXPECT_TRUE(layer_->insert_batch(points));
+    
+    size_t visited = 0;
+    layer_->scan_range("NVDA", start_time + microseconds(10000), start_time + microseconds(19000),
+        [&](std::span<const int64_t> timestamps, std::span<const double> values) {
+            ASSERT_EQ(timestamps.size(), values.size());
+            visited += values.size();
+            EXPECT_DOUBLE_EQ(values.front(), 10.0);
+            EXPECT_DOUBLE_EQ(values.back(), 19.0);
+            EXPECT_TRUE(std::is_sorted(timestamps.begin(), timestamps.end()));
+        });
+    EXPECT_EQ(visited, 10);
+}
+
+TEST_F(MemoryLayerTest, OutOfOrderInsert) {
+    auto start_time = system_clock::now();
+    const int num_points = 5000;
+    
+    // Nearly sorted feed: every fourth point arrives a few ticks late
+    std::vector<int> order;
+    for (int i = 0; i < num_points; i += 4) {
+        order.insert(order.end(), {i + 1, i + 2, i + 3, i});
+    }
+    for (int i : order) {
+        EXPECT_TRUE(layer_->insert(TimeSeriesPoint{
+            .timestamp = start_time + microseconds(i * 1000),
+            .value = static_cast<double>(i),
+            .symbol = "AAPL"
+        }));
+    }
+    
+    // Duplicates are rejected whether they hit the tail or a buffered point
+    EXPECT_FALSE(layer_->insert(TimeSeriesPoint{
+        .timestamp = start_time + microseconds(4996 * 1000), .value = 0.0, .symbol = "AAPL"}));
+    EXPECT_FALSE(layer_->insert(TimeSeriesPoint{
+        .timestamp = start_time + microseconds(4999 * 1000), .value = 0.0, .symbol = "AAPL"}));
+    
+    auto latest = layer_->get_latest("AAPL");
+    ASSERT_TRUE(latest.has_value());
+    EXPECT_DOUBLE_EQ(latest->value, num_points - 1);
+    
+    auto results = layer_->get_range("AAPL", start_time, start_time + seconds(10));
+    ASSERT_EQ(results.size(), num_points);
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_DOUBLE_EQ(results[i].value, static_cast<double>(i));
+    }
+    EXPECT_EQ(layer_->get_total_points(), num_points);
+}
+
+TEST(MemoryLayerColumnsTest, InsertColumnsMergesOnlyOverlap) {
+    auto catalog = std::make_shared<SymbolCatalog>();
+    MemoryLayer layer(64, catalog);
+    const SymbolId id = catalog->intern("AAPL");
+    
+    // Even ticks first, in order
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+    for (int64_t t = 0; t < 1000; t += 2) {
+        ts.push_back(t);
+        values.push_back(static_cast<double>(t));
+    }
+    ASSERT_TRUE(layer.insert_columns(id, ts, values));
+    
+    // Unsorted run overlapping the tail: odd ticks, a repeat of an even
+    // tick, and a duplicate within the run; first copies win
+    std::vector<int64_t> late_ts{1001, 995, 998, 997, 997, 999};
+    std::vector<double> late_values{-1, -1, -1, -1, -2, -1};
+    std::vector<uint8_t> accepted;
+    ASSERT_TRUE(layer.insert_columns(id, late_ts, late_values, &accepted));
+    EXPECT_EQ(accepted, (std::vector<uint8_t>{1, 1, 0, 1, 0, 1}));
+    EXPECT_FALSE(layer.insert_columns(id, std::vector<int64_t>{1}, std::vector<double>{}));
+    
+    auto points = layer.get_range(id, system_clock::time_point::min(), system_clock::time_point::max());
+    ASSERT_EQ(points.size(), 500 + 4);
+    for (size_t i = 1; i < points.size(); ++i) {
+        EXPECT_LT(points[i - 1].timestamp, points[i].timestamp);
+    }
+    auto value_at = [&](int64_t t) {
+        for (const auto& point : points) {
+            if (point.timestamp.time_since_epoch().count() == t) return point.value;
+        }
+        return std::nan("");
+    };
+    EXPECT_DOUBLE_EQ(value_at(998), 998.0);
+    EXPECT_DOUBLE_EQ(value_at(997), -1.0);
+    EXPECT_DOUBLE_EQ(value_at(1001), -1.0);
+    EXPECT_EQ(layer.cache_size(), 504);
+    EXPECT_EQ(layer.get_latest("AAPL")->timestamp.time_since_epoch().count(), 1001);
+}
+
+TEST(MemoryLayerColumnsTest, AccountsBytesAndFreezesSubsets) {
+    auto catalog = std::make_shared<SymbolCatalog>();
+    MemoryLayer layer(1, catalog);
+    EXPECT_EQ(layer.memory_budget(), 1024 * 1024);
+    EXPECT_EQ(layer.memory_usage(), 0);
+    
+    const SymbolId big = catalog->intern("BIG");
+    const SymbolId small = catalog->intern("SMALL");
+    std::vector<int64_t> ts(10000);
+    std::vector<double> values(ts.size(), 1.0);
+    for (size_t i = 0; i < ts.size(); ++i) ts[i] = static_cast<int64_t>(i);
+    layer.set_epoch(3);
+    ASSERT_TRUE(layer.insert_columns(big, ts, values));
+    layer.set_epoch(5);
+    ASSERT_TRUE(layer.insert(small, system_clock::time_point(system_clock::duration(1)), 1.0));
+    
+    EXPECT_GE(layer.memory_usage(), ts.size() * (sizeof(int64_t) + sizeof(double)));
+    auto usage = layer.active_usage();
+    ASSERT_EQ(usage.size(), 2);
+    auto big_usage = std::find_if(usage.begin(), usage.end(), [&](const auto& u) { return u.id == big; });
+    ASSERT_NE(big_usage, usage.end());
+    EXPECT_EQ(big_usage->points, ts.size());
+    EXPECT_EQ(layer.oldest_epoch(), 3u);
+    
+    // Only BIG moves to a snapshot; its epoch holds until it is released
+    const std::vector<SymbolId> spill{big};
+    EXPECT_EQ(layer.freeze(spill), ts.size());
+    EXPECT_EQ(layer.cache_size(), 1);
+    EXPECT_EQ(layer.get_frozen_symbols(), std::vector<std::string>{"BIG"});
+    EXPECT_EQ(layer.oldest_epoch(), 3u);
+    
+    const size_t before_release = layer.memory_usage();
+    layer.release_frozen("BIG");
+    EXPECT_LT(layer.memory_usage() + ts.size() * sizeof(int64_t), before_release);
+    EXPECT_EQ(layer.oldest_epoch(), 5u);
+
+    // With every point flushed, out-of-order buffer included, only the
+    // symbol entries are left and none of that is releasable
+    ASSERT_TRUE(layer.insert(small, system_clock::time_point(system_clock::duration(0)), 1.0));
+    layer.freeze();
+    layer.release_frozen("SMALL");
+    EXPECT_FALSE(layer.oldest_epoch().has_value());
+    EXPECT_GT(layer.memory_usage(), 0);
+    EXPECT_EQ(layer.releasable_usage(), 0);
+
+    layer.clear_cache();
+    EXPECT_FALSE(layer.oldest_epoch().has_value());
+}
+
+TEST(MemoryLayerColumnsTest, ChunksSpanBoundariesAndAreRecycled) {
+    auto catalog = std::make_shared<SymbolCatalog>();
+    MemoryLayer layer(64, catalog);
+    const SymbolId id = catalog->intern("SPY");
+    
+    // Several chunks' worth, written back to front in runs so merges cut
+    // across chunk boundaries
+    const int64_t num_points = 5000;
+    for (int64_t run = num_points; run > 0; run -= 700) {
+        std::vector<int64_t> ts;
+        std::vector<double> values;
+        for (int64_t t = std::max<int64_t>(run - 700, 0); t < run; ++t) {
+            ts.push_back(t);
+            values.push_back(static_cast<double>(t));
+        }
+        ASSERT_TRUE(layer.insert_columns(id, ts, values));
+    }
+    ASSERT_EQ(layer.cache_size(), num_points);
+    
+    std::vector<int64_t> scanned;
+    layer.scan_range("SPY", system_clock::time_point(system_clock::duration(100)),
+                     system_clock::time_point(system_clock::duration(4899)),
+        [&](std::span<const int64_t> timestamps, std::span<const double> values) {
+            for (size_t i = 0; i < timestamps.size(); ++i) {
+                EXPECT_DOUBLE_EQ(values[i], static_cast<double>(timestamps[i]));
+                scanned.push_back(timestamps[i]);
+            }
+        });
+    ASSERT_EQ(scanned.size(), 4800);
+    for (size_t i = 0; i < scanned.size(); ++i) {
+        EXPECT_EQ(scanned[i], static_cast<int64_t>(i) + 100);
+    }
+    
+    // A flushed snapshot's chunks go back to the pool and feed new writes
+    EXPECT_EQ(layer.pooled_bytes(), 0);
+    layer.freeze();
+    layer.release_frozen("SPY");
+    const size_t pooled = layer.pooled_bytes();
+    EXPECT_GT(pooled, 0);
+    ASSERT_TRUE(layer.insert(id, system_clock::time_point(system_clock::duration(num_points)), 1.0));
+    EXPECT_LT(layer.pooled_bytes(), pooled);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "findata_engine/metrics.hpp"
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+using namespace findata_engine;
+
+TEST(MetricsTest, HistogramQuantilesWithinBucketError) {
+    metrics::Histogram histogram;
+    EXPECT_EQ(histogram.summary().count, 0);
+    EXPECT_EQ(histogram.summary().p99_ns, 0);
+    
+    for (uint64_t ns = 1; ns <= 10'000; ++ns) {
+        histogram.record(ns * 1000);
+    }
+    const auto summary = histogram.summary();
+    EXPECT_EQ(summary.count, 10'000);
+    EXPECT_EQ(summary.max_ns, 10'000'000);
+    EXPECT_DOUBLE_EQ(summary.mean_ns(), 5'000'500.0);
+    // Buckets are 1/16 of their power of two wide
+    EXPECT_NEAR(summary.p50_ns, 5'000'000, 5'000'000 / 16);
+    EXPECT_NEAR(summary.p90_ns, 9'000'000, 9'000'000 / 16);
+    EXPECT_NEAR(summary.p99_ns, 9'900'000, 9'900'000 / 16);
+    EXPECT_GE(summary.p999_ns, summary.p99_ns);
+    EXPECT_LE(summary.p999_ns, summary.max_ns);
+    
+    metrics::Histogram small;
+    small.record(uint64_t{3});
+    EXPECT_EQ(small.summary().p50_ns, 3);
+}
+
+TEST(MetricsTest, CountersAndLockWaitsAcrossThreads) {
+    metrics::Counter counter;
+    metrics::Histogram waits;
+    std::shared_mutex mutex;
+    
+    // Uncontended acquisitions record nothing
+    { auto lock = metrics::lock_unique(mutex, waits); }
+    { auto lock = metrics::lock_shared(mutex, waits); }
+    EXPECT_EQ(waits.summary().count, 0);
+    
+    std::vector<std::thread> threads;
+    {
+        auto held = metrics::lock_unique(mutex, waits);
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < 1000; ++i) {
+                    counter.add();
+                }
+                auto lock = metrics::lock_shared(mutex, waits);
+            });
+        }
+        // Let the readers reach the lock before releasing it
+        while (counter.value() < 4000) std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(counter.value(), 4000);
+    EXPECT_GT(waits.summary().count, 0);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "findata_engine/rollup.hpp"
+#include <chrono>
+
+using namespace findata_engine;
+using namespace std::chrono;
+
+class RollupTest : public ::testing::Test {
+protected:
+    static TimeSeriesPoint tick(system_clock::time_point ts, double value) {
+        return TimeSeriesPoint{.timestamp = ts, .value = value, .symbol = "AAPL"};
+    }
+    
+    system_clock::time_point base_ = system_clock::time_point(hours(500000));
+};
+
+TEST_F(RollupTest, BuildsBarsPerBucket) {
+    std::vector<TimeSeriesPoint> points = {
+        tick(base_ + seconds(1), 10.0),
+        tick(base_ + seconds(20), 12.0),
+        tick(base_ + seconds(59), 9.0),
+        tick(base_ + seconds(61), 11.0),
+    };
+    auto bars = rollup::build(points, minutes(1));
+    
+    ASSERT_EQ(bars.size(), 2);
+    EXPECT_EQ(bars[0].start, base_);
+    EXPECT_DOUBLE_EQ(bars[0].open, 10.0);
+    EXPECT_DOUBLE_EQ(bars[0].high, 12.0);
+    EXPECT_DOUBLE_EQ(bars[0].low, 9.0);
+    EXPECT_DOUBLE_EQ(bars[0].close, 9.0);
+    EXPECT_EQ(bars[0].count, 3);
+    EXPECT_DOUBLE_EQ(bars[0].sum, 31.0);
+    EXPECT_EQ(bars[1].start, base_ + minutes(1));
+    EXPECT_EQ(bars[1].count, 1);
+    
+    // Buckets stay epoch-aligned for negative ticks
+    auto before_epoch = system_clock::time_point(-milliseconds(1500));
+    EXPECT_EQ(rollup::bucket_start(before_epoch, seconds(1)), system_clock::time_point(-seconds(2)));
+    EXPECT_EQ(rollup::bucket_end(system_clock::time_point::max(), hours(1)), system_clock::time_point::max());
+}
+
+TEST_F(RollupTest, MergesSplitBucketsAndRoundTrips) {
+    std::vector<TimeSeriesPoint> first = {tick(base_ + seconds(1), 10.0), tick(base_ + seconds(2), 14.0)};
+    std::vector<TimeSeriesPoint> second = {tick(base_ + seconds(3), 8.0), tick(base_ + seconds(70), 5.0)};
+    auto merged = rollup::merge(rollup::build(first, minutes(1)), rollup::build(second, minutes(1)));
+    
+    ASSERT_EQ(merged.size(), 2);
+    EXPECT_DOUBLE_EQ(merged[0].open, 10.0);
+    EXPECT_DOUBLE_EQ(merged[0].high, 14.0);
+    EXPECT_DOUBLE_EQ(merged[0].low, 8.0);
+    EXPECT_DOUBLE_EQ(merged[0].close, 8.0);
+    EXPECT_EQ(merged[0].count, 3);
+    
+    auto points = rollup::to_points(rollup::series_name("AAPL", minutes(1)), merged);
+    ASSERT_EQ(points.size(), 12);
+    EXPECT_EQ(points.front().symbol, "AAPL#60s");
+    auto decoded = rollup::from_points(points);
+    ASSERT_EQ(decoded.size(), merged.size());
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        EXPECT_EQ(decoded[i].start, merged[i].start);
+        EXPECT_DOUBLE_EQ(decoded[i].close, merged[i].close);
+        EXPECT_EQ(decoded[i].count, merged[i].count);
+        EXPECT_DOUBLE_EQ(decoded[i].sum, merged[i].sum);
+    }
+    
+    // A bar with missing fields is skipped rather than misread
+    points.erase(points.begin() + 2);
+    EXPECT_EQ(rollup::from_points(points).size(), 1);
+}
@@ -5,6 +5,8 @@
 #include <chrono>
 #include <future>
 #include <thread>
+#include <map>
+#include <mutex>
 
 using namespace findata_engine;
 using namespace std::chrono;
@@ -286,3 +288,644 @@ TEST_F(StorageEngineTest, OptimizationAndCompaction) {
     
     std::cout << "Test completed successfully." << std::endl;
 }
+
+TEST_F(StorageEngineTest, ParallelWritersOnDisjointSymbols) {
+    const int num_threads = 8;
+    const int points_per_thread = 1000;
+    auto start_time = system_clock::now();
+    
+    std::vector<std::thread> writers;
+    for (int t = 0; t < num_threads; ++t) {
+        writers.emplace_back([this, t, start_time]() {
+            std::string symbol = "SYM" + std::to_string(t);
+            for (int i = 0; i < points_per_thread; ++i) {
+                EXPECT_TRUE(engine_->write_point(TimeSeriesPoint{
+                    .timestamp = start_time + microseconds(i),
+                    .value = static_cast<double>(i),
+                    .symbol = symbol
+                }));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    
+    EXPECT_EQ(engine_->get_stats().total_points, num_threads * points_per_thread);
+    for (int t = 0; t < num_threads; ++t) {
+        auto results = engine_->read_range(
+            "SYM" + std::to_string(t), start_time, start_time + seconds(1));
+        EXPECT_EQ(results.size(), points_per_thread);
+    }
+}
+
+TEST_F(StorageEngineTest, BackgroundFlushKeepsWritesVisible) {
+    auto dir = test_dir_ / "background_flush";
+    EngineConfig config{
+        .memory_cache_size_mb = 64,
+        .data_directory = dir,
+        .max_memory_points = 500
+    };
+    StorageEngine engine(config);
+    
+    // Segments store microsecond timestamps
+    auto start_time = time_point_cast<microseconds>(system_clock::now());
+    const int num_points = 5000;
+    for (int i = 0; i < num_points; ++i) {
+        ASSERT_TRUE(engine.write_point(TimeSeriesPoint{
+            .timestamp = start_time + microseconds(i),
+            .value = static_cast<double>(i),
+            .symbol = "AAPL"
+        }));
+        
+        // Nothing written so far may disappear while flushes run behind us
+        if (i % 1000 == 999) {
+            auto results = engine.read_range("AAPL", start_time, start_time + microseconds(i));
+            ASSERT_EQ(results.size(), i + 1);
+        }
+    }
+    
+    EXPECT_TRUE(engine.flush());
+    EXPECT_GT(engine.get_stats().storage_size_bytes, 0);
+    
+    auto results = engine.read_range("AAPL", start_time, start_time + seconds(1));
+    ASSERT_EQ(results.size(), num_points);
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_DOUBLE_EQ(results[i].value, static_cast<double>(i));
+    }
+}
+
+TEST_F(StorageEngineTest, RecoverFromWriteAheadLog) {
+    auto dir = test_dir_ / "wal_recovery";
+    EngineConfig config{
+        .memory_cache_size_mb = 64,
+        .data_directory = dir
+    };
+    
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("TSLA", 100, start_time, microseconds(1000));
+    {
+        StorageEngine engine(config);
+        EXPECT_TRUE(engine.write_batch(points));
+        EXPECT_TRUE(engine.write_point(TimeSeriesPoint{
+            .timestamp = start_time + seconds(1), .value = 42.0, .symbol = "TSLA"}));
+        // Dropped without flush, as in a crash
+    }
+    
+    StorageEngine recovered(config);
+    auto results = recovered.read_range("TSLA", start_time, start_time + seconds(1));
+    ASSERT_EQ(results.size(), points.size() + 1);
+    for (size_t i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(results[i].timestamp, points[i].timestamp);
+        EXPECT_DOUBLE_EQ(results[i].value, points[i].value);
+    }
+    EXPECT_DOUBLE_EQ(results.back().value, 42.0);
+}
+
+TEST_F(StorageEngineTest, LatestSurvivesFlushAndRestart) {
+    auto dir = test_dir_ / "latest";
+    EngineConfig config{
+        .memory_cache_size_mb = 64,
+        .data_directory = dir,
+        .enable_wal = false
+    };
+    
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("NVDA", 5000, start_time, microseconds(100));
+    const auto newest = points.back().timestamp;
+    {
+        StorageEngine engine(config);
+        ASSERT_TRUE(engine.write_batch(points));
+        ASSERT_TRUE(engine.flush());
+        
+        // A late point, then a rewrite of the flushed newest timestamp
+        ASSERT_TRUE(engine.write_point(TimeSeriesPoint{
+            .timestamp = start_time - seconds(1), .value = -1.0, .symbol = "NVDA"}));
+        EXPECT_EQ(engine.get_latest("NVDA")->timestamp, newest);
+        ASSERT_TRUE(engine.write_point(TimeSeriesPoint{
+            .timestamp = newest, .value = 7.0, .symbol = "NVDA"}));
+        // The memtable keeps the first copy of a timestamp
+        EXPECT_FALSE(engine.write_point(TimeSeriesPoint{
+            .timestamp = newest, .value = 8.0, .symbol = "NVDA"}));
+        ASSERT_TRUE(engine.flush());
+        
+        // Served without decoding any segment block
+        const auto misses = engine.get_stats().cache_misses;
+        for (int i = 0; i < 100; ++i) {
+            auto latest = engine.get_latest("NVDA");
+            ASSERT_TRUE(latest.has_value());
+            EXPECT_EQ(latest->timestamp, newest);
+            EXPECT_DOUBLE_EQ(latest->value, 7.0);
+        }
+        EXPECT_EQ(engine.get_stats().cache_misses, misses);
+        EXPECT_FALSE(engine.get_latest("MISSING").has_value());
+    }
+    
+    StorageEngine reopened(config);
+    auto latest = reopened.get_latest("NVDA");
+    ASSERT_TRUE(latest.has_value());
+    EXPECT_EQ(latest->timestamp, newest);
+    EXPECT_DOUBLE_EQ(latest->value, 7.0);
+}
+
+TEST_F(StorageEngineTest, SymbolIdsCoverMemoryAndDisk) {
+    auto dir = test_dir_ / "catalog";
+    EngineConfig config{
+        .memory_cache_size_mb = 64,
+        .data_directory = dir,
+        .enable_wal = false
+    };
+    config.rollup_intervals = {seconds(60)};
+    
+    auto start_time = system_clock::now();
+    SymbolId ibm;
+    {
+        StorageEngine engine(config);
+        ibm = engine.intern_symbol("IBM");
+        EXPECT_EQ(engine.find_symbol("IBM"), ibm);
+        EXPECT_EQ(engine.symbol_name(ibm), "IBM");
+        
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(engine.write_point(ibm, start_time + milliseconds(i), i));
+        }
+        ASSERT_TRUE(engine.flush());
+        ASSERT_TRUE(engine.write_point(TimeSeriesPoint{
+            .timestamp = start_time, .value = 1.0, .symbol = "ORCL"}));
+        
+        auto points = engine.read_range(ibm, start_time, start_time + seconds(1));
+        ASSERT_EQ(points.size(), 100);
+        EXPECT_EQ(points.back().symbol, "IBM");
+        EXPECT_DOUBLE_EQ(engine.get_latest(ibm)->value, 99.0);
+        EXPECT_EQ(engine.get_symbols(), (std::unordered_set<std::string>{"IBM", "ORCL"}));
+    }
+    
+    // Only IBM reached disk; its id is unchanged and rollups stay hidden
+    StorageEngine reopened(config);
+    EXPECT_EQ(reopened.find_symbol("IBM"), ibm);
+    EXPECT_EQ(reopened.get_symbols(), (std::unordered_set<std::string>{"IBM"}));
+    EXPECT_EQ(reopened.read_range(ibm, start_time, start_time + seconds(1)).size(), 100);
+}
+
+TEST_F(StorageEngineTest, DuplicatesDuringFlushNotReplayed) {
+    auto dir = test_dir_ / "flush_duplicates";
+    EngineConfig config{
+        .memory_cache_size_mb = 64,
+        .data_directory = dir
+    };
+    
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("NVDA", 200000, start_time, microseconds(1));
+    std::vector<TimeSeriesPoint> expected;
+    {
+        StorageEngine engine(config);
+        ASSERT_TRUE(engine.write_batch(points));
+        
+        // Rewrite the timestamps one at a time while the flush drains them.
+        // Copies sent while they are frozen are dropped; later ones win.
+        auto flushed = std::async(std::launch::async, [&] { return engine.flush(); });
+        for (size_t i = 0; flushed.wait_for(seconds(0)) != std::future_status::ready; i = (i + 1) % points.size()) {
+            auto copy = points[i];
+            copy.value = -1.0;
+            ASSERT_TRUE(engine.write_batch({copy}));
+        }
+        ASSERT_TRUE(flushed.get());
+        expected = engine.read_range("NVDA", start_time, start_time + seconds(1));
+        // Dropped without flush, as in a crash
+    }
+    
+    StorageEngine recovered(config);
+    auto results = recovered.read_range("NVDA", start_time, start_time + seconds(1));
+    ASSERT_EQ(results.size(), expected.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i].timestamp, expected[i].timestamp);
+        ASSERT_DOUBLE_EQ(results[i].value, expected[i].value) << "point " << i;
+    }
+}
+
+TEST_F(StorageEngineTest, WriteColumnsRecoversFromWriteAheadLog) {
+    auto dir = test_dir_ / "columns";
+    EngineConfig config{
+        .memory_cache_size_mb = 64,
+        .data_directory = dir
+    };
+    
+    const int64_t base = system_clock::now().time_since_epoch().count();
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+    for (int i = 0; i < 2000; ++i) {
+        ts.push_back(base + i * 1000);
+        values.push_back(i * 0.5);
+    }
+    
+    SymbolId id;
+    {
+        StorageEngine engine(config);
+        id = engine.intern_symbol("AMZN");
+        // Two halves, the second sent first
+        const size_t half = ts.size() / 2;
+        ASSERT_TRUE(engine.write_columns(id, std::span(ts).subspan(half), std::span(values).subspan(half)));
+        ASSERT_TRUE(engine.write_columns(id, std::span(ts).first(half), std::span(values).first(half)));
+        EXPECT_DOUBLE_EQ(engine.get_latest(id)->value, values.back());
+        // Dropped without flush, as in a crash
+    }
+    
+    StorageEngine recovered(config);
+    auto points = recovered.read_range(id, system_clock::time_point::min(), system_clock::time_point::max());
+    ASSERT_EQ(points.size(), ts.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(points[i].timestamp.time_since_epoch().count(), ts[i]);
+        EXPECT_DOUBLE_EQ(points[i].value, values[i]);
+        EXPECT_EQ(points[i].symbol, "AMZN");
+    }
+}
+
+TEST_F(StorageEngineTest, ByteBudgetSpillsLargestSymbol) {
+    auto dir = test_dir_ / "budget";
+    EngineConfig config{
+        .memory_cache_size_mb = 1,
+        .data_directory = dir,
+        .enable_wal = false
+    };
+    StorageEngine engine(config);
+    
+    auto start_time = time_point_cast<microseconds>(system_clock::now());
+    for (int s = 0; s < 20; ++s) {
+        for (int i = 0; i < 10; ++i) {
+            ASSERT_TRUE(engine.write_point(TimeSeriesPoint{
+                .timestamp = start_time + microseconds(i),
+                .value = static_cast<double>(i),
+                .symbol = "SMALL" + std::to_string(s)
+            }));
+        }
+    }
+    
+    // Well past the budget on its own
+    const SymbolId big = engine.intern_symbol("BIG");
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+    for (int i = 0; i < 100000; ++i) {
+        ts.push_back((start_time + microseconds(i)).time_since_epoch().count());
+        values.push_back(i);
+    }
+    ASSERT_TRUE(engine.write_columns(big, ts, values));
+    
+    auto segments_of = [&](const std::string& prefix) {
+        size_t count = 0;
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            const auto name = entry.path().filename().string();
+            if (name.rfind(prefix, 0) == 0 && entry.path().extension() == ".seg") ++count;
+        }
+        return count;
+    };
+    for (int i = 0; i < 500 && segments_of("BIG_") == 0; ++i) {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    ASSERT_GT(segments_of("BIG_"), 0);
+    for (int i = 0; i < 500 && engine.get_stats().memory_bytes >= 1024 * 1024; ++i) {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    EXPECT_LT(engine.get_stats().memory_bytes, 1024 * 1024);
+    
+    // The illiquid names were never worth a segment of their own
+    EXPECT_EQ(segments_of("SMALL"), 0);
+    EXPECT_EQ(engine.read_range("SMALL3", start_time, start_time + seconds(1)).size(), 10);
+    EXPECT_EQ(engine.read_range(big, system_clock::time_point::min(), system_clock::time_point::max()).size(),
+              ts.size());
+}
+
+TEST_F(StorageEngineTest, CursorMergesMemoryAndDiskInBatches) {
+    auto start_time = system_clock::now();
+    
+    // Even offsets go to disk, odd offsets stay in memory
+    std::vector<TimeSeriesPoint> disk_points, memory_points;
+    for (int i = 0; i < 1000; ++i) {
+        TimeSeriesPoint point{
+            .timestamp = start_time + microseconds(i * 100),
+            .value = static_cast<double>(i),
+            .symbol = "AMD"
+        };
+        (i % 2 == 0 ? disk_points : memory_points).push_back(point);
+    }
+    ASSERT_TRUE(engine_->write_batch(disk_points));
+    ASSERT_TRUE(engine_->flush());
+    ASSERT_TRUE(engine_->write_batch(memory_points));
+    
+    auto cursor = engine_->open_cursor("AMD", start_time, start_time + seconds(1));
+    std::vector<TimeSeriesPoint> batch;
+    std::vector<TimeSeriesPoint> all;
+    size_t batches = 0;
+    while (cursor.next(batch, 64)) {
+        EXPECT_LE(batch.size(), 64);
+        all.insert(all.end(), batch.begin(), batch.end());
+        ++batches;
+    }
+    
+    ASSERT_EQ(all.size(), 1000);
+    EXPECT_GE(batches, 1000 / 64);
+    for (size_t i = 0; i < all.size(); ++i) {
+        EXPECT_EQ(all[i].timestamp, start_time + microseconds(i * 100));
+        EXPECT_DOUBLE_EQ(all[i].value, static_cast<double>(i));
+    }
+}
+
+TEST_F(StorageEngineTest, ReadRangeMultiDeliversEverySymbol) {
+    auto start_time = system_clock::now();
+    std::vector<std::string> symbols;
+    std::map<std::string, std::vector<TimeSeriesPoint>> written;
+    for (int i = 0; i < 40; ++i) {
+        std::string symbol = "SYM" + std::to_string(i);
+        symbols.push_back(symbol);
+        written[symbol] = generate_test_data(symbol, 200 + i, start_time, microseconds(1000));
+        ASSERT_TRUE(engine_->write_batch(written[symbol]));
+        // Half the symbols are read back from segments
+        if (i == 19) {
+            ASSERT_TRUE(engine_->flush());
+        }
+    }
+    symbols.push_back("MISSING");
+    
+    std::mutex mutex;
+    std::map<std::string, std::vector<TimeSeriesPoint>> delivered;
+    engine_->read_range_multi(symbols, start_time, start_time + seconds(1),
+        [&](const std::string& symbol, std::vector<TimeSeriesPoint>&& points) {
+            std::lock_guard lock(mutex);
+            EXPECT_TRUE(delivered.emplace(symbol, std::move(points)).second);
+        });
+    
+    ASSERT_EQ(delivered.size(), symbols.size());
+    EXPECT_TRUE(delivered["MISSING"].empty());
+    for (const auto& [symbol, points] : written) {
+        const auto& got = delivered[symbol];
+        ASSERT_EQ(got.size(), points.size()) << symbol;
+        for (size_t i = 0; i < got.size(); ++i) {
+            EXPECT_EQ(got[i].timestamp, points[i].timestamp);
+            EXPECT_DOUBLE_EQ(got[i].value, points[i].value);
+        }
+    }
+    
+    // A failing callback surfaces on the calling thread
+    EXPECT_THROW(engine_->read_range_multi(symbols, start_time, start_time + seconds(1),
+        [](const std::string&, std::vector<TimeSeriesPoint>&&) {
+            throw std::runtime_error("consumer failed");
+        }), std::runtime_error);
+}
+
+TEST_F(StorageEngineTest, ReadRangeMultiNestsFromCallback) {
+    auto dir = test_dir_ / "nested";
+    StorageEngine engine(EngineConfig{.data_directory = dir, .scan_threads = 1});
+    auto start_time = system_clock::now();
+    std::vector<std::string> symbols;
+    for (int i = 0; i < 8; ++i) {
+        symbols.push_back("SYM" + std::to_string(i));
+        ASSERT_TRUE(engine.write_batch(generate_test_data(symbols.back(), 10, start_time, microseconds(1000))));
+    }
+    
+    // A callback on the single pool worker reads again; the inner call's
+    // helper queues behind that worker and must not be waited for
+    std::atomic<size_t> inner{0};
+    engine.read_range_multi(symbols, start_time, start_time + seconds(1),
+        [&](const std::string&, std::vector<TimeSeriesPoint>&&) {
+            engine.read_range_multi(symbols, start_time, start_time + seconds(1),
+                [&](const std::string&, std::vector<TimeSeriesPoint>&& points) {
+                    EXPECT_EQ(points.size(), 10u);
+                    ++inner;
+                });
+        });
+    EXPECT_EQ(inner.load(), symbols.size() * symbols.size());
+}
+
+TEST_F(StorageEngineTest, BarsServedFromRollups) {
+    auto dir = test_dir_ / "rollups";
+    EngineConfig config{
+        .data_directory = dir,
+        .rollup_intervals = {seconds(1), minutes(1)}
+    };
+    StorageEngine engine(config);
+    
+    // A flush lands in the middle of a bucket
+    auto start_time = rollup::bucket_start(system_clock::now(), minutes(1));
+    auto points = generate_test_data("QQQ", 3000, start_time, microseconds(50000));
+    ASSERT_TRUE(engine.write_batch({points.begin(), points.begin() + 1234}));
+    ASSERT_TRUE(engine.flush());
+    ASSERT_TRUE(engine.write_batch({points.begin() + 1234, points.end()}));
+    
+    for (auto interval : {seconds(1), seconds(60), seconds(5)}) {
+        auto expected = rollup::build(points, interval);
+        auto bars = engine.read_bars("QQQ", interval, start_time, start_time + minutes(10));
+        ASSERT_EQ(bars.size(), expected.size()) << interval.count();
+        for (size_t i = 0; i < bars.size(); ++i) {
+            EXPECT_EQ(bars[i].start, expected[i].start);
+            EXPECT_DOUBLE_EQ(bars[i].open, expected[i].open);
+            EXPECT_DOUBLE_EQ(bars[i].high, expected[i].high);
+            EXPECT_DOUBLE_EQ(bars[i].low, expected[i].low);
+            EXPECT_DOUBLE_EQ(bars[i].close, expected[i].close);
+            EXPECT_EQ(bars[i].count, expected[i].count);
+            EXPECT_NEAR(bars[i].sum, expected[i].sum, 1e-6);
+        }
+    }
+    
+    // Once everything is flushed the bars come from disk alone
+    ASSERT_TRUE(engine.flush());
+    auto minute_bars = engine.read_bars("QQQ", minutes(1), start_time, start_time + minutes(10));
+    ASSERT_EQ(minute_bars.size(), 3);
+    EXPECT_EQ(minute_bars[0].count, 1200);
+    EXPECT_EQ(minute_bars[2].count, 600);
+}
+
+TEST_F(StorageEngineTest, BarsCountEachTickOnce) {
+    auto dir = test_dir_ / "rollup_replay";
+    EngineConfig config{
+        .memory_cache_size_mb = 1,
+        .data_directory = dir,
+        .rollup_intervals = {minutes(1)}
+    };
+    auto segments_of = [&](const std::string& prefix) {
+        size_t count = 0;
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            const auto name = entry.path().filename().string();
+            if (name.rfind(prefix, 0) == 0 && entry.path().extension() == ".seg") ++count;
+        }
+        return count;
+    };
+
+    auto start_time = rollup::bucket_start(system_clock::now(), minutes(1));
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+    for (int i = 0; i < 100000; ++i) {
+        ts.push_back((start_time + microseconds(i)).time_since_epoch().count());
+        values.push_back(i);
+    }
+    size_t tick_segments = 0;
+    {
+        StorageEngine engine(config);
+        ASSERT_TRUE(engine.write_point(TimeSeriesPoint{.timestamp = start_time, .value = 1.0, .symbol = "SMALL"}));
+
+        // BIG alone is spilled; SMALL keeps the WAL files that hold BIG too
+        ASSERT_TRUE(engine.write_columns(engine.intern_symbol("BIG"), ts, values));
+        for (int i = 0; i < 500 && segments_of("BIG#60s_") == 0; ++i) {
+            std::this_thread::sleep_for(milliseconds(10));
+        }
+        ASSERT_GT(segments_of("BIG#60s_"), 0);
+        tick_segments = segments_of("BIG_");
+        EXPECT_EQ(segments_of("SMALL"), 0);
+        // Dropped without flush, as in a crash
+    }
+
+    StorageEngine recovered(config);
+    ASSERT_TRUE(recovered.flush());
+    EXPECT_EQ(segments_of("BIG_"), tick_segments);
+    auto bars = recovered.read_bars("BIG", minutes(1), start_time, start_time);
+    ASSERT_EQ(bars.size(), 1);
+    EXPECT_EQ(bars[0].count, ts.size());
+
+    // A rewrite of a flushed tick replaces it, before and after its flush
+    ASSERT_TRUE(recovered.write_point(TimeSeriesPoint{.timestamp = start_time, .value = -1.0, .symbol = "BIG"}));
+    for (bool flushed : {false, true}) {
+        if (flushed) {
+            ASSERT_TRUE(recovered.flush());
+        }
+        bars = recovered.read_bars("BIG", minutes(1), start_time, start_time);
+        ASSERT_EQ(bars.size(), 1);
+        EXPECT_EQ(bars[0].count, ts.size()) << flushed;
+        EXPECT_DOUBLE_EQ(bars[0].open, -1.0);
+        EXPECT_DOUBLE_EQ(bars[0].low, -1.0);
+        EXPECT_DOUBLE_EQ(bars[0].sum, (ts.size() - 1) * ts.size() / 2.0 - 1.0);
+    }
+}
+
+TEST_F(StorageEngineTest, BarsFoldLateTicksAcrossFlushes) {
+    auto dir = test_dir_ / "rollup_late";
+    StorageEngine engine(EngineConfig{.data_directory = dir, .rollup_intervals = {seconds(1)}});
+    auto start_time = rollup::bucket_start(system_clock::now(), seconds(1));
+    auto tick = [&](int ms, double value) {
+        return TimeSeriesPoint{.timestamp = start_time + milliseconds(ms), .value = value, .symbol = "LATE"};
+    };
+    auto expect_matches_ticks = [&](const char* step) {
+        auto expected = rollup::build(engine.read_range("LATE", start_time, start_time + seconds(10)), seconds(1));
+        auto bars = engine.read_bars("LATE", seconds(1), start_time, start_time + seconds(10));
+        ASSERT_EQ(bars.size(), expected.size()) << step;
+        for (size_t i = 0; i < bars.size(); ++i) {
+            EXPECT_EQ(bars[i].start, expected[i].start) << step;
+            EXPECT_DOUBLE_EQ(bars[i].open, expected[i].open) << step;
+            EXPECT_DOUBLE_EQ(bars[i].high, expected[i].high) << step;
+            EXPECT_DOUBLE_EQ(bars[i].low, expected[i].low) << step;
+            EXPECT_DOUBLE_EQ(bars[i].close, expected[i].close) << step;
+            EXPECT_EQ(bars[i].count, expected[i].count) << step;
+            EXPECT_DOUBLE_EQ(bars[i].sum, expected[i].sum) << step;
+        }
+    };
+    
+    ASSERT_TRUE(engine.write_batch({tick(100, 1), tick(600, 2), tick(1500, 3)}));
+    ASSERT_TRUE(engine.flush());
+    expect_matches_ticks("flushed");
+    
+    // Appends to the open bucket, a late tick before its open and a
+    // rewrite of a flushed one, both in memory and once flushed
+    ASSERT_TRUE(engine.write_batch({tick(50, 10), tick(1700, 4), tick(2200, 5)}));
+    ASSERT_TRUE(engine.write_point(tick(600, 20)));
+    for (const char* step : {"in memory", "refolded"}) {
+        expect_matches_ticks(step);
+        ASSERT_TRUE(engine.flush());
+    }
+    auto bars = engine.read_bars("LATE", seconds(1), start_time, start_time);
+    ASSERT_EQ(bars.size(), 1);
+    EXPECT_EQ(bars[0].count, 3);
+    EXPECT_DOUBLE_EQ(bars[0].open, 10);
+    EXPECT_DOUBLE_EQ(bars[0].close, 20);
+    
+    // Ticks can't be written into a rollup series
+    EXPECT_THROW(engine.write_point(TimeSeriesPoint{.timestamp = start_time, .value = 1.0, .symbol = "LATE#1s"}),
+                 std::invalid_argument);
+    EXPECT_THROW(engine.intern_symbol("LATE#1s"), std::invalid_argument);
+}
+
+TEST_F(StorageEngineTest, AggregateMergesMemoryOverDisk) {
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("XOM", 5000, start_time, microseconds(1000));
+    ASSERT_TRUE(engine_->write_batch(points));
+    ASSERT_TRUE(engine_->flush());
+    
+    // Memory rewrites part of the flushed range and extends past it
+    auto rewrites = generate_test_data("XOM", 300, start_time + microseconds(4800000), microseconds(1000));
+    ASSERT_TRUE(engine_->write_batch(rewrites));
+    
+    auto from = start_time + microseconds(1234000);
+    auto to = start_time + seconds(6);
+    auto visible = engine_->read_range("XOM", from, to);
+    ASSERT_FALSE(visible.empty());
+    double sum = 0, min = visible[0].value, max = visible[0].value;
+    for (const auto& point : visible) {
+        sum += point.value;
+        min = std::min(min, point.value);
+        max = std::max(max, point.value);
+    }
+    
+    EXPECT_DOUBLE_EQ(*engine_->aggregate("XOM", from, to, AggregateOp::Count), visible.size());
+    EXPECT_NEAR(*engine_->aggregate("XOM", from, to, AggregateOp::Sum), sum, 1e-6);
+    EXPECT_DOUBLE_EQ(*engine_->aggregate("XOM", from, to, AggregateOp::Min), min);
+    EXPECT_DOUBLE_EQ(*engine_->aggregate("XOM", from, to, AggregateOp::Max), max);
+    EXPECT_NEAR(*engine_->aggregate("XOM", from, to, AggregateOp::Mean), sum / visible.size(), 1e-9);
+    
+    EXPECT_EQ(*engine_->aggregate("NONE", from, to, AggregateOp::Count), 0.0);
+    EXPECT_FALSE(engine_->aggregate("NONE", from, to, AggregateOp::Mean).has_value());
+}
+
+TEST_F(StorageEngineTest, AnalyzeJoinsPriceAndVolume) {
+    auto start_time = system_clock::now();
+    auto prices = generate_test_data("SPY", 400, start_time, microseconds(1000));
+    auto volumes = generate_test_data("SPY.vol", 400, start_time, microseconds(1000));
+    // Every third volume tick is missing, and prices straddle a flush
+    std::vector<TimeSeriesPoint> sparse_volumes;
+    for (size_t i = 0; i < volumes.size(); ++i) {
+        if (i % 3 != 0) sparse_volumes.push_back(volumes[i]);
+    }
+    ASSERT_TRUE(engine_->write_batch({prices.begin(), prices.begin() + 150}));
+    ASSERT_TRUE(engine_->flush());
+    ASSERT_TRUE(engine_->write_batch({prices.begin() + 150, prices.end()}));
+    ASSERT_TRUE(engine_->write_batch(sparse_volumes));
+    
+    analytics::RollingSpec spec{.windows = {5}, .ema_alphas = {0.5}, .volume_symbol = "SPY.vol"};
+    auto result = engine_->analyze("SPY", start_time, start_time + seconds(1), spec);
+    ASSERT_EQ(result.timestamps.size(), sparse_volumes.size());
+    ASSERT_EQ(result.windows[0].vwap.size(), sparse_volumes.size());
+    
+    // Last window: the five most recent joined ticks
+    double pv = 0, vol = 0;
+    for (size_t k = sparse_volumes.size() - 5; k < sparse_volumes.size(); ++k) {
+        size_t i = (sparse_volumes[k].timestamp - start_time) / microseconds(1000);
+        pv += prices[i].value * sparse_volumes[k].value;
+        vol += sparse_volumes[k].value;
+    }
+    EXPECT_NEAR(result.windows[0].vwap.back(), pv / vol, 1e-9);
+    
+    spec.volume_symbol.clear();
+    auto plain = engine_->analyze("SPY", start_time, start_time + seconds(1), spec);
+    EXPECT_EQ(plain.timestamps.size(), prices.size());
+    EXPECT_TRUE(plain.windows[0].vwap.empty());
+}
+
+TEST_F(StorageEngineTest, StatsTrackRejectsLatencyAndIo) {
+    auto start_time = system_clock::now();
+    auto points = generate_test_data("IBM", 500, start_time, microseconds(1000));
+    ASSERT_TRUE(engine_->write_batch(points));
+    // Rewriting timestamps the memtable holds is dropped and counted
+    ASSERT_TRUE(engine_->write_batch({points.begin(), points.begin() + 20}));
+    EXPECT_FALSE(engine_->write_point(points[0]));
+    
+    auto stats = engine_->get_stats();
+    EXPECT_EQ(stats.total_points, 500);
+    EXPECT_EQ(stats.rejected_points, 21);
+    EXPECT_EQ(stats.write_latency.count, 3);
+    EXPECT_LE(stats.write_latency.p50_ns, stats.write_latency.max_ns);
+    
+    ASSERT_TRUE(engine_->flush());
+    auto result = engine_->read_range("IBM", start_time, start_time + seconds(1));
+    ASSERT_EQ(result.size(), points.size());
+    
+    stats = engine_->get_stats();
+    EXPECT_EQ(stats.flush_latency.count, 1);
+    EXPECT_EQ(stats.read_latency.count, 1);
+    EXPECT_GT(stats.decode_latency.count, 0);
+    EXPECT_GT(stats.bytes_written, 0);
+    EXPECT_GT(stats.bytes_read, 0);
+}
@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include "findata_engine/storage_engine.hpp"
+#include "findata_engine/subscription.hpp"
+#include "findata_engine/utils.hpp"
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace findata_engine;
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+class SubscriptionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = fs::temp_directory_path() / "findata_subscription_test";
+        fs::create_directories(test_dir_);
+        EngineConfig config;
+        config.memory_cache_size_mb = 64;
+        config.data_directory = test_dir_;
+        engine_ = std::make_unique<StorageEngine>(config);
+    }
+
+    void TearDown() override {
+        engine_.reset();
+        fs::remove_all(test_dir_);
+    }
+
+    // Drains whatever is pending
+    static std::vector<Tick> drain(Subscription& subscription) {
+        std::vector<Tick> ticks;
+        std::array<Tick, 64> batch;
+        while (size_t count = subscription.poll(batch)) {
+            ticks.insert(ticks.end(), batch.begin(), batch.begin() + count);
+        }
+        return ticks;
+    }
+
+    std::unique_ptr<StorageEngine> engine_;
+    fs::path test_dir_;
+};
+
+TEST_F(SubscriptionTest, DeliversEveryWritePath) {
+    auto subscription = engine_->subscribe(std::vector<std::string>{"AAPL"});
+    const SymbolId aapl = *engine_->find_symbol("AAPL");
+    const int64_t base = system_clock::now().time_since_epoch().count();
+
+    ASSERT_TRUE(engine_->write_point(aapl, system_clock::time_point(system_clock::duration(base)), 1.0));
+    ASSERT_TRUE(engine_->write_batch({
+        TimeSeriesPoint{.timestamp = system_clock::time_point(system_clock::duration(base + 1)), .value = 2.0, .symbol = "AAPL"},
+        TimeSeriesPoint{.timestamp = system_clock::time_point(system_clock::duration(base + 1)), .value = 9.0, .symbol = "MSFT"},
+    }));
+    std::vector<int64_t> timestamps = {base + 2, base + 3};
+    std::vector<double> values = {3.0, 4.0};
+    ASSERT_TRUE(engine_->write_columns(aapl, timestamps, values));
+
+    auto ticks = drain(subscription);
+    ASSERT_EQ(ticks.size(), 4);
+    for (size_t i = 0; i < ticks.size(); ++i) {
+        EXPECT_EQ(ticks[i].symbol, aapl);
+        EXPECT_EQ(ticks[i].timestamp, base + static_cast<int64_t>(i));
+        EXPECT_DOUBLE_EQ(ticks[i].value, i + 1.0);
+        EXPECT_TRUE(std::isnan(ticks[i].vwap));
+    }
+    EXPECT_EQ(subscription.dropped(), 0);
+
+    // A closed subscription stops receiving; a full ring drops and counts
+    auto small = engine_->subscribe(std::span<const SymbolId>(&aapl, 1), SubscriptionOptions{.capacity = 4});
+    { auto closed = std::move(subscription); }
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(engine_->write_point(aapl, system_clock::time_point(system_clock::duration(base + 10 + i)), i));
+    }
+    EXPECT_EQ(drain(small).size(), 4);
+    EXPECT_EQ(small.dropped(), 6);
+}
+
+TEST_F(SubscriptionTest, SkipsRejectedDuplicates) {
+    auto subscription = engine_->subscribe(std::vector<std::string>{"AAPL"});
+    const SymbolId aapl = *engine_->find_symbol("AAPL");
+    const int64_t base = system_clock::now().time_since_epoch().count();
+    auto at = [&](int64_t offset) { return system_clock::time_point(system_clock::duration(base + offset)); };
+
+    // The memtable keeps the first copy of a timestamp; later ones, within
+    // a batch or across batches, are never delivered
+    ASSERT_TRUE(engine_->write_batch({
+        TimeSeriesPoint{.timestamp = at(0), .value = 1.0, .symbol = "AAPL"},
+        TimeSeriesPoint{.timestamp = at(0), .value = -1.0, .symbol = "AAPL"},
+        TimeSeriesPoint{.timestamp = at(1), .value = 2.0, .symbol = "AAPL"},
+    }));
+    ASSERT_TRUE(engine_->write_batch({TimeSeriesPoint{.timestamp = at(1), .value = -1.0, .symbol = "AAPL"}}));
+    std::vector<int64_t> timestamps = {base + 2, base + 1, base + 2};
+    std::vector<double> values = {3.0, -1.0, -1.0};
+    ASSERT_TRUE(engine_->write_columns(aapl, timestamps, values));
+
+    auto ticks = drain(subscription);
+    ASSERT_EQ(ticks.size(), 3);
+    for (size_t i = 0; i < ticks.size(); ++i) {
+        EXPECT_EQ(ticks[i].timestamp, base + static_cast<int64_t>(i));
+        EXPECT_DOUBLE_EQ(ticks[i].value, i + 1.0);
+    }
+}
+
+TEST_F(SubscriptionTest, ConflatesAndTracksVwap) {
+    const SymbolId price = engine_->intern_symbol("ES.price");
+    const SymbolId volume = engine_->intern_symbol("ES.volume");
+    auto subscription = engine_->subscribe(std::span<const SymbolId>{}, SubscriptionOptions{
+        .conflate = true, .vwap = VwapSpec{.price = price, .volume = volume}});
+
+    // Price and volume land in either order; each pair counts once
+    const int64_t base = system_clock::now().time_since_epoch().count();
+    auto at = [&](int64_t offset) { return system_clock::time_point(system_clock::duration(base + offset)); };
+    ASSERT_TRUE(engine_->write_point(price, at(0), 100.0));
+    ASSERT_TRUE(engine_->write_point(volume, at(0), 10.0));
+    ASSERT_TRUE(engine_->write_point(volume, at(1), 30.0));
+    ASSERT_TRUE(engine_->write_point(price, at(1), 104.0));
+    ASSERT_TRUE(engine_->write_point(price, at(2), 110.0));
+
+    auto ticks = drain(subscription);
+    ASSERT_EQ(ticks.size(), 2);
+    EXPECT_EQ(ticks[0].symbol, price);
+    EXPECT_EQ(ticks[0].timestamp, base + 2);
+    EXPECT_DOUBLE_EQ(ticks[0].value, 110.0);
+    EXPECT_DOUBLE_EQ(ticks[0].vwap, (100.0 * 10.0 + 104.0 * 30.0) / 40.0);
+    EXPECT_EQ(ticks[1].symbol, volume);
+    EXPECT_DOUBLE_EQ(ticks[1].value, 30.0);
+    EXPECT_TRUE(drain(subscription).empty());
+
+    ASSERT_TRUE(engine_->write_point(volume, at(2), 60.0));
+    ticks = drain(subscription);
+    ASSERT_EQ(ticks.size(), 1);
+    EXPECT_DOUBLE_EQ(ticks[0].vwap, (100.0 * 10.0 + 104.0 * 30.0 + 110.0 * 60.0) / 100.0);
+}
+
+TEST_F(SubscriptionTest, ConcurrentWritersKeepPerSymbolOrder) {
+    constexpr int writers = 4;
+    constexpr int points_per_writer = 5000;
+    std::vector<SymbolId> ids;
+    for (int w = 0; w < writers; ++w) {
+        ids.push_back(engine_->intern_symbol("SYM" + std::to_string(w)));
+    }
+    auto subscription = engine_->subscribe(ids, SubscriptionOptions{.capacity = 1 << 10});
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w] {
+            for (int i = 0; i < points_per_writer; ++i) {
+                engine_->write_point(ids[w], system_clock::time_point(system_clock::duration(i + 1)), i);
+            }
+        });
+    }
+
+    // The consumer polls while writers run; ticks it can't keep up with are
+    // dropped, but what arrives stays in order
+    std::vector<int64_t> last(writers, 0);
+    size_t received = 0;
+    std::array<Tick, 256> batch;
+    auto consume = [&] {
+        const size_t count = subscription.poll(batch);
+        for (size_t i = 0; i < count; ++i) {
+            const auto w = std::find(ids.begin(), ids.end(), batch[i].symbol) - ids.begin();
+            EXPECT_GT(batch[i].timestamp, last[w]);
+            last[w] = batch[i].timestamp;
+        }
+        received += count;
+        return count;
+    };
+    while (received + subscription.dropped() < static_cast<size_t>(writers * points_per_writer)) {
+        if (consume() == 0) std::this_thread::yield();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    while (consume()) {}
+    EXPECT_EQ(received + subscription.dropped(), static_cast<size_t>(writers * points_per_writer));
+}
+
+TEST(SpscRingTest, PreservesOrderAcrossThreads) {
+    utils::SpscRing<uint64_t> ring(100);
+    EXPECT_EQ(ring.capacity(), 128);
+
+    constexpr uint64_t count = 100'000;
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < count; ++i) {
+            while (!ring.push(i)) std::this_thread::yield();
+        }
+    });
+    uint64_t expected = 0;
+    std::array<uint64_t, 32> batch;
+    while (expected < count) {
+        const size_t popped = ring.pop(batch);
+        if (popped == 0) std::this_thread::yield();
+        for (size_t i = 0; i < popped; ++i) {
+            ASSERT_EQ(batch[i], expected++);
+        }
+    }
+    producer.join();
+    uint64_t extra = 0;
+    EXPECT_FALSE(ring.pop(extra));
+}
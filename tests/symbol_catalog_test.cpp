@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "findata_engine/symbol_catalog.hpp"
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using namespace findata_engine;
+namespace fs = std::filesystem;
+
+class SymbolCatalogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = fs::temp_directory_path() / "findata_catalog_test";
+        fs::remove_all(test_dir_);
+        fs::create_directories(test_dir_);
+        file_ = test_dir_ / "SYMBOLS";
+    }
+    
+    void TearDown() override {
+        fs::remove_all(test_dir_);
+    }
+    
+    fs::path test_dir_;
+    fs::path file_;
+};
+
+TEST_F(SymbolCatalogTest, IdsAreDenseAndSurviveReopen) {
+    {
+        SymbolCatalog catalog(file_);
+        EXPECT_EQ(catalog.intern("AAPL"), 0u);
+        EXPECT_EQ(catalog.intern("MSFT"), 1u);
+        EXPECT_EQ(catalog.intern("AAPL"), 0u);
+        EXPECT_EQ(catalog.size(), 2u);
+        EXPECT_FALSE(catalog.find("GOOG").has_value());
+        EXPECT_THROW(catalog.name(7), std::out_of_range);
+    }
+    
+    // A torn tail from a crash mid-append is dropped
+    {
+        std::ofstream out(file_, std::ios::binary | std::ios::app);
+        out.write("\x02\x00\x00", 3);
+    }
+    
+    {
+        SymbolCatalog catalog(file_);
+        EXPECT_EQ(catalog.find("MSFT"), SymbolId{1});
+        EXPECT_EQ(catalog.name(0), "AAPL");
+        EXPECT_EQ(catalog.intern("GOOG"), 2u);
+    }
+    
+    SymbolCatalog catalog(file_);
+    EXPECT_EQ(catalog.size(), 3u);
+    EXPECT_EQ(catalog.name(2), "GOOG");
+}
+
+TEST_F(SymbolCatalogTest, ConcurrentInternAgreesOnIds) {
+    SymbolCatalog catalog;
+    constexpr int num_threads = 4;
+    constexpr int num_symbols = 500;
+    std::vector<std::vector<SymbolId>> seen(num_threads);
+    
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < num_symbols; ++i) {
+                seen[t].push_back(catalog.intern("SYM" + std::to_string(i)));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    EXPECT_EQ(catalog.size(), static_cast<SymbolId>(num_symbols));
+    for (int i = 0; i < num_symbols; ++i) {
+        for (int t = 1; t < num_threads; ++t) {
+            EXPECT_EQ(seen[t][i], seen[0][i]);
+        }
+        EXPECT_EQ(catalog.name(seen[0][i]), "SYM" + std::to_string(i));
+    }
+}